@@ -20,7 +20,10 @@ LOCAL_C_INCLUDES := \
 					$(ANDROID_VCPKG_DIR)/include \
 
 LOCAL_SRC_PATH := ../../../../../../../src
-LOCAL_SRC_FILES	:=  $(LOCAL_SRC_PATH)/core/debugrenderer.cpp \
+LOCAL_SRC_FILES	:=  $(LOCAL_SRC_PATH)/core/cpusorter.cpp \
+					$(LOCAL_SRC_PATH)/core/debugrenderer.cpp \
+					$(LOCAL_SRC_PATH)/core/gpusorter.cpp \
+					$(LOCAL_SRC_PATH)/core/gputimer.cpp \
 				    $(LOCAL_SRC_PATH)/core/image.cpp \
 					$(LOCAL_SRC_PATH)/core/log.cpp \
 					$(LOCAL_SRC_PATH)/core/program.cpp \
@@ -28,6 +31,7 @@ LOCAL_SRC_FILES	:=  $(LOCAL_SRC_PATH)/core/debugrenderer.cpp \
 					$(LOCAL_SRC_PATH)/core/util.cpp \
 					$(LOCAL_SRC_PATH)/core/vertexbuffer.cpp \
 					$(LOCAL_SRC_PATH)/core/textrenderer.cpp \
+					$(LOCAL_SRC_PATH)/core/simxrbuddy.cpp \
 					$(LOCAL_SRC_PATH)/core/xrbuddy.cpp \
 					$(LOCAL_SRC_PATH)/app.cpp \
 					$(LOCAL_SRC_PATH)/android_main.cpp \
@@ -10,10 +10,23 @@
 uniform vec4 color;
 uniform sampler2D colorTexture;
 
+#ifdef USE_SHARPENING
+uniform vec2 uvMax;  // upper right corner of the rendered region, the rest of colorTexture is unused
+uniform float sharpness;
+#endif
+
 in vec2 frag_uv;
 
 out vec4 out_color;
 
+#ifdef USE_SHARPENING
+// bilinear sample that never filters in texels outside of the rendered region
+vec4 SampleRegion(vec2 uv, vec2 texelSize)
+{
+    return texture(colorTexture, clamp(uv, 0.5 * texelSize, uvMax - 0.5 * texelSize));
+}
+#endif
+
 void main(void)
 {
 #ifdef USE_SUPERSAMPLING
@@ -28,6 +41,18 @@ void main(void)
     texColor += texture(colorTexture, vec2(frag_uv + dx - dy));
     texColor += texture(colorTexture, vec2(frag_uv - dx - dy));
     texColor *= 0.25;
+#elif defined(USE_SHARPENING)
+    // bilinear upscale, sharpened with a laplacian of its neighbors.
+    // clamping to the neighborhood avoids halos around high contrast edges.
+    vec2 texelSize = 1.0 / vec2(textureSize(colorTexture, 0));
+    vec4 center = SampleRegion(frag_uv, texelSize);
+    vec4 left = SampleRegion(frag_uv - vec2(texelSize.x, 0.0), texelSize);
+    vec4 right = SampleRegion(frag_uv + vec2(texelSize.x, 0.0), texelSize);
+    vec4 down = SampleRegion(frag_uv - vec2(0.0, texelSize.y), texelSize);
+    vec4 up = SampleRegion(frag_uv + vec2(0.0, texelSize.y), texelSize);
+    vec4 minColor = min(center, min(min(left, right), min(down, up)));
+    vec4 maxColor = max(center, max(max(left, right), max(down, up)));
+    vec4 texColor = clamp(center + sharpness * (4.0 * center - (left + right + down + up)), minColor, maxColor);
 #else
     vec4 texColor = texture(colorTexture, frag_uv);
 #endif
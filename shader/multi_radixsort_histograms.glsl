@@ -2,11 +2,11 @@
 * VkRadixSort written by Mirco Werner: https://github.com/MircoWerner/VkRadixSort
 * Based on implementation of Intel's Embree: https://github.com/embree/embree/blob/v4.0.0-ploc/kernels/rthwif/builder/gpu/sort.h
 */
-#version 460
+/*%%HEADER%%*/
 //#extension GL_GOOGLE_include_directive: enable
 
-#define WORKGROUP_SIZE 256 // assert WORKGROUP_SIZE >= RADIX_SORT_BINS
-#define RADIX_SORT_BINS 256
+#define WORKGROUP_SIZE 256U // assert WORKGROUP_SIZE >= RADIX_SORT_BINS
+#define RADIX_SORT_BINS 256U
 
 uniform uint g_num_elements;
 uniform uint g_shift;
@@ -37,11 +37,11 @@ void main() {
     }
     barrier();
 
-    for (uint index = 0; index < g_num_blocks_per_workgroup; index++) {
+    for (uint index = 0U; index < g_num_blocks_per_workgroup; index++) {
         uint elementId = wID * g_num_blocks_per_workgroup * WORKGROUP_SIZE + index * WORKGROUP_SIZE + lID;
         if (elementId < g_num_elements) {
             // determine the bin
-            const uint bin = (g_elements_in[elementId] >> g_shift) & (RADIX_SORT_BINS - 1);
+            uint bin = (g_elements_in[elementId] >> g_shift) & (RADIX_SORT_BINS - 1U);
             // increment the histogram
             atomicAdd(histogram[bin], 1U);
         }
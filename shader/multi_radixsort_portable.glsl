@@ -0,0 +1,145 @@
+/**
+* VkRadixSort written by Mirco Werner: https://github.com/MircoWerner/VkRadixSort
+* Based on implementation of Intel's Embree: https://github.com/embree/embree/blob/v4.0.0-ploc/kernels/rthwif/builder/gpu/sort.h
+*
+* Same as multi_radixsort.glsl, but the subgroup reductions are replaced with a shared memory prefix scan,
+* so it will run on GLES 3.1 and desktop drivers without GL_KHR_shader_subgroup.
+*/
+/*%%HEADER%%*/
+
+#define WORKGROUP_SIZE 256U // assert WORKGROUP_SIZE >= RADIX_SORT_BINS
+#define RADIX_SORT_BINS 256U
+
+#define BITS 32U // sorting uint32_t
+
+layout (local_size_x = WORKGROUP_SIZE) in;
+
+uniform uint g_num_elements;
+uniform uint g_shift;
+uniform uint g_num_workgroups;
+uniform uint g_num_blocks_per_workgroup;
+
+layout (std430, binding = 0) buffer elements_in {
+    uint g_elements_in[];
+};
+
+layout (std430, binding = 1) buffer elements_out {
+    uint g_elements_out[];
+};
+
+layout (std430, binding = 2) buffer indices_in {
+    uint g_indices_in[];
+};
+
+layout (std430, binding = 3) buffer indices_out {
+    uint g_indices_out[];
+};
+
+layout (std430, binding = 4) buffer histograms {
+// [histogram_of_workgroup_0 | histogram_of_workgroup_1 | ... ]
+    uint g_histograms[];// |g_histograms| = RADIX_SORT_BINS * #WORKGROUPS = RADIX_SORT_BINS * g_num_workgroups
+};
+
+shared uint[RADIX_SORT_BINS] scan;// inclusive scan (prefix sum) of the global histogram
+shared uint[RADIX_SORT_BINS] global_offsets;// global exclusive scan (prefix sum)
+
+struct BinFlags {
+    uint flags[WORKGROUP_SIZE / BITS];
+};
+shared BinFlags[RADIX_SORT_BINS] bin_flags;
+
+void main() {
+    uint lID = gl_LocalInvocationID.x;
+    uint wID = gl_WorkGroupID.x;
+
+    uint local_histogram = 0U;
+    uint histogram_count = 0U;
+
+    if (lID < RADIX_SORT_BINS) {
+        uint count = 0U;
+        for (uint j = 0U; j < g_num_workgroups; j++) {
+            uint t = g_histograms[RADIX_SORT_BINS * j + lID];
+            local_histogram = (j == wID) ? count : local_histogram;
+            count += t;
+        }
+        histogram_count = count;
+        scan[lID] = count;
+    }
+    barrier();
+
+    // Hillis-Steele scan across the bins, log2(RADIX_SORT_BINS) steps.
+    for (uint offset = 1U; offset < RADIX_SORT_BINS; offset <<= 1U) {
+        uint t = 0U;
+        if (lID < RADIX_SORT_BINS && lID >= offset) {
+            t = scan[lID - offset];
+        }
+        barrier();
+        if (lID < RADIX_SORT_BINS) {
+            scan[lID] += t;
+        }
+        barrier();
+    }
+
+    if (lID < RADIX_SORT_BINS) {
+        uint global_histogram = scan[lID] - histogram_count;
+        global_offsets[lID] = global_histogram + local_histogram;
+    }
+
+    //     ==== scatter keys according to global offsets =====
+    uint flags_bin = lID / BITS;
+    uint flags_bit = 1U << (lID % BITS);
+
+    for (uint index = 0U; index < g_num_blocks_per_workgroup; index++) {
+        uint blockStart = wID * g_num_blocks_per_workgroup * WORKGROUP_SIZE + index * WORKGROUP_SIZE;
+        uint elementId = blockStart + lID;
+
+        // the rest of the blocks are empty, same for every invocation so it is safe to exit before the barriers.
+        if (blockStart >= g_num_elements) {
+            break;
+        }
+
+        // initialize bin flags
+        if (lID < RADIX_SORT_BINS) {
+            for (uint i = 0U; i < WORKGROUP_SIZE / BITS; i++) {
+                bin_flags[lID].flags[i] = 0U;// init all bin flags to 0
+            }
+        }
+        barrier();
+
+        uint element_in = 0U;
+        uint index_in = 0U;
+        uint binID = 0U;
+        uint binOffset = 0U;
+        if (elementId < g_num_elements) {
+            element_in = g_elements_in[elementId];
+            index_in = g_indices_in[elementId];
+            binID = (element_in >> g_shift) & (RADIX_SORT_BINS - 1U);
+            // offset for group
+            binOffset = global_offsets[binID];
+            // add bit to flag
+            atomicAdd(bin_flags[binID].flags[flags_bin], flags_bit);
+        }
+        barrier();
+
+        if (elementId < g_num_elements) {
+            // calculate output index of element
+            uint prefix = 0U;
+            uint count = 0U;
+            for (uint i = 0U; i < WORKGROUP_SIZE / BITS; i++) {
+                uint bits = bin_flags[binID].flags[i];
+                uint full_count = uint(bitCount(bits));
+                uint partial_count = uint(bitCount(bits & (flags_bit - 1U)));
+                prefix += (i < flags_bin) ? full_count : 0U;
+                prefix += (i == flags_bin) ? partial_count : 0U;
+                count += full_count;
+            }
+            g_elements_out[binOffset + prefix] = element_in;
+            g_indices_out[binOffset + prefix] = index_in;
+            if (prefix == count - 1U) {
+                atomicAdd(global_offsets[binID], count);
+            }
+        }
+
+        barrier();
+    }
+}
@@ -9,7 +9,12 @@ layout(local_size_x = 256) in;
 
 uniform mat4 modelViewProj;
 uniform vec2 nearFar;
+uniform float clipBound;
+uniform vec2 radiusScale;  // clip space x and y offset per unit of radius, see GpuSorter::Sort()
+uniform float pixelScale;
+uniform float minPixelArea;
 uniform uint keyMax;
+uniform uint numPositions;
 
 layout(binding = 4, offset = 0) uniform atomic_uint output_count;
 
@@ -32,25 +37,31 @@ void main()
 {
     uint idx = gl_GlobalInvocationID.x;
 
-	uint len = uint(positions.length());
-    if (idx >= len)
+    if (idx >= numPositions)
     {
         return;
     }
 
-    // NOTE: alpha is encoded into the w component of the positions
-    vec4 p = modelViewProj * vec4(positions[idx].xyz, 1.0f);
+    // NOTE: the radius of the bounding sphere is encoded into the w component of the positions
+    vec4 pos = positions[idx];
+    float radius = pos.w;
+    vec4 p = modelViewProj * vec4(pos.xyz, 1.0f);
     float depth = p.w;
-    float xx = p.x / depth;
-    float yy = p.y / depth;
 
-    const float CLIP = 1.5f;
-    if (depth > 0.0f && xx < CLIP && xx > -CLIP && yy < CLIP && yy > -CLIP)
+    // conservative test of the bounding sphere against |x / w| < clipBound and |y / w| < clipBound
+    vec2 bound = clipBound * depth + radius * radiusScale;
+    bool visible = radius >= 0.0f && depth > 0.0f && abs(p.x) < bound.x && abs(p.y) < bound.y;
+
+    // area of the projected bounding circle in pixels
+    float pixelRadius = radius * pixelScale / depth;
+    visible = visible && (3.14159265f * pixelRadius * pixelRadius) >= minPixelArea;
+
+    if (visible)
     {
         uint count = atomicCounterIncrement(output_count);
         // 16.16 fixed point
         //uint fixedPointZ = uint(0xffffffff) - uint(clamp(depth, 0.0f, 65535.0f) * 65536.0f);
-		uint fixedPointZ = keyMax - uint((depth / nearFar.y) * keyMax);
+		uint fixedPointZ = keyMax - uint((depth / nearFar.y) * float(keyMax));
         quantizedZs[count] = fixedPointZ;
         indices[count] = idx;
     }
@@ -0,0 +1,21 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// copies the premultiplied output of splat_tile_raster_compute.glsl or the front to back quads into the framebuffer,
+// the blend state is the same as the other splat draw modes.
+//
+
+/*%%HEADER%%*/
+
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform sampler2D colorTex;
+
+out vec4 out_color;
+
+void main(void)
+{
+    out_color = texelFetch(colorTex, ivec2(gl_FragCoord.xy - viewport.xy), 0);
+}
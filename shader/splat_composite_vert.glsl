@@ -0,0 +1,17 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// full screen triangle, used to composite the offscreen splat targets.
+//
+
+/*%%HEADER%%*/
+
+void main(void)
+{
+    // gl_VertexID 0, 1, 2 = (-1, -1), (3, -1), (-1, 3)
+    vec2 p = vec2(float((gl_VertexID & 1) << 2) - 1.0f, float((gl_VertexID & 2) << 1) - 1.0f);
+    gl_Position = vec4(p, 0.0f, 1.0f);
+}
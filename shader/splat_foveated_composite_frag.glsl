@@ -0,0 +1,37 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// combines the full resolution fovea and the upscaled low resolution periphery of SplatRenderer::RenderFoveated(),
+// both premultiplied, the blend state is the same as the other splat draw modes.
+// the fovea fades into the periphery over its outer featherWidth pixels, to hide the seam.
+//
+
+/*%%HEADER%%*/
+
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform vec4 fovea;  // x, y, width, height, in pixels relative to the viewport
+uniform float featherWidth;
+uniform sampler2D foveaTex;
+uniform sampler2D peripheryTex;  // covers the whole viewport, with linear filtering
+
+out vec4 out_color;
+
+void main(void)
+{
+    vec2 p = gl_FragCoord.xy - viewport.xy;
+    vec4 periphery = texture(peripheryTex, p / viewport.zw);
+
+    vec2 q = p - fovea.xy;
+    float edgeDist = min(min(q.x, q.y), min(fovea.z - q.x, fovea.w - q.y));
+    if (edgeDist <= 0.0f)
+    {
+        out_color = periphery;
+        return;
+    }
+
+    vec4 foveaColor = texelFetch(foveaTex, ivec2(q), 0);
+    out_color = mix(periphery, foveaColor, clamp(edgeDist / featherWidth, 0.0f, 1.0f));
+}
@@ -9,20 +9,52 @@
 
 /*%%HEADER%%*/
 
+/*%%DEFINES%%*/
+
+#ifdef FALLOFF_LUT
+// exp(-0.5 * q) for q in [0, FALLOFF_MAX_Q], built by SplatRenderer.
+// FALLOFF_MAX_Q is where the gaussian falls below the alpha threshold, even for a fully opaque splat.
+#define FALLOFF_MAX_Q 11.090355f  // 2 * ln(256)
+#define FALLOFF_SIZE 256.0f
+uniform sampler2D falloffTex;
+#endif
+
 in vec4 frag_color;  // radiance of splat
 in vec4 frag_cov2inv;  // inverse of the 2D screen space covariance matrix of the guassian
 in vec2 frag_p;  // 2D screen space center of the guassian
 
+#ifdef WEIGHTED_BLENDED
+// weighted blended order independent transparency, see SplatRenderer::RenderWeightedBlended()
+// out_color.rgb is the weighted sum of the premultiplied color, out_color.a is the product of (1 - alpha),
+// out_weight is the weighted sum of alpha.
+uniform vec2 nearFar;
+layout(location = 0) out vec4 out_color;
+layout(location = 1) out vec4 out_weight;
+#elif defined(EXPECTED_DEPTH)
+// see SplatRenderer::RenderTemporal(), out_depth is blended like out_color, so out_depth.r / out_depth.a is the
+// expected view space depth of the pixel, i.e. the depth of each splat weighted by its contribution to the pixel,
+// and out_depth.g / out_depth.a the expected square of it.
+uniform vec2 nearFar;
+layout(location = 0) out vec4 out_color;
+layout(location = 1) out vec4 out_depth;
+#else
 out vec4 out_color;
+#endif
 
 void main()
 {
     vec2 d = gl_FragCoord.xy - frag_p;
 
-    // TODO: Use texture for gaussian evaluation
     // evaluate the gaussian
     mat2 cov2Dinv = mat2(frag_cov2inv.xy, frag_cov2inv.zw);
-    float g = exp(-0.5f * dot(d, cov2Dinv * d));
+    float q = dot(d, cov2Dinv * d);
+#ifdef FALLOFF_LUT
+    // the texture coordinate is remapped so that q = 0 and q = FALLOFF_MAX_Q land on the first and last texel centers.
+    float u = (q / FALLOFF_MAX_Q) * ((FALLOFF_SIZE - 1.0f) / FALLOFF_SIZE) + (0.5f / FALLOFF_SIZE);
+    float g = texture(falloffTex, vec2(u, 0.5f)).r;
+#else
+    float g = exp(-0.5f * q);
+#endif
 
     out_color.rgb = frag_color.a * g * frag_color.rgb;
     out_color.a = frag_color.a * g;
@@ -39,4 +71,23 @@ void main()
     {
         discard;
     }
+
+#if defined(WEIGHTED_BLENDED) || defined(EXPECTED_DEPTH)
+    // z is the view space depth
+    float ndcZ = 2.0f * gl_FragCoord.z - 1.0f;
+    float z = (2.0f * nearFar.x * nearFar.y) / (nearFar.y + nearFar.x - ndcZ * (nearFar.y - nearFar.x));
+#endif
+
+#ifdef EXPECTED_DEPTH
+    out_depth = vec4(z * out_color.a, z * z * out_color.a, 0.0f, out_color.a);
+#endif
+
+#ifdef WEIGHTED_BLENDED
+    // depth weight from equation 7 of McGuire and Bavoil 2013, scaled by 1/256 so the sums fit in the half float targets.
+    // unscaled, a few dozen opaque splats near the camera would add up to more then 65504, and overflow to inf.
+    // the same scale is applied to both sums, so it cancels out in splat_wboit_composite_frag.glsl
+    float w = clamp(10.0f / (1e-5f + pow(z / 5.0f, 2.0f) + pow(z / 200.0f, 6.0f)), 1e-2f, 3e3f) * (1.0f / 256.0f);
+    out_weight = vec4(w * out_color.a);
+    out_color.rgb *= w;
+#endif
 }
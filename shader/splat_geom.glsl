@@ -6,6 +6,7 @@
 /*%%HEADER%%*/
 
 uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform float pointRadius;  // splats with a smaller footprint are drawn as a single pixel, see SplatRenderer::SetPointRadius()
 
 layout(points) in;
 layout(triangle_strip, max_vertices = 4) out;
@@ -31,6 +32,24 @@ mat2 inverseMat2(mat2 m)
     return inv;
 }
 
+// approximation of erf(x), with a maximum error of about 1e-4
+float Erf(float x)
+{
+    float x2 = x * x;
+    float ax2 = 0.147f * x2;
+    return sign(x) * sqrt(1.0f - exp(-x2 * (1.27323954f + ax2) / (1.0f + ax2)));
+}
+
+// alpha of a splat that is drawn as a single pixel, the gaussian is integrated over that pixel instead of sampled at its center.
+// cov2D includes the anti-aliasing filter, the correlation between x and y is ignored, because the splat is so small.
+float PointAlpha(float alpha, mat2 cov2D)
+{
+    float det = cov2D[0][0] * cov2D[1][1] - cov2D[0][1] * cov2D[1][0];
+    float integral = 6.28318531f * sqrt(max(det, 0.0f));  // over the whole plane
+    float fraction = Erf(0.5f / sqrt(2.0f * cov2D[0][0])) * Erf(0.5f / sqrt(2.0f * cov2D[1][1]));  // inside the pixel
+    return min(1.0f, alpha * integral * fraction);
+}
+
 void main()
 {
     float WIDTH = viewport.z;
@@ -53,9 +72,19 @@ void main()
         return;
     }
 
+    // fragments where alpha * g falls below the 1/256 threshold in splat_frag.glsl are discarded,
+    // so size the quad to stop at exactly that point, instead of always using 3.5 sigma.
+    // i.e. solve alpha * exp(-0.5 * k^2) = 1/256 for k.
+    float alpha = geom_color[0].a;
+    if (alpha <= (1.0f / 256.0f))
+    {
+        // discard this point
+        return;
+    }
+    float k = sqrt(2.0f * log(256.0f * alpha));
+
     // compute 2d extents for the splat, using covariance matrix ellipse
     // see https://cookierobotics.com/007/
-    float k = 3.5f;
     float a = cov2D[0][0];
     float b = cov2D[0][1];
     float c = cov2D[1][1];
@@ -80,6 +109,23 @@ void main()
     vec2 majAxis = vec2(r1 * cos(theta), r1 * sin(theta));
     vec2 minAxis = vec2(r2 * cos(theta + radians(90.0f)), r2 * sin(theta + radians(90.0f)));
 
+    // same as splat_preprocess_compute.glsl, maj includes the anti-aliasing filter.
+    vec4 color = geom_color[0];
+    if (k * sqrt(max(maj - 0.3f, 0.0f)) < pointRadius)
+    {
+        color.a = PointAlpha(alpha, cov2D);
+        if (color.a <= (1.0f / 256.0f))
+        {
+            // discard this point
+            return;
+        }
+
+        // a one pixel square covers exactly one pixel center, where the gaussian is evaluated as a constant 1.
+        majAxis = vec2(0.5f, 0.0f);
+        minAxis = vec2(0.0f, 0.5f);
+        cov2Dinv4 = vec4(0.0f);
+    }
+
     vec2 offsets[4];
     offsets[0] = majAxis + minAxis;
     offsets[1] = -majAxis + minAxis;
@@ -96,7 +142,7 @@ void main()
         offset.y *= (2.0f / HEIGHT) * w;
 
         gl_Position = gl_in[0].gl_Position + vec4(offset.x, offset.y, 0.0, 0.0);
-        frag_color = geom_color[0];
+        frag_color = color;
         frag_cov2inv = cov2Dinv4;
         frag_p = geom_p[0];
 
@@ -0,0 +1,37 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// Builds one level of the occluder pyramid, each texel is the max depth of the 2x2 texels below it.
+// Level 0 is reduced from the depth at which each pixel saturated, 1.0 where it never did.
+// Used by splat_preprocess_compute.glsl to cull splats that are entirely behind saturated pixels.
+//
+
+/*%%HEADER%%*/
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D srcTex;
+uniform int srcLevel;
+uniform ivec2 srcSize;
+uniform ivec2 dstSize;
+
+layout(binding = 0, r32f) writeonly uniform highp image2D dstImage;
+
+void main()
+{
+    ivec2 dst = ivec2(gl_GlobalInvocationID.xy);
+    if (dst.x >= dstSize.x || dst.y >= dstSize.y)
+    {
+        return;
+    }
+
+    // dstSize is rounded up, so the last row and column may only cover one src texel.
+    ivec2 src0 = 2 * dst;
+    ivec2 src1 = min(src0 + ivec2(1, 1), srcSize - ivec2(1, 1));
+    float d = max(max(texelFetch(srcTex, src0, srcLevel).r, texelFetch(srcTex, ivec2(src1.x, src0.y), srcLevel).r),
+                  max(texelFetch(srcTex, ivec2(src0.x, src1.y), srcLevel).r, texelFetch(srcTex, src1, srcLevel).r));
+    imageStore(dstImage, dst, vec4(d, 0.0f, 0.0f, 0.0f));
+}
@@ -0,0 +1,472 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// Projects every gaussian once per frame, culls it, and writes a compact SplatRecord for each visible splat,
+// along with a depth key and the index of its record for the sort.
+// splat_quad_vert.glsl only has to read the records to expand each splat into a quad.
+//
+// When occlusionCull is set, splats that were entirely behind saturated pixels in the frame the occluder pyramid
+// was built from are culled too, see splat_occluder_reduce_compute.glsl.
+//
+// When REPROJECT is defined, the records of the splats that were visible in the previous preprocess are rewritten
+// for a new view, without changing their order. Used to render the second eye with the order from the first.
+// The output is either the same buffer, in place, or a separate buffer for the second view of a stereo pair.
+// The radiance from the sh is not evaluated again, every view shares the one from the view of the sort,
+// so only the position and covariance of each gaussian are loaded.
+//
+
+/*%%HEADER%%*/
+
+/*%%DEFINES%%*/
+
+// GAUSSIAN_STRIDE and the *_OFFSET macros are defined by SplatRenderer, in floats, from the GaussianCloud layout.
+
+layout(local_size_x = 256) in;
+
+uniform mat4 viewMat;  // used to project position into view coordinates.
+uniform mat4 projMat;  // used to project view coordinates into clip coordinates.
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform vec2 nearFar;
+uniform vec3 eye;
+uniform uint keyMax;
+uniform uint numSplats;  // number of gaussians, or number of records when REPROJECT is defined
+uniform float minPixelArea;  // splats with a smaller footprint are culled, see SplatRenderer::SetMinPixelArea()
+uniform float pointRadius;  // splats with a smaller footprint are drawn as a single pixel, see SplatRenderer::SetPointRadius()
+uniform float filterVariance;  // of the anti-aliasing filter in pixels squared, smaller when rendering samples of a higher resolution image
+
+// struct SplatRecord, see SPLAT_RECORD_MEMBERS in splatrenderer.cpp
+/*%%SPLAT_RECORD%%*/
+
+layout(std430, binding = 0) readonly buffer gaussian_data {
+    float g_gaussians[];
+};
+
+layout(std430, binding = 1) buffer splat_records {
+    SplatRecord g_records[];
+};
+
+#ifdef REPROJECT
+layout(std430, binding = 2) writeonly buffer reprojected_records {
+    SplatRecord g_reprojected[];
+};
+#else
+layout(std430, binding = 2) writeonly buffer sort_keys {
+    uint g_keys[];
+};
+
+layout(std430, binding = 3) writeonly buffer sort_vals {
+    uint g_vals[];
+};
+
+layout(binding = 0, offset = 0) uniform atomic_uint output_count;
+
+uniform uint occlusionCull;  // non-zero to test the splats against occluderTex
+uniform mat4 occluderViewProjMat;  // view and projection of the frame occluderTex was built from
+uniform vec2 occluderSize;  // size of that viewport in pixels
+uniform int occluderNumLevels;
+uniform sampler2D occluderTex;  // max window depth pyramid, each texel of level l covers 2^(l + 1) pixels
+#endif
+
+// same as the vertex attributes of splat_vert.glsl, but loaded from g_gaussians by LoadGaussian().
+vec4 position;  // center of the gaussian in object coordinates, (with alpha crammed in to w)
+vec4 r_sh0;
+#ifdef FULL_SH
+vec4 r_sh1;
+vec4 r_sh2;
+vec4 r_sh3;
+#endif
+vec4 g_sh0;
+#ifdef FULL_SH
+vec4 g_sh1;
+vec4 g_sh2;
+vec4 g_sh3;
+#endif
+vec4 b_sh0;
+#ifdef FULL_SH
+vec4 b_sh1;
+vec4 b_sh2;
+vec4 b_sh3;
+#endif
+vec3 cov3_col0;
+vec3 cov3_col1;
+vec3 cov3_col2;
+
+vec4 LoadVec4(uint base, uint offset)
+{
+    uint i = base + offset;
+    return vec4(g_gaussians[i], g_gaussians[i + 1U], g_gaussians[i + 2U], g_gaussians[i + 3U]);
+}
+
+vec3 LoadVec3(uint base, uint offset)
+{
+    uint i = base + offset;
+    return vec3(g_gaussians[i], g_gaussians[i + 1U], g_gaussians[i + 2U]);
+}
+
+void LoadGaussian(uint index)
+{
+    uint base = index * GAUSSIAN_STRIDE;
+    position = LoadVec4(base, POSITION_OFFSET);
+#ifndef REPROJECT
+    r_sh0 = LoadVec4(base, R_SH0_OFFSET);
+    g_sh0 = LoadVec4(base, G_SH0_OFFSET);
+    b_sh0 = LoadVec4(base, B_SH0_OFFSET);
+#ifdef FULL_SH
+    r_sh1 = LoadVec4(base, R_SH1_OFFSET);
+    r_sh2 = LoadVec4(base, R_SH2_OFFSET);
+    r_sh3 = LoadVec4(base, R_SH3_OFFSET);
+    g_sh1 = LoadVec4(base, G_SH1_OFFSET);
+    g_sh2 = LoadVec4(base, G_SH2_OFFSET);
+    g_sh3 = LoadVec4(base, G_SH3_OFFSET);
+    b_sh1 = LoadVec4(base, B_SH1_OFFSET);
+    b_sh2 = LoadVec4(base, B_SH2_OFFSET);
+    b_sh3 = LoadVec4(base, B_SH3_OFFSET);
+#endif
+#endif
+    cov3_col0 = LoadVec3(base, COV3_COL0_OFFSET);
+    cov3_col1 = LoadVec3(base, COV3_COL1_OFFSET);
+    cov3_col2 = LoadVec3(base, COV3_COL2_OFFSET);
+}
+
+// used to invert the 2D screen space covariance matrix
+mat2 inverseMat2(mat2 m)
+{
+    float det = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+    mat2 inv;
+    inv[0][0] =  m[1][1] / det;
+    inv[0][1] = -m[0][1] / det;
+    inv[1][0] = -m[1][0] / det;
+    inv[1][1] =  m[0][0] / det;
+
+    return inv;
+}
+
+#ifndef REPROJECT
+vec3 ComputeRadianceFromSH(const vec3 v)
+{
+#ifdef FULL_SH
+    float b[16];
+#else
+    float b[4];
+#endif
+
+    float vx2 = v.x * v.x;
+    float vy2 = v.y * v.y;
+    float vz2 = v.z * v.z;
+
+    // zeroth order
+    // (/ 1.0 (* 2.0 (sqrt pi)))
+    b[0] = 0.28209479177387814f;
+
+    // first order
+    // (/ (sqrt 3.0) (* 2 (sqrt pi)))
+    float k1 = 0.4886025119029199f;
+    b[1] = -k1 * v.y;
+    b[2] = k1 * v.z;
+    b[3] = -k1 * v.x;
+
+#ifdef FULL_SH
+    // second order
+    // (/ (sqrt 15.0) (* 2 (sqrt pi)))
+    float k2 = 1.0925484305920792f;
+    // (/ (sqrt 5.0) (* 4 (sqrt  pi)))
+    float k3 = 0.31539156525252005f;
+    // (/ (sqrt 15.0) (* 4 (sqrt pi)))
+    float k4 = 0.5462742152960396f;
+    b[4] = k2 * v.y * v.x;
+    b[5] = -k2 * v.y * v.z;
+    b[6] = k3 * (3.0f * vz2 - 1.0f);
+    b[7] = -k2 * v.x * v.z;
+    b[8] = k4 * (vx2 - vy2);
+
+    // third order
+    // (/ (* (sqrt 2) (sqrt 35)) (* 8 (sqrt pi)))
+    float k5 = 0.5900435899266435f;
+    // (/ (sqrt 105) (* 2 (sqrt pi)))
+    float k6 = 2.8906114426405543f;
+    // (/ (* (sqrt 2) (sqrt 21)) (* 8 (sqrt pi)))
+    float k7 = 0.4570457994644658f;
+    // (/ (sqrt 7) (* 4 (sqrt pi)))
+    float k8 = 0.37317633259011546f;
+    // (/ (sqrt 105) (* 4 (sqrt pi)))
+    float k9 = 1.4453057213202771f;
+    b[9] = -k5 * v.y * (3.0f * vx2 - vy2);
+    b[10] = k6 * v.y * v.x * v.z;
+    b[11] = -k7 * v.y * (5.0f * vz2 - 1.0f);
+    b[12] = k8 * v.z * (5.0f * vz2 - 3.0f);
+    b[13] = -k7 * v.x * (5.0f * vz2 - 1.0f);
+    b[14] = k9 * v.z * (vx2 - vy2);
+    b[15] = -k5 * v.x * (vx2 - 3.0f * vy2);
+
+    float re = (b[0] * r_sh0.x + b[1] * r_sh0.y + b[2] * r_sh0.z + b[3] * r_sh0.w +
+                b[4] * r_sh1.x + b[5] * r_sh1.y + b[6] * r_sh1.z + b[7] * r_sh1.w +
+                b[8] * r_sh2.x + b[9] * r_sh2.y + b[10]* r_sh2.z + b[11]* r_sh2.w +
+                b[12]* r_sh3.x + b[13]* r_sh3.y + b[14]* r_sh3.z + b[15]* r_sh3.w);
+
+    float gr = (b[0] * g_sh0.x + b[1] * g_sh0.y + b[2] * g_sh0.z + b[3] * g_sh0.w +
+                b[4] * g_sh1.x + b[5] * g_sh1.y + b[6] * g_sh1.z + b[7] * g_sh1.w +
+                b[8] * g_sh2.x + b[9] * g_sh2.y + b[10]* g_sh2.z + b[11]* g_sh2.w +
+                b[12]* g_sh3.x + b[13]* g_sh3.y + b[14]* g_sh3.z + b[15]* g_sh3.w);
+
+    float bl = (b[0] * b_sh0.x + b[1] * b_sh0.y + b[2] * b_sh0.z + b[3] * b_sh0.w +
+                b[4] * b_sh1.x + b[5] * b_sh1.y + b[6] * b_sh1.z + b[7] * b_sh1.w +
+                b[8] * b_sh2.x + b[9] * b_sh2.y + b[10]* b_sh2.z + b[11]* b_sh2.w +
+                b[12]* b_sh3.x + b[13]* b_sh3.y + b[14]* b_sh3.z + b[15]* b_sh3.w);
+#else
+    float re = (b[0] * r_sh0.x + b[1] * r_sh0.y + b[2] * r_sh0.z + b[3] * r_sh0.w);
+    float gr = (b[0] * g_sh0.x + b[1] * g_sh0.y + b[2] * g_sh0.z + b[3] * g_sh0.w);
+    float bl = (b[0] * b_sh0.x + b[1] * b_sh0.y + b[2] * b_sh0.z + b[3] * b_sh0.w);
+#endif
+    return vec3(0.5f, 0.5f, 0.5f) + vec3(re, gr, bl);
+}
+#endif
+
+#ifdef FRAMEBUFFER_SRGB
+float SRGBToLinearF(float srgb)
+{
+    if (srgb <= 0.04045f)
+    {
+        return srgb / 12.92f;
+    }
+    else
+    {
+        return pow((srgb + 0.055f) / 1.055f, 2.4f);
+    }
+}
+
+vec3 SRGBToLinear(const vec3 srgbColor)
+{
+    vec3 linearColor;
+    for (int i = 0; i < 3; ++i) // Convert RGB, leave A unchanged
+    {
+        linearColor[i] = SRGBToLinearF(srgbColor[i]);
+    }
+    return linearColor;
+}
+#endif
+
+// approximation of erf(x), with a maximum error of about 1e-4
+float Erf(float x)
+{
+    float x2 = x * x;
+    float ax2 = 0.147f * x2;
+    return sign(x) * sqrt(1.0f - exp(-x2 * (1.27323954f + ax2) / (1.0f + ax2)));
+}
+
+// alpha of a splat that is drawn as a single pixel, the gaussian is integrated over that pixel instead of sampled at its center.
+// cov2D includes the anti-aliasing filter, the correlation between x and y is ignored, because the splat is so small.
+float PointAlpha(float alpha, mat2 cov2D)
+{
+    float det = cov2D[0][0] * cov2D[1][1] - cov2D[0][1] * cov2D[1][0];
+    float integral = 6.28318531f * sqrt(max(det, 0.0f));  // over the whole plane
+    float fraction = Erf(0.5f / sqrt(2.0f * cov2D[0][0])) * Erf(0.5f / sqrt(2.0f * cov2D[1][1]));  // inside the pixel
+    return min(1.0f, alpha * integral * fraction);
+}
+
+#ifndef REPROJECT
+// true if the splat was entirely behind saturated pixels, when the occluder pyramid was built.
+// halfSize is the half extent of the quad in pixels for this frame, close enough because the camera has not moved much.
+bool IsOccluded(vec3 pos, vec2 halfSize)
+{
+    vec4 clipP = occluderViewProjMat * vec4(pos, 1.0f);
+    if (clipP.w <= 0.0f)
+    {
+        return false;
+    }
+    vec3 ndcP = clipP.xyz / clipP.w;
+
+    // splats that were partially off screen are not tested, plus one pixel of slop.
+    vec2 center = (0.5f * ndcP.xy + 0.5f) * occluderSize;
+    vec2 rectMin = center - halfSize - vec2(1.0f);
+    vec2 rectMax = center + halfSize + vec2(1.0f);
+    if (rectMin.x < 0.0f || rectMin.y < 0.0f || rectMax.x >= occluderSize.x || rectMax.y >= occluderSize.y)
+    {
+        return false;
+    }
+
+    // pick the level where the rect covers at most 2x2 texels
+    float extent = max(rectMax.x - rectMin.x, rectMax.y - rectMin.y);
+    int level = max(0, int(ceil(log2(extent))) - 1);
+    if (level >= occluderNumLevels)
+    {
+        return false;
+    }
+    ivec2 t0 = ivec2(rectMin) >> (level + 1);
+    ivec2 t1 = ivec2(rectMax) >> (level + 1);
+    float occluderDepth = max(max(texelFetch(occluderTex, t0, level).r, texelFetch(occluderTex, ivec2(t1.x, t0.y), level).r),
+                              max(texelFetch(occluderTex, ivec2(t0.x, t1.y), level).r, texelFetch(occluderTex, t1, level).r));
+
+    // same window depth as the records, the pixels stop blending at the first splat past their saturation depth.
+    return 0.5f * ndcP.z + 0.5f > occluderDepth;
+}
+#endif
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= numSplats)
+    {
+        return;
+    }
+
+#ifdef REPROJECT
+    uint index = g_records[id].index;
+#else
+    uint index = id;
+#endif
+    LoadGaussian(index);
+
+    // t is in view coordinates
+    float alpha = position.w;
+    vec4 t = viewMat * vec4(position.xyz, 1.0f);
+
+    float WIDTH = viewport.z;
+    float HEIGHT = viewport.w;
+    float Z_FAR = nearFar.y;
+
+    // p4 is the gaussian center in clip coordinates.
+    vec4 p4 = projMat * t;
+    vec3 ndcP = p4.xyz / p4.w;
+
+    // same guard band and near test as splat_geom.glsl, splats outside of it are not stable under the affine approximation below.
+    // splats that are never above the 1/256 alpha threshold in splat_frag.glsl are culled too.
+    const float GUARD_BAND = 2.0f;
+    bool visible = alpha > (1.0f / 256.0f) && p4.w > 0.0f && ndcP.z >= 0.25f &&
+        ndcP.x < GUARD_BAND && ndcP.x > -GUARD_BAND &&
+        ndcP.y < GUARD_BAND && ndcP.y > -GUARD_BAND;
+
+    SplatRecord record;
+    record.p = ndcP;
+    record.index = index;
+
+    if (visible)
+    {
+        // J is the jacobian of the projection and viewport transformations.
+        // this is an affine approximation of the real projection.
+        // because gaussians are closed under affine transforms.
+        float SX = projMat[0][0];
+        float SY = projMat[1][1];
+        float tzSq = t.z * t.z;
+        float jsx = -(SX * WIDTH) / (2.0f * t.z);
+        float jsy = -(SY * HEIGHT) / (2.0f * t.z);
+        float jtx = (SX * t.x * WIDTH) / (2.0f * tzSq);
+        float jty = (SY * t.y * HEIGHT) / (2.0f * tzSq);
+        // the depth row of J is left out, the covariance is projected onto the xy plane below, so it never contributes.
+        mat3 J = mat3(vec3(jsx, 0.0f, 0.0f),
+                      vec3(0.0f, jsy, 0.0f),
+                      vec3(jtx, jty, 0.0f));
+
+        // combine the affine transforms of W (viewMat) and J (approx of viewportMat * projMat)
+        // using the fact that the new transformed covariance matrix V_Prime = JW * V * (JW)^T
+        mat3 W = mat3(viewMat);
+        mat3 V = mat3(cov3_col0, cov3_col1, cov3_col2);
+        mat3 JW = J * W;
+        mat3 V_prime = JW * V * transpose(JW);
+
+        // now we can 'project' the 3D covariance matrix onto the xy plane by just dropping the last column and row.
+        mat2 cov2D = mat2(V_prime);
+
+        // size the quad to stop where alpha * g falls below the 1/256 threshold in splat_frag.glsl, see splat_geom.glsl
+        float k = sqrt(2.0f * log(256.0f * alpha));
+
+        // area of the ellipse at k sigma is pi * k^2 * sqrt(det(cov2D)), measured before the anti-aliasing filter below,
+        // which would give even a point a footprint of several pixels.
+        float det = cov2D[0][0] * cov2D[1][1] - cov2D[0][1] * cov2D[1][0];
+        float area = 3.14159265f * k * k * sqrt(max(det, 0.0f));
+
+        // use the fact that the convolution of a gaussian with another gaussian is the sum
+        // of their covariance matrices to apply a low-pass filter to anti-alias the splats
+        cov2D[0][0] += filterVariance;
+        cov2D[1][1] += filterVariance;
+
+        // the inverse is passed to the pixel shader, to avoid doing a matrix inverse per pixel.
+        mat2 cov2Dinv = inverseMat2(cov2D);
+        record.cov2inv = vec4(cov2Dinv[0], cov2Dinv[1]); // cram it into a vec4
+
+        // compute 2d extents for the splat, using covariance matrix ellipse
+        // see https://cookierobotics.com/007/
+        float a = cov2D[0][0];
+        float b = cov2D[0][1];
+        float c = cov2D[1][1];
+        float apco2 = (a + c) / 2.0f;
+        float amco2 = (a - c) / 2.0f;
+        float term = sqrt(amco2 * amco2 + b * b);
+        float maj = apco2 + term;
+        float min = apco2 - term;
+
+        float theta;
+        if (b == 0.0f)
+        {
+            theta = (a >= c) ? 0.0f : radians(90.0f);
+        }
+        else
+        {
+            theta = atan(maj - a, b);
+        }
+
+        float r1 = k * sqrt(maj);
+        float r2 = k * sqrt(min);
+        vec2 majAxis = vec2(r1 * cos(theta), r1 * sin(theta));
+        vec2 minAxis = vec2(r2 * cos(theta + radians(90.0f)), r2 * sin(theta + radians(90.0f)));
+        record.axes = vec4(majAxis, minAxis);
+
+        // maj includes the anti-aliasing filter, which adds filterVariance to both eigenvalues.
+        if (k * sqrt(max(maj - filterVariance, 0.0f)) < pointRadius)
+        {
+            alpha = PointAlpha(alpha, cov2D);
+
+            // a one pixel square covers exactly one pixel center, where the gaussian is evaluated as a constant 1.
+            record.axes = vec4(0.5f, 0.0f, 0.0f, 0.5f);
+            record.cov2inv = vec4(0.0f);
+        }
+
+        // the quad must overlap the viewport, its corners are +/- majAxis +/- minAxis.
+        vec2 extent = (abs(majAxis) + abs(minAxis)) * vec2(2.0f / WIDTH, 2.0f / HEIGHT);
+        visible = area >= minPixelArea && alpha > (1.0f / 256.0f) &&
+            abs(ndcP.x) - extent.x < 1.0f &&
+            abs(ndcP.y) - extent.y < 1.0f;
+
+#ifndef REPROJECT
+        if (visible && occlusionCull != 0U)
+        {
+            visible = !IsOccluded(position.xyz, abs(majAxis) + abs(minAxis));
+        }
+#endif
+    }
+
+#ifdef REPROJECT
+    // the radiance is shared with the view of the sort, only the alpha depends on this view.
+    // it is kept for invisible records too, because the view of the sort may still need it after an in place reprojection.
+    record.color = vec4(g_records[id].color.rgb, alpha);
+    if (!visible)
+    {
+        // keep the record, so the order from the sort is still valid, but draw nothing.
+        record.axes = vec4(0.0f);
+        record.cov2inv = vec4(0.0f);
+        record.color.a = 0.0f;
+    }
+    g_reprojected[id] = record;
+#else
+    if (!visible)
+    {
+        return;
+    }
+    uint slot = atomicCounterIncrement(output_count);
+    g_keys[slot] = keyMax - uint((p4.w / Z_FAR) * float(keyMax));
+    g_vals[slot] = slot;
+
+    // compute radiance from sh
+    vec3 v = normalize(position.xyz - eye);
+    record.color = vec4(ComputeRadianceFromSH(v), alpha);
+
+#ifdef FRAMEBUFFER_SRGB
+    // see splat_vert.glsl, the splat color is converted to linear but blending occurs in linear space.
+    record.color.rgb = SRGBToLinear(record.color.rgb);
+#endif
+
+    g_records[slot] = record;
+#endif
+}
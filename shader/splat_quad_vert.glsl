@@ -0,0 +1,93 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// 3d gaussian splat vertex shader, without a geometry shader.
+// Each splat is an instance of a 4 vertex triangle strip, gl_InstanceID indexes into the output of the sort,
+// which points at the SplatRecord written for this frame by splat_preprocess_compute.glsl.
+//
+// When STEREO is defined, both views of a stereo pair are drawn in a single pass into the layers of a layered framebuffer.
+// With MULTIVIEW, each instance is expanded once per view by GL_OVR_multiview2, otherwise the instances alternate between
+// the two views and select the layer with gl_Layer (GL_ARB_shader_viewport_layer_array). SplatRenderer adds the extension.
+// The records of the second view are in their own buffer.
+//
+
+/*%%HEADER%%*/
+
+/*%%DEFINES%%*/
+
+#ifdef MULTIVIEW
+layout(num_views = 2) in;
+#endif
+
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform int indexBase;  // index of the first instance in the sort output
+uniform int indexStep;  // 1 = back to front, -1 = front to back
+
+// struct SplatRecord, see SPLAT_RECORD_MEMBERS in splatrenderer.cpp
+/*%%SPLAT_RECORD%%*/
+
+layout(std430, binding = 0) readonly buffer splat_records {
+    SplatRecord g_records[];
+};
+
+layout(std430, binding = 1) readonly buffer sorted_indices {
+    uint g_indices[];
+};
+
+#ifdef STEREO
+layout(std430, binding = 2) readonly buffer second_view_records {
+    SplatRecord g_secondViewRecords[];
+};
+#endif
+
+out vec4 frag_color;  // radiance of splat
+out vec4 frag_cov2inv;  // inverse of the 2D screen space covariance matrix of the guassian
+out vec2 frag_p;  // the 2D screen space center of the gaussian
+
+void main(void)
+{
+#if defined(MULTIVIEW)
+    int view = int(gl_ViewID_OVR);
+    int instance = gl_InstanceID;
+#elif defined(STEREO)
+    int view = gl_InstanceID & 1;
+    int instance = gl_InstanceID >> 1;
+    gl_Layer = view;
+#else
+    int instance = gl_InstanceID;
+#endif
+
+    uint index = g_indices[indexBase + indexStep * instance];
+#ifdef STEREO
+    SplatRecord record = (view == 0) ? g_records[index] : g_secondViewRecords[index];
+#else
+    SplatRecord record = g_records[index];
+#endif
+
+    if (record.color.a <= 0.0f)
+    {
+        // culled, collapse all four corners onto a point that is clipped.
+        gl_Position = vec4(0.0f, 0.0f, 2.0f, 1.0f);
+        frag_color = vec4(0.0f);
+        frag_cov2inv = vec4(0.0f);
+        frag_p = vec2(0.0f);
+        return;
+    }
+
+    vec2 size = viewport.zw;
+
+    // same corner order as the triangle strip emitted by splat_geom.glsl
+    // 0 = maj + min, 1 = -maj + min, 2 = maj - min, 3 = -maj - min
+    vec2 corner = vec2(1.0f - 2.0f * float(gl_VertexID & 1), 1.0f - 2.0f * float(gl_VertexID >> 1));
+    vec2 offset = corner.x * record.axes.xy + corner.y * record.axes.zw;
+
+    // the quad is flat, so it can be emitted directly in ndc.
+    gl_Position = vec4(record.p.xy + offset * (2.0f / size), record.p.z, 1.0f);
+
+    frag_color = record.color;
+    frag_cov2inv = record.cov2inv;
+    frag_p = 0.5f * (size + record.p.xy * size) + viewport.xy;
+}
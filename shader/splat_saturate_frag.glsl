@@ -0,0 +1,25 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// used between the front to back splat chunks, marks the pixels that are already (nearly) opaque,
+// by writing the depth from splat_saturate_vert.glsl. every later splat fragment covering them then fails the early depth test.
+//
+
+/*%%HEADER%%*/
+
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform sampler2D colorTex;
+uniform float minTransmittance;
+
+void main(void)
+{
+    // the alpha accumulated by the under operator is one minus the transmittance
+    float alpha = texelFetch(colorTex, ivec2(gl_FragCoord.xy - viewport.xy), 0).a;
+    if (1.0f - alpha > minTransmittance)
+    {
+        discard;
+    }
+}
@@ -0,0 +1,32 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// full screen triangle for splat_saturate_frag.glsl, at the depth of the farthest splat drawn so far.
+// later splats are all at or behind it, so they fail the depth test, and the depth buffer ends up holding
+// the depth at which each pixel saturated, used to build the occluder pyramid.
+//
+
+/*%%HEADER%%*/
+
+uniform int depthIndex;  // index of the farthest splat drawn so far, in the output of the sort
+
+// struct SplatRecord, see SPLAT_RECORD_MEMBERS in splatrenderer.cpp
+/*%%SPLAT_RECORD%%*/
+
+layout(std430, binding = 0) readonly buffer splat_records {
+    SplatRecord g_records[];
+};
+
+layout(std430, binding = 1) readonly buffer sorted_indices {
+    uint g_indices[];
+};
+
+void main(void)
+{
+    // gl_VertexID 0, 1, 2 = (-1, -1), (3, -1), (-1, 3)
+    vec2 p = vec2(float((gl_VertexID & 1) << 2) - 1.0f, float((gl_VertexID & 2) << 1) - 1.0f);
+    gl_Position = vec4(p, g_records[g_indices[depthIndex]].p.z, 1.0f);
+}
@@ -0,0 +1,53 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// Measures how far the draw order is from a fresh sort, for SplatRenderer::GetSortDepthError().
+// Counts the adjacent pairs of drawn splats whose window depths are inverted, i.e. the nearer one is drawn first,
+// after the records were reprojected to the view of the draw.
+//
+
+/*%%HEADER%%*/
+
+layout(local_size_x = 256) in;
+
+uniform uint numSplats;  // number of sorted records
+
+// struct SplatRecord, see SPLAT_RECORD_MEMBERS in splatrenderer.cpp
+/*%%SPLAT_RECORD%%*/
+
+layout(std430, binding = 0) readonly buffer splat_records {
+    SplatRecord g_records[];
+};
+
+layout(std430, binding = 1) readonly buffer sorted_indices {
+    uint g_indices[];  // back to front
+};
+
+layout(binding = 0, offset = 0) uniform atomic_uint inverted_count;
+layout(binding = 0, offset = 4) uniform atomic_uint pair_count;
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i + 1U >= numSplats)
+    {
+        return;
+    }
+
+    // culled records are not drawn, so they are not part of any pair.
+    SplatRecord a = g_records[g_indices[i]];
+    SplatRecord b = g_records[g_indices[i + 1U]];
+    if (a.color.a <= 0.0f || b.color.a <= 0.0f)
+    {
+        return;
+    }
+
+    atomicCounterIncrement(pair_count);
+    if (b.p.z > a.p.z)
+    {
+        atomicCounterIncrement(inverted_count);
+    }
+}
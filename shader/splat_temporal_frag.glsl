@@ -0,0 +1,113 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// temporal upsampling of SplatRenderer::RenderTemporal(), combines the jittered low resolution splats of this frame
+// with the full resolution history of the previous frames, reprojected with the camera motion and the expected depth of each pixel.
+// writes the new history, the color is premultiplied, like the other splat targets.
+//
+
+/*%%HEADER%%*/
+
+// history is rejected if its depth differs from the reprojected depth by more then this fraction, i.e. it was disoccluded.
+#define DEPTH_TOLERANCE 0.1f
+
+// how fast the weight of the current sample falls off with its distance to the pixel center, in full resolution pixels.
+#define SAMPLE_SHARPNESS 4.0f
+
+// a pixel mixes splats at different depths, but is reprojected with a single depth. the others land off by about
+// motion * depth spread pixels, the history is faded out at 1 / PARALLAX_SCALE pixels of that error.
+#define PARALLAX_SCALE 8.0f
+
+// pixels with less alpha have no meaningful depth, they are treated as empty.
+#define MIN_ALPHA (1.0f / 256.0f)
+
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT of the full resolution output, the history has the same size
+uniform vec2 lowSize;  // size of the low resolution target
+uniform vec2 jitter;  // offset of the low resolution image this frame, in low resolution pixels
+uniform vec2 nearFar;
+uniform mat4 invProjMat;  // of this frame, without the jitter
+uniform mat4 reprojMat;  // from the view space of this frame to the view space of the history
+uniform mat4 historyProjMat;
+uniform int historyValid;
+uniform sampler2D colorTex;  // low resolution, premultiplied, with linear filtering
+uniform sampler2D depthTex;  // low resolution, r and g are the alpha weighted sums of the view space depth and its square, a is alpha, with linear filtering
+uniform sampler2D historyTex;  // with linear filtering
+uniform sampler2D historyDepthTex;  // expected view space depth of the history
+
+layout(location = 0) out vec4 out_color;
+layout(location = 1) out vec4 out_depth;
+
+void main(void)
+{
+    vec2 p = gl_FragCoord.xy - viewport.xy;
+    vec2 scale = lowSize / viewport.zw;
+
+    // the jitter moves the whole low resolution image, so this is where the center of this pixel landed in it.
+    vec2 lowP = p * scale + jitter;
+    ivec2 texel = clamp(ivec2(floor(lowP)), ivec2(0), ivec2(lowSize) - 1);
+    vec4 nearest = texelFetch(colorTex, texel, 0);
+    vec4 spatial = texture(colorTex, lowP / lowSize);
+
+    // weight of the nearest sample, one if it was taken exactly at the center of this pixel.
+    vec2 d = (vec2(texel) + 0.5f - lowP) / scale;
+    float w = exp(-SAMPLE_SHARPNESS * dot(d, d));
+
+    // range of the samples around this pixel, history that moved is clamped to it, so it can not bring back anything that is gone.
+    // a static view is not clamped, the range of the low resolution samples would cut off details that are only in the history.
+    vec4 minColor = nearest;
+    vec4 maxColor = nearest;
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            vec4 c = texelFetch(colorTex, clamp(texel + ivec2(x, y), ivec2(0), ivec2(lowSize) - 1), 0);
+            minColor = min(minColor, c);
+            maxColor = max(maxColor, c);
+        }
+    }
+
+    vec4 depthSum = texture(depthTex, lowP / lowSize);
+    float depth = nearFar.y;
+    float depthSpread = 0.0f;  // standard deviation of the depth in this pixel, relative to the depth
+    if (depthSum.a > MIN_ALPHA)
+    {
+        depth = depthSum.r / depthSum.a;
+        depthSpread = sqrt(max(depthSum.g / depthSum.a - depth * depth, 0.0f)) / depth;
+    }
+
+    // reproject the expected surface of this pixel into the history
+    vec2 ndc = 2.0f * (p / viewport.zw) - 1.0f;
+    vec4 farPos = invProjMat * vec4(ndc, 1.0f, 1.0f);
+    vec3 viewPos = farPos.xyz * (depth / -(farPos.z));
+    vec4 historyViewPos = reprojMat * vec4(viewPos, 1.0f);
+    vec4 historyClipPos = historyProjMat * historyViewPos;
+
+    bool accept = historyValid != 0 && historyClipPos.w > 0.0f;
+    vec2 historyUv = (historyClipPos.xy / historyClipPos.w) * 0.5f + 0.5f;
+    accept = accept && all(greaterThanEqual(historyUv, vec2(0.0f))) && all(lessThan(historyUv, vec2(1.0f)));
+    if (accept)
+    {
+        // disocclusion, something else was at this point of the history.
+        float historyDepth = texelFetch(historyDepthTex, ivec2(historyUv * viewport.zw), 0).r;
+        float expectedDepth = -historyViewPos.z;
+        accept = abs(historyDepth - expectedDepth) <= DEPTH_TOLERANCE * expectedDepth;
+    }
+
+    if (accept)
+    {
+        vec4 history = texture(historyTex, historyUv);
+        float motion = length(historyUv * viewport.zw - p);
+        history = mix(history, clamp(history, minColor, maxColor), clamp(motion, 0.0f, 1.0f));
+        float parallax = motion * depthSpread;
+        vec4 current = mix(spatial, nearest, w);
+        out_color = mix(history, current, max(w, clamp(PARALLAX_SCALE * parallax, 0.0f, 1.0f)));
+    }
+    else
+    {
+        out_color = mix(spatial, nearest, w);
+    }
+    out_depth = vec4(depth, 0.0f, 0.0f, 0.0f);
+}
@@ -0,0 +1,119 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// Bins each visible SplatRecord into the TILE_SIZE x TILE_SIZE screen tiles covered by its quad.
+// One key/value pair is written per covered tile, the key is the tile index in the high bits and the
+// front to back depth in the low bits, so after the sort the splats of each tile are contiguous and in blend order.
+//
+
+/*%%HEADER%%*/
+
+#define TILE_SIZE 16.0f
+#define NUM_DEPTH_BUCKETS 240
+
+layout(local_size_x = 256) in;
+
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform uint numTilesX;
+uniform uint numTilesY;
+uniform uint tileBits;  // number of high bits of the key used for the tile index
+uniform uint numSplats;  // number of records written by splat_preprocess_compute.glsl
+uniform uint maxEntries;  // size of the key and value buffers
+uniform uint maxDepthBucket;  // splats in a farther DepthBucket() are dropped, when there would be more then maxEntries entries
+
+// struct SplatRecord, see SPLAT_RECORD_MEMBERS in splatrenderer.cpp
+/*%%SPLAT_RECORD%%*/
+
+layout(std430, binding = 0) readonly buffer splat_records {
+    SplatRecord g_records[];
+};
+
+// back to front depth keys, written by splat_preprocess_compute.glsl
+layout(std430, binding = 1) readonly buffer depth_keys {
+    uint g_depthKeys[];
+};
+
+layout(std430, binding = 2) writeonly buffer tile_keys {
+    uint g_keys[];
+};
+
+layout(std430, binding = 3) writeonly buffer tile_vals {
+    uint g_vals[];
+};
+
+// total number of entries, may be larger then maxEntries, in which case nothing past maxEntries is written.
+// the histogram counts the entries of every splat by DepthBucket(), including the dropped ones,
+// so SplatRenderer can pick the maxDepthBucket that fits.
+layout(std430, binding = 4) buffer entry_count {
+    uint g_numEntries;
+    uint g_depthHistogram[NUM_DEPTH_BUCKETS];
+};
+
+// front to back depth quantized with a 3 bit mantissa, so every bucket covers the same fraction of its distance.
+uint DepthBucket(uint depth)
+{
+    if (depth < 8U)
+    {
+        return depth;
+    }
+    int shift = findMSB(depth) - 3;
+    return uint(shift) * 8U + (depth >> uint(shift));
+}
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= numSplats)
+    {
+        return;
+    }
+
+    SplatRecord record = g_records[id];
+
+    // bounds of the quad in pixels, relative to the viewport, same corners as splat_quad_vert.glsl
+    vec2 size = viewport.zw;
+    vec2 center = 0.5f * (size + record.p.xy * size);
+    vec2 extent = abs(record.axes.xy) + abs(record.axes.zw);
+    vec2 lo = center - extent;
+    vec2 hi = center + extent;
+    if (hi.x < 0.0f || hi.y < 0.0f || lo.x > size.x || lo.y > size.y)
+    {
+        return;
+    }
+
+    vec2 maxTile = vec2(float(numTilesX - 1U), float(numTilesY - 1U));
+    uvec2 tileLo = uvec2(clamp(floor(lo / TILE_SIZE), vec2(0.0f), maxTile));
+    uvec2 tileHi = uvec2(clamp(floor(hi / TILE_SIZE), vec2(0.0f), maxTile));
+    uint count = (tileHi.x - tileLo.x + 1U) * (tileHi.y - tileLo.y + 1U);
+
+    uint frontToBackDepth = ~g_depthKeys[id];
+    uint bucket = DepthBucket(frontToBackDepth);
+    atomicAdd(g_depthHistogram[bucket], count);
+    if (bucket > maxDepthBucket)
+    {
+        return;
+    }
+
+    // past maxEntries, SplatRenderer will grow the buffers or lower maxDepthBucket, and try again.
+    // the entries that still fit are written, so there are no holes below maxEntries.
+    uint base = atomicAdd(g_numEntries, count);
+    uint end = min(base + count, maxEntries);
+
+    // the low bits of the inverted key are enough to keep splats in depth order within a tile
+    uint depthBits = 32U - tileBits;
+    uint depth = frontToBackDepth >> tileBits;
+    uint i = base;
+    for (uint y = tileLo.y; y <= tileHi.y && i < end; y++)
+    {
+        for (uint x = tileLo.x; x <= tileHi.x && i < end; x++)
+        {
+            uint tile = y * numTilesX + x;
+            g_keys[i] = (tile << depthBits) | depth;
+            g_vals[i] = id;
+            i++;
+        }
+    }
+}
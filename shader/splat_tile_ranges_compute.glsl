@@ -0,0 +1,44 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// Finds the range of sorted entries that belong to each tile, by looking for the boundaries between tile indices.
+// Tiles without any splats are left as zero by SplatRenderer.
+//
+
+/*%%HEADER%%*/
+
+layout(local_size_x = 256) in;
+
+uniform uint numEntries;
+uniform uint tileBits;
+
+layout(std430, binding = 0) readonly buffer sorted_keys {
+    uint g_keys[];
+};
+
+layout(std430, binding = 1) writeonly buffer tile_ranges {
+    uvec2 g_ranges[];  // x = first entry, y = one past the last entry
+};
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= numEntries)
+    {
+        return;
+    }
+
+    uint shift = 32U - tileBits;
+    uint tile = g_keys[i] >> shift;
+    if (i == 0U || (g_keys[i - 1U] >> shift) != tile)
+    {
+        g_ranges[tile].x = i;
+    }
+    if (i == numEntries - 1U || (g_keys[i + 1U] >> shift) != tile)
+    {
+        g_ranges[tile].y = i + 1U;
+    }
+}
@@ -0,0 +1,148 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// Rasterizes one TILE_SIZE x TILE_SIZE tile per workgroup, one invocation per pixel.
+// The splats of the tile are loaded into shared memory a batch at a time, and blended front to back,
+// until the transmittance of every pixel in the tile falls below TRANSMITTANCE_MIN.
+// Same gaussian evaluation as splat_frag.glsl, the result is premultiplied color and alpha.
+// The depth at which each pixel saturates is written to depthImage, for the occluder pyramid.
+//
+
+/*%%HEADER%%*/
+
+/*%%DEFINES%%*/
+
+#define TILE_SIZE 16U
+#define BATCH_SIZE 256U  // TILE_SIZE * TILE_SIZE
+#define TRANSMITTANCE_MIN 0.0001f
+#define OCCLUDER_TRANSMITTANCE (1.0f / 256.0f)  // must match MIN_TRANSMITTANCE in splatrenderer.cpp
+
+#ifdef FALLOFF_LUT
+// see splat_frag.glsl
+#define FALLOFF_MAX_Q 11.090355f  // 2 * ln(256)
+#define FALLOFF_SIZE 256.0f
+uniform sampler2D falloffTex;
+#endif
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform uint numTilesX;
+
+// struct SplatRecord, see SPLAT_RECORD_MEMBERS in splatrenderer.cpp
+/*%%SPLAT_RECORD%%*/
+
+layout(std430, binding = 0) readonly buffer splat_records {
+    SplatRecord g_records[];
+};
+
+layout(std430, binding = 1) readonly buffer sorted_vals {
+    uint g_vals[];
+};
+
+layout(std430, binding = 2) readonly buffer tile_ranges {
+    uvec2 g_ranges[];
+};
+
+layout(binding = 0, rgba16f) writeonly uniform highp image2D outImage;
+layout(binding = 1, r32f) writeonly uniform highp image2D depthImage;
+
+shared vec2 s_p[BATCH_SIZE];
+shared vec4 s_cov2inv[BATCH_SIZE];
+shared vec4 s_color[BATCH_SIZE];
+shared float s_depth[BATCH_SIZE];
+shared uint s_numDone;
+
+void main()
+{
+    uint lID = gl_LocalInvocationIndex;
+    uvec2 pix = gl_GlobalInvocationID.xy;
+    vec2 size = viewport.zw;
+    bool inside = pix.x < uint(size.x) && pix.y < uint(size.y);
+
+    // same coordinates as gl_FragCoord in splat_frag.glsl
+    vec2 fragCoord = vec2(pix) + vec2(0.5f) + viewport.xy;
+
+    uvec2 range = g_ranges[gl_WorkGroupID.y * numTilesX + gl_WorkGroupID.x];
+
+    vec3 color = vec3(0.0f);
+    float T = 1.0f;
+    float depth = 1.0f;  // window depth at which T fell below OCCLUDER_TRANSMITTANCE
+    bool done = !inside;
+
+    // range is the same for the whole workgroup, so every invocation reaches the barriers.
+    for (uint batchStart = range.x; batchStart < range.y; batchStart += BATCH_SIZE)
+    {
+        // wait for the previous batch to be finished with shared memory
+        barrier();
+        if (lID == 0U)
+        {
+            s_numDone = 0U;
+        }
+        barrier();
+        if (done)
+        {
+            atomicAdd(s_numDone, 1U);
+        }
+
+        uint i = batchStart + lID;
+        if (i < range.y)
+        {
+            SplatRecord record = g_records[g_vals[i]];
+            s_p[lID] = 0.5f * (size + record.p.xy * size) + viewport.xy;
+            s_cov2inv[lID] = record.cov2inv;
+            s_color[lID] = record.color;
+            s_depth[lID] = 0.5f * record.p.z + 0.5f;
+        }
+        barrier();
+
+        // every pixel in the tile is saturated, the rest of the splats are hidden.
+        if (s_numDone == BATCH_SIZE)
+        {
+            break;
+        }
+
+        uint batchCount = min(BATCH_SIZE, range.y - batchStart);
+        for (uint j = 0U; j < batchCount && !done; j++)
+        {
+            // evaluate the gaussian
+            vec2 d = fragCoord - s_p[j];
+            mat2 cov2Dinv = mat2(s_cov2inv[j].xy, s_cov2inv[j].zw);
+            float q = dot(d, cov2Dinv * d);
+#ifdef FALLOFF_LUT
+            float u = (q / FALLOFF_MAX_Q) * ((FALLOFF_SIZE - 1.0f) / FALLOFF_SIZE) + (0.5f / FALLOFF_SIZE);
+            float g = textureLod(falloffTex, vec2(u, 0.5f), 0.0f).r;
+#else
+            float g = exp(-0.5f * q);
+#endif
+            // point splats only cover the pixel they are centered in, see splat_preprocess_compute.glsl
+            if (s_cov2inv[j] == vec4(0.0f) && floor(fragCoord) != floor(s_p[j]))
+            {
+                g = 0.0f;
+            }
+            float alpha = s_color[j].a * g;
+            if (alpha <= (1.0f / 256.0f))
+            {
+                continue;
+            }
+
+            // front to back, under operator
+            color += T * alpha * s_color[j].rgb;
+            T *= (1.0f - alpha);
+            if (T < OCCLUDER_TRANSMITTANCE && depth == 1.0f)
+            {
+                depth = s_depth[j];
+            }
+            done = T < TRANSMITTANCE_MIN;
+        }
+    }
+
+    if (inside)
+    {
+        imageStore(outImage, ivec2(pix), vec4(color, 1.0f - T));
+        imageStore(depthImage, ivec2(pix), vec4(depth, 0.0f, 0.0f, 0.0f));
+    }
+}
@@ -13,7 +13,6 @@
 
 uniform mat4 viewMat;  // used to project position into view coordinates.
 uniform mat4 projMat;  // used to project view coordinates into clip coordinates.
-uniform vec4 projParams;  // x = HEIGHT / tan(FOVY / 2), y = Z_NEAR, z = Z_FAR
 uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
 uniform vec3 eye;
 
@@ -156,29 +155,25 @@ void main(void)
     float alpha = position.w;
     vec4 t = viewMat * vec4(position.xyz, 1.0f);
 
-    //float X0 = viewport.x;
-    float X0 = viewport.x * (0.00001f * projParams.y);  // one weird hack to prevent projParams from being compiled away
+    float X0 = viewport.x;
     float Y0 = viewport.y;
     float WIDTH = viewport.z;
     float HEIGHT = viewport.w;
-    float Z_NEAR = projParams.y;
-    float Z_FAR = projParams.z;
 
     // J is the jacobian of the projection and viewport transformations.
     // this is an affine approximation of the real projection.
     // because gaussians are closed under affine transforms.
     float SX = projMat[0][0];
     float SY = projMat[1][1];
-    float WZ =  projMat[3][2];
     float tzSq = t.z * t.z;
     float jsx = -(SX * WIDTH) / (2.0f * t.z);
     float jsy = -(SY * HEIGHT) / (2.0f * t.z);
     float jtx = (SX * t.x * WIDTH) / (2.0f * tzSq);
     float jty = (SY * t.y * HEIGHT) / (2.0f * tzSq);
-    float jtz = ((Z_FAR - Z_NEAR) * WZ) / (2.0f * tzSq);
+    // the depth row of J is left out, the covariance is projected onto the xy plane below, so it never contributes.
     mat3 J = mat3(vec3(jsx, 0.0f, 0.0f),
                   vec3(0.0f, jsy, 0.0f),
-                  vec3(jtx, jty, jtz));
+                  vec3(jtx, jty, 0.0f));
 
     // combine the affine transforms of W (viewMat) and J (approx of viewportMat * projMat)
     // using the fact that the new transformed covariance matrix V_Prime = JW * V * (JW)^T
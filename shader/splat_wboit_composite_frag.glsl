@@ -0,0 +1,34 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+//
+// resolves the weighted blended targets written by splat_frag.glsl into premultiplied color and alpha,
+// the blend state is the same as the other splat draw modes.
+//
+
+/*%%HEADER%%*/
+
+uniform vec4 viewport;  // x, y, WIDTH, HEIGHT
+uniform sampler2D colorTex;  // rgb = weighted sum of premultiplied color, a = revealage
+uniform sampler2D weightTex;  // r = weighted sum of alpha
+
+out vec4 out_color;
+
+void main(void)
+{
+    // the sums are clamped to the largest half float, so a pixel where they overflowed to inf still resolves to a finite color.
+    const float HALF_MAX = 65504.0f;
+
+    ivec2 p = ivec2(gl_FragCoord.xy - viewport.xy);
+    vec4 accum = texelFetch(colorTex, p, 0);
+    vec3 color = min(accum.rgb, vec3(HALF_MAX));
+    float weight = min(texelFetch(weightTex, p, 0).r, HALF_MAX);
+    float alpha = clamp(1.0f - accum.a, 0.0f, 1.0f);
+
+    // the weighted average color of the splats covering this pixel, premultiplied by their combined coverage.
+    // the scaled weight of a faint distant splat can be far below 1e-5, so only a zero weight is skipped.
+    vec3 average = (weight > 0.0f) ? color / weight : vec3(0.0f);
+    out_color = vec4(alpha * average, alpha);
+}
@@ -14,6 +14,7 @@
 #include <SDL2/SDL.h>
 #endif
 
+#include <algorithm>
 #include <filesystem>
 #include <thread>
 
@@ -27,10 +28,13 @@
 #include "core/framebuffer.h"
 #include "core/log.h"
 #include "core/debugrenderer.h"
+#include "core/gpusorter.h"
+#include "core/gputimer.h"
 #include "core/inputbuddy.h"
 #include "core/optionparser.h"
 #include "core/textrenderer.h"
 #include "core/texture.h"
+#include "core/simxrbuddy.h"
 #include "core/util.h"
 #include "core/xrbuddy.h"
 
@@ -54,6 +58,27 @@ enum optionIndex
     FP16,
     FP32,
     NOSH,
+    CPUSORT,
+    SORTBENCH,
+    GEOMSHADER,
+    NOLUT,
+    MINSPLATAREA,
+    TILES,
+    FRONTTOBACK,
+    OCCLUSIONCULL,
+    OIT,
+    POINTRADIUS,
+    DYNRES,
+    SINGLEPASS,
+    FOVEATE,
+    SORTLEAD,
+    PIPELINE,
+    MIRRORRATE,
+    XRSIM,
+    XRSIMUNPACED,
+    TEMPORAL,
+    IDLE,
+    SORTPIPELINE,
 };
 
 const option::Descriptor usage[] =
@@ -66,6 +91,30 @@ const option::Descriptor usage[] =
     { FP16, 0, "", "fp16", option::Arg::None,             "  --fp16            Use 16-bit half-precision floating frame buffer, to reduce color banding artifacts" },
     { FP32, 0, "", "fp32", option::Arg::None,             "  --fp32            Use 32-bit floating point frame buffer, to reduce color banding even more" },
     { NOSH, 0, "", "nosh", option::Arg::None,             "  --nosh            Don't load/render full sh, this will reduce memory usage and higher performance" },
+    { CPUSORT, 0, "", "cpusort", option::Arg::None,       "  --cpusort         Sort splats on cpu worker threads, for gpus with slow or missing compute shader support" },
+    { SORTBENCH, 0, "", "sortbench", option::Arg::None,   "  --sortbench       Test and benchmark every sort backend then exit, no FILE is needed.\n"
+                                                          "                    Use LIBGL_ALWAYS_SOFTWARE=1 and xvfb-run to run without a gpu or display." },
+    { GEOMSHADER, 0, "", "geomshader", option::Arg::None, "  --geomshader      Expand splats into quads with a geometry shader, instead of instanced quads" },
+    { NOLUT, 0, "", "nolut", option::Arg::None,           "  --nolut           Evaluate the splat gaussian with exp(), instead of a lookup texture" },
+    { MINSPLATAREA, 0, "", "minsplatarea", option::Arg::Optional, "  --minsplatarea=N  Cull splats with a footprint smaller then N pixels before sorting, default is 0 (disabled)" },
+    { TILES, 0, "", "tiles", option::Arg::None,           "  --tiles           Blend splats in 16x16 pixel tiles with a compute shader, instead of instanced quads" },
+    { FRONTTOBACK, 0, "", "fronttoback", option::Arg::None, "  --fronttoback     Blend instanced quads front to back, skipping pixels that are already opaque" },
+    { OCCLUSIONCULL, 0, "", "occlusioncull", option::Arg::None, "  --occlusioncull   Cull splats hidden behind opaque pixels in the previous frame, needs --fronttoback or --tiles" },
+    { OIT, 0, "", "oit", option::Arg::None,               "  --oit             Skip the sort, and blend splats with weighted blended order independent transparency" },
+    { POINTRADIUS, 0, "", "pointradius", option::Arg::Optional, "  --pointradius=N   Draw splats with a radius smaller then N pixels as a single pixel, default is 0 (disabled)" },
+    { DYNRES, 0, "", "dynres", option::Arg::Optional,     "  --dynres=N        Scale the render resolution to hold a gpu frame time of N ms, default is 11.1 (90 hz)" },
+    { SINGLEPASS, 0, "", "singlepass", option::Arg::None, "  --singlepass      Render both vr eyes in a single pass into a layered target, needs instanced quads" },
+    { FOVEATE, 0, "", "foveate", option::Arg::Optional,   "  --foveate=N       Render vr eyes at full resolution only around the gaze or the lens center, the rest at N times\n"
+                                                          "                    the resolution, default is 0.5" },
+    { SORTLEAD, 0, "", "sortlead", option::Arg::Optional, "  --sortlead=N      Sort vr frames from the head pose predicted N frames ahead, with a wider cull, default is 1" },
+    { PIPELINE, 0, "", "pipeline", option::Arg::None,     "  --pipeline        Wait for the next vr frame on its own thread, overlapping it with input and rendering" },
+    { MIRRORRATE, 0, "", "mirrorrate", option::Arg::Optional, "  --mirrorrate=N    Redraw the desktop mirror of vr at most N times per second, 0 disables it, default is every frame" },
+    { XRSIM, 0, "", "xrsim", option::Arg::Optional, "  --xrsim=FILE      Benchmark vr mode without a headset, with synthetic head motion or the poses recorded in FILE" },
+    { XRSIMUNPACED, 0, "", "xrsimunpaced", option::Arg::None, "  --xrsimunpaced    With --xrsim, render frames back to back instead of at the display rate" },
+    { TEMPORAL, 0, "", "temporal", option::Arg::Optional, "  --temporal=N      Render splats at N times the resolution with a jitter, and accumulate the frames into a full\n"
+                                                          "                    resolution history that follows the camera motion, default is 0.5" },
+    { IDLE, 0, "", "idle", option::Arg::None,             "  --idle            Show the last frame again while the camera, window and options are unchanged, instead of redrawing it" },
+    { SORTPIPELINE, 0, "", "sortpipeline", option::Arg::None, "  --sortpipeline    Draw the splats in the order sorted for an earlier frame, while the sort of this frame is in flight, needs --cpusort" },
     { UNKNOWN, 0, "", "", option::Arg::None,              "\nExamples:\n  splataplut data/test.ply\n  splatapult -v data/test.ply" },
     { 0, 0, 0, 0, 0, 0}
 };
@@ -81,6 +130,28 @@ const glm::vec4 WHITE = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
 const glm::vec4 BLACK = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 const int TEXT_NUM_ROWS = 25;
 
+// dynamic resolution, see App::UpdateRenderScale()
+const float MIN_RENDER_SCALE = 0.5f;
+const float RENDER_SCALE_STEP = 0.05f;
+const float RENDER_SCALE_HEADROOM = 0.8f;  // the scale is only raised when the frame time is below this fraction of the target
+const float UPSCALE_SHARPNESS = 0.2f;
+const float MIN_FRAME_TIME_TARGET = 1.0f;  // ms, range of --dynres
+const float MAX_FRAME_TIME_TARGET = 1000.0f;
+
+// smallest render scale accepted by --temporal and --foveate
+const float MIN_OPTION_RENDER_SCALE = 0.25f;
+
+// foveated rendering, see ComputeFovea()
+const float FOVEA_SIZE = 0.4f;  // fraction of the width and height of each eye
+
+// idle frame reuse, see App::Render()
+const int IDLE_SETTLE_FRAMES = 16;  // with --temporal, frames drawn after the last change, so the history converges before it is reused
+const int IDLE_SLEEP_MS = 10;  // between presents of a reused frame, vsync may be disabled, so the loop would spin otherwise
+
+// pose predicted sort, see PredictEyeMat()
+const float SORT_MIN_MARGIN = glm::radians(1.0f);
+const float SORT_MARGIN_SCALE = 1.5f;  // the predicted rotation is padded by this factor, for changes in the angular velocity
+
 #include <string>
 #include <filesystem>
 #include <iostream>
@@ -164,7 +235,9 @@ static void Clear(glm::ivec2 windowSize, bool setViewport = true)
 }
 
 // Draw a textured quad over the entire screen.
-static void RenderDesktop(glm::ivec2 windowSize, std::shared_ptr<Program> desktopProgram, uint32_t colorTexture, bool adjustAspect)
+// uvScale selects the lower left portion of colorTexture.
+static void RenderDesktop(glm::ivec2 windowSize, std::shared_ptr<Program> desktopProgram, uint32_t colorTexture, bool adjustAspect,
+                          const glm::vec2& uvScale = glm::vec2(1.0f, 1.0f))
 {
     int width = windowSize.x;
     int height = windowSize.y;
@@ -194,7 +267,7 @@ static void RenderDesktop(glm::ivec2 windowSize, std::shared_ptr<Program> deskto
             xyUpperRight = glm::vec2((float)width, (height + width) / 2.0f);
         }
         glm::vec2 uvLowerLeft(0.0f, 0.0f);
-        glm::vec2 uvUpperRight(1.0f, 1.0f);
+        glm::vec2 uvUpperRight = uvScale;
 
         float depth = -9.0f;
         glm::vec3 positions[] = {glm::vec3(xyLowerLeft, depth), glm::vec3(xyUpperRight.x, xyLowerLeft.y, depth),
@@ -211,6 +284,57 @@ static void RenderDesktop(glm::ivec2 windowSize, std::shared_ptr<Program> deskto
     }
 }
 
+// returns the fovea rect (x, y, width, height) in pixels relative to the viewport, centered on the gaze if it is valid,
+// otherwise on the lens center, where the optical axis of the eye crosses the image of its (off center) projection.
+static glm::vec4 ComputeFovea(const glm::mat4& projMat, const glm::mat4& eyeMat, const glm::vec4& viewport,
+                              bool gazeValid, const glm::quat& gazeRot)
+{
+    glm::vec2 ndc(-projMat[2][0], -projMat[2][1]);
+    if (gazeValid)
+    {
+        // the gaze is treated as a direction, the point it converges on is too far away to matter.
+        glm::vec3 gazeDir = glm::vec3(glm::inverse(eyeMat) * glm::vec4(gazeRot * glm::vec3(0.0f, 0.0f, -1.0f), 0.0f));
+        glm::vec4 clipP = projMat * glm::vec4(gazeDir, 0.0f);
+        if (clipP.w > 0.0f)
+        {
+            ndc = glm::clamp(glm::vec2(clipP) / clipP.w, glm::vec2(-1.0f), glm::vec2(1.0f));
+        }
+    }
+
+    glm::vec2 viewportSize(viewport.z, viewport.w);
+    glm::vec2 size = glm::round(FOVEA_SIZE * viewportSize);
+    glm::vec2 center = 0.5f * (ndc + glm::vec2(1.0f)) * viewportSize;
+    glm::vec2 corner = glm::clamp(glm::round(center - 0.5f * size), glm::vec2(0.0f), viewportSize - size);
+    return glm::vec4(corner, size);
+}
+
+// extrapolates eyeMat by dt seconds, with the linear and angular velocity of the head at headPos, all in the stage space.
+static glm::mat4 PredictEyeMat(const glm::mat4& eyeMat, const glm::vec3& headPos,
+                               const glm::vec3& linearVel, const glm::vec3& angularVel, float dt)
+{
+    glm::mat4 motionMat = glm::translate(glm::mat4(1.0f), headPos + linearVel * dt);
+    float angle = glm::length(angularVel) * dt;
+    if (angle > 0.0f)
+    {
+        motionMat = glm::rotate(motionMat, angle, angularVel / glm::length(angularVel));
+    }
+    motionMat = glm::translate(motionMat, -headPos);
+    return motionMat * eyeMat;
+}
+
+// returns the float argument of a command line option clamped to [minValue, maxValue], warns when it was out of range.
+static float ClampedFloatArg(const char* name, const char* arg, float minValue, float maxValue)
+{
+    float value = (float)atof(arg);
+    if (!(value >= minValue && value <= maxValue))
+    {
+        float clamped = (value > maxValue) ? maxValue : minValue;
+        Log::W("--%s=%s is out of range [%g, %g], using %g\n", name, arg, minValue, maxValue, clamped);
+        return clamped;
+    }
+    return value;
+}
+
 static std::shared_ptr<PointCloud> LoadPointCloud(const std::string& plyFilename, bool useLinearColors)
 {
     auto pointCloud = std::make_shared<PointCloud>(useLinearColors);
@@ -313,6 +437,14 @@ App::ParseResult App::ParseArguments(int argc, const char* argv[])
         opt.vrMode = true;
     }
 
+    if (options[XRSIM])
+    {
+        opt.vrMode = true;
+        opt.xrSim = true;
+        opt.xrSimPoseFilename = options[XRSIM].arg ? options[XRSIM].arg : "";
+        opt.xrSimPaced = options[XRSIMUNPACED] ? false : true;
+    }
+
     if (options[FULLSCREEN])
     {
         opt.fullscreen = true;
@@ -333,6 +465,58 @@ App::ParseResult App::ParseArguments(int argc, const char* argv[])
     }
 
     opt.importFullSH = options[NOSH] ? false : true;
+    opt.cpuSort = options[CPUSORT] ? true : false;
+    opt.sortBench = options[SORTBENCH] ? true : false;
+    opt.geomShader = options[GEOMSHADER] ? true : false;
+    opt.falloffLut = options[NOLUT] ? false : true;
+    opt.computeTiles = options[TILES] ? true : false;
+    opt.frontToBack = options[FRONTTOBACK] ? true : false;
+    opt.occlusionCulling = options[OCCLUSIONCULL] ? true : false;
+    opt.weightedBlended = options[OIT] ? true : false;
+    if (options[MINSPLATAREA] && options[MINSPLATAREA].arg)
+    {
+        opt.minSplatArea = (float)atof(options[MINSPLATAREA].arg);
+    }
+    if (options[POINTRADIUS] && options[POINTRADIUS].arg)
+    {
+        opt.pointRadius = (float)atof(options[POINTRADIUS].arg);
+    }
+    if (options[DYNRES])
+    {
+        opt.dynamicResolution = true;
+        if (options[DYNRES].arg)
+        {
+            opt.frameTimeTarget = ClampedFloatArg("dynres", options[DYNRES].arg, MIN_FRAME_TIME_TARGET, MAX_FRAME_TIME_TARGET);
+        }
+    }
+    opt.singlePassStereo = options[SINGLEPASS] ? true : false;
+    if (options[SORTLEAD])
+    {
+        opt.sortLead = options[SORTLEAD].arg ? (float)atof(options[SORTLEAD].arg) : 1.0f;
+    }
+    opt.pipelined = options[PIPELINE] ? true : false;
+    opt.idleReuse = options[IDLE] ? true : false;
+    opt.sortPipelining = options[SORTPIPELINE] ? true : false;
+    if (options[MIRRORRATE] && options[MIRRORRATE].arg)
+    {
+        opt.mirrorRate = (float)atof(options[MIRRORRATE].arg);
+    }
+    if (options[TEMPORAL])
+    {
+        opt.temporal = true;
+        if (options[TEMPORAL].arg)
+        {
+            opt.temporalScale = ClampedFloatArg("temporal", options[TEMPORAL].arg, MIN_OPTION_RENDER_SCALE, 1.0f);
+        }
+    }
+    if (options[FOVEATE])
+    {
+        opt.foveation = true;
+        if (options[FOVEATE].arg)
+        {
+            opt.peripheryScale = ClampedFloatArg("foveate", options[FOVEATE].arg, MIN_OPTION_RENDER_SCALE, 1.0f);
+        }
+    }
 
     bool unknownOptionFound = false;
     for (option::Option* opt = options[UNKNOWN]; opt; opt = opt->next())
@@ -345,6 +529,12 @@ App::ParseResult App::ParseArguments(int argc, const char* argv[])
         return ERROR_RESULT;
     }
 
+    if (opt.sortBench)
+    {
+        Log::SetLevel(opt.debugLogging ? Log::Debug : Log::Warning);
+        return SUCCESS_RESULT;
+    }
+
     if (parse.nonOptionsCount() == 0)
     {
         std::cout << "Expected filename argument\n";
@@ -407,12 +597,23 @@ bool App::Init()
 
     if (opt.vrMode)
     {
-        xrBuddy = std::make_shared<XrBuddy>(mainContext, glm::vec2(Z_NEAR, Z_FAR));
+        if (opt.xrSim)
+        {
+            SimXrBuddy::Config config;
+            config.poseFilename = opt.xrSimPoseFilename;
+            config.paced = opt.xrSimPaced;
+            xrBuddy = std::make_shared<SimXrBuddy>(mainContext, glm::vec2(Z_NEAR, Z_FAR), config);
+        }
+        else
+        {
+            xrBuddy = std::make_shared<XrBuddy>(mainContext, glm::vec2(Z_NEAR, Z_FAR));
+        }
         if (!xrBuddy->Init())
         {
             Log::E("OpenXR Init failed\n");
             return false;
         }
+        xrBuddy->SetPipelined(opt.pipelined);
     }
 
     std::string camerasConfigFilename = FindConfigFile(plyFilename, "cameras.json");
@@ -519,13 +720,6 @@ bool App::Init()
             Log::E("Error loading PointCloud\n");
             return false;
         }
-
-        pointRenderer = std::make_shared<PointRenderer>();
-        if (!pointRenderer->Init(pointCloud, isFramebufferSRGBEnabled))
-        {
-            Log::E("Error initializing point renderer!\n");
-            return false;
-        }
     }
     else
     {
@@ -546,17 +740,57 @@ bool App::Init()
     gaussianCloud->PruneSplats(focalPoint, SPLAT_COUNT);
 #endif
 
+    // a single sorter is shared by the point and splat renderers, so they share the sort scratch buffers.
+    gpuSorter = std::make_shared<GpuSorter>();
+    GpuSorter::Backend sortBackend = GpuSorter::Backend::Auto;
+    if (opt.cpuSort)
+    {
+        sortBackend = GpuSorter::Backend::CpuRadixSort;
+    }
+    size_t maxNumSortElements = gaussianCloud->GetNumGaussians();
+    if (pointCloud)
+    {
+        maxNumSortElements = std::max(maxNumSortElements, pointCloud->GetNumPoints());
+    }
+    if (!gpuSorter->Init(maxNumSortElements, sortBackend))
+    {
+        Log::E("Error initializing gpu sorter!\n");
+        return false;
+    }
+
+    if (pointCloud)
+    {
+        pointRenderer = std::make_shared<PointRenderer>();
+        if (!pointRenderer->Init(pointCloud, isFramebufferSRGBEnabled, gpuSorter))
+        {
+            Log::E("Error initializing point renderer!\n");
+            return false;
+        }
+    }
+
     splatRenderer = std::make_shared<SplatRenderer>();
-#if __ANDROID__
-    bool useRgcSortOverride = true;
-#else
-    bool useRgcSortOverride = false;
-#endif
-    if (!splatRenderer->Init(gaussianCloud, isFramebufferSRGBEnabled, useRgcSortOverride))
+    if (!splatRenderer->Init(gaussianCloud, isFramebufferSRGBEnabled, gpuSorter, opt.falloffLut))
     {
         Log::E("Error initializing splat renderer!\n");
         return false;
     }
+    if (opt.geomShader)
+    {
+        splatRenderer->SetDrawMode(SplatRenderer::DrawMode::GeometryShader);
+    }
+    else if (opt.computeTiles)
+    {
+        splatRenderer->SetDrawMode(SplatRenderer::DrawMode::ComputeTiles);
+    }
+    else if (opt.weightedBlended)
+    {
+        splatRenderer->SetDrawMode(SplatRenderer::DrawMode::WeightedBlended);
+    }
+    splatRenderer->SetFrontToBack(opt.frontToBack);
+    splatRenderer->SetOcclusionCulling(opt.occlusionCulling);
+    splatRenderer->SetSortPipelining(opt.sortPipelining);
+    splatRenderer->SetMinPixelArea(opt.minSplatArea);
+    splatRenderer->SetPointRadius(opt.pointRadius);
 
     if (opt.vrMode)
     {
@@ -598,15 +832,104 @@ bool App::Init()
             {
                 pointRenderer->Render(fullEyeMat, projMat, viewport, nearFar);
             }
+            else if (opt.foveation)
+            {
+                // the gaze is in the stage space, like eyeMat before the carpet is applied.
+                glm::vec4 fovea = ComputeFovea(projMat, eyeMat, viewport, gazeValid, gazeRot);
+                splatRenderer->RenderFoveated(fullEyeMat, projMat, viewport, nearFar, fovea, opt.peripheryScale);
+            }
+            else if (opt.temporal)
+            {
+                // each eye has its own history
+                splatRenderer->RenderTemporal(fullEyeMat, projMat, viewport, nearFar, opt.temporalScale, (uint32_t)viewNum);
+            }
+            else
+            {
+                splatRenderer->Render(fullEyeMat, projMat, viewport, nearFar);
+            }
+        });
+
+        // one sort is shared by both eyes, from a center eye, culled against both eye frusta.
+        xrBuddy->SetPreRenderCallback([this](
+            const glm::mat4* projMats, const glm::mat4* eyeMats, uint32_t numViews,
+            const glm::vec4& viewport, const glm::vec2& nearFar)
+        {
+            if (opt.drawPointCloud && pointRenderer)
+            {
+                return;
+            }
+
+            // the eyes are at the predicted display time of this frame, a sort that is used sortLead frames later
+            // is computed from the head pose extrapolated to then, and culled with a margin for the error in that guess.
+            // a pipelined sort is read back at the next Sort() and drawn at the one after that, at the earliest.
+            // there is one Sort() per frame with --singlepass, otherwise one per eye.
+            float pipelineLead = opt.singlePassStereo ? 2.0f : 1.0f;
+            float sortLead = opt.sortLead + ((opt.sortLead > 0.0f && splatRenderer->GetSortPipelining()) ? pipelineLead : 0.0f);
+            float sortLeadTime = sortLead * xrBuddy->GetPredictedDisplayPeriod();
+            glm::vec3 headPos(0.0f), linearVel(0.0f), angularVel(0.0f);
+            bool posValid = false, posTracked = false, linearValid = false, angularValid = false;
+            if (sortLeadTime > 0.0f)
+            {
+                xrBuddy->GetActionPosition("head_pose", &headPos, &posValid, &posTracked);
+                xrBuddy->GetActionLinearVelocity("head_pose", &linearVel, &linearValid);
+                xrBuddy->GetActionAngularVelocity("head_pose", &angularVel, &angularValid);
+                linearVel = (posValid && linearValid) ? linearVel : glm::vec3(0.0f);
+                angularVel = (posValid && angularValid) ? angularVel : glm::vec3(0.0f);
+                splatRenderer->SetSortMargin(SORT_MIN_MARGIN + SORT_MARGIN_SCALE * glm::length(angularVel) * sortLeadTime);
+            }
             else
             {
-                if (viewNum == 0)
+                splatRenderer->SetSortMargin(0.0f);
+            }
+
+            glm::mat4 fullEyeMats[2];
+            for (uint32_t i = 0; i < std::min(numViews, 2u); i++)
+            {
+                glm::mat4 sortEyeMat = eyeMats[i];
+                if (sortLeadTime > 0.0f)
                 {
-                    splatRenderer->Sort(fullEyeMat, projMat, viewport, nearFar);
+                    sortEyeMat = PredictEyeMat(eyeMats[i], headPos, linearVel, angularVel, sortLeadTime);
                 }
-                splatRenderer->Render(fullEyeMat, projMat, viewport, nearFar);
+                fullEyeMats[i] = magicCarpet->GetCarpetMat() * sortEyeMat;
+            }
+
+            if (numViews == 2)
+            {
+                splatRenderer->SortStereo(fullEyeMats, projMats, viewport, nearFar);
+            }
+            else
+            {
+                splatRenderer->Sort(fullEyeMats[0], projMats[0], viewport, nearFar);
             }
         });
+
+        if (opt.singlePassStereo)
+        {
+            // draws both eyes with a single sort and a single draw call, frames that also need the
+            // line, carpet or point renderers, foveation or temporal upsampling, return false and fall back to the per view callback above.
+            xrBuddy->SetStereoRenderCallback([this](
+                const glm::mat4* projMats, const glm::mat4* eyeMats,
+                const glm::vec4& viewport, const glm::vec2& nearFar)
+            {
+                if ((opt.drawDebug && !debugRenderer->IsEmpty()) ||
+                    (cameraPathRenderer && (opt.drawCameraFrustums || opt.drawCameraPath)) ||
+                    opt.drawCarpet || (opt.drawPointCloud && pointRenderer) || opt.foveation || opt.temporal ||
+                    !splatRenderer->IsStereoSupported())
+                {
+                    return false;
+                }
+
+                Clear(glm::ivec2(0, 0), false);
+
+                glm::mat4 fullEyeMats[2] =
+                {
+                    magicCarpet->GetCarpetMat() * eyeMats[0],
+                    magicCarpet->GetCarpetMat() * eyeMats[1]
+                };
+                splatRenderer->RenderStereo(fullEyeMats, projMats, viewport, nearFar);
+                return true;
+            }, splatRenderer->IsStereoMultiview());
+        }
     }
 
     if (!opt.vrMode && opt.frameBuffer != Options::FrameBuffer::Default)
@@ -619,6 +942,38 @@ bool App::Init()
         }
     }
 
+    if (opt.temporal && !splatRenderer->IsTemporalSupported())
+    {
+        Log::W("--temporal needs instanced quads without --fronttoback, rendering at full resolution\n");
+        opt.temporal = false;
+    }
+
+    if (opt.dynamicResolution)
+    {
+        if (opt.vrMode)
+        {
+            Log::W("--dynres is not supported in vr mode\n");
+            opt.dynamicResolution = false;
+        }
+        else if (!GpuTimer::IsSupported())
+        {
+            Log::W("--dynres needs gpu timer queries, which are not supported\n");
+            opt.dynamicResolution = false;
+        }
+        else
+        {
+            upscaleProgram = std::make_shared<Program>();
+            std::string defines = "#define USE_SHARPENING\n";
+            upscaleProgram->AddMacro("DEFINES", defines);
+            if (!upscaleProgram->LoadVertFrag("shader/desktop_vert.glsl", "shader/desktop_frag.glsl"))
+            {
+                Log::E("Error loading upscale shader!\n");
+                return false;
+            }
+            frameTimer = std::make_shared<GpuTimer>();
+        }
+    }
+
 #ifdef USE_SDL
     inputBuddy = std::make_shared<InputBuddy>();
 
@@ -799,6 +1154,37 @@ bool App::Init()
         virtualUp += down ? -1.0f : 1.0f;
     });
 
+    inputBuddy->OnKey(SDLK_i, [this](bool down, uint16_t mod)
+    {
+        if (down)
+        {
+            // cycle quads -> tiles -> oit -> gs
+            switch (splatRenderer->GetDrawMode())
+            {
+            case SplatRenderer::DrawMode::InstancedQuads:
+                splatRenderer->SetDrawMode(SplatRenderer::DrawMode::ComputeTiles);
+                break;
+            case SplatRenderer::DrawMode::ComputeTiles:
+                splatRenderer->SetDrawMode(SplatRenderer::DrawMode::WeightedBlended);
+                break;
+            case SplatRenderer::DrawMode::WeightedBlended:
+                splatRenderer->SetDrawMode(SplatRenderer::DrawMode::GeometryShader);
+                break;
+            default:
+                splatRenderer->SetDrawMode(SplatRenderer::DrawMode::InstancedQuads);
+                break;
+            }
+        }
+    });
+
+    inputBuddy->OnKey(SDLK_o, [this](bool down, uint16_t mod)
+    {
+        if (down)
+        {
+            splatRenderer->SetFrontToBack(!splatRenderer->GetFrontToBack());
+        }
+    });
+
     inputBuddy->OnMouseButton([this](uint8_t button, bool down, glm::ivec2 pos)
     {
         if (button == 3) // right button
@@ -837,6 +1223,39 @@ void App::ProcessEvent(const SDL_Event& event)
 void App::UpdateFps(float fps)
 {
     std::string text = "fps: " + std::to_string((int)fps);
+    if (splatRenderer && splatRenderer->GetDrawMs() > 0.0)
+    {
+        const char* modeName = "gs";
+        if (splatRenderer->GetDrawMode() == SplatRenderer::DrawMode::InstancedQuads)
+        {
+            modeName = splatRenderer->GetFrontToBack() ? "quads f2b" : "quads";
+        }
+        else if (splatRenderer->GetDrawMode() == SplatRenderer::DrawMode::ComputeTiles)
+        {
+            modeName = "tiles";
+        }
+        else if (splatRenderer->GetDrawMode() == SplatRenderer::DrawMode::WeightedBlended)
+        {
+            modeName = "oit";
+        }
+        char temp[64];
+        snprintf(temp, sizeof(temp), ", sort: %.2f ms, splats (%s): %.2f ms", splatRenderer->GetSortMs(), modeName, splatRenderer->GetDrawMs());
+        text += temp;
+        if (splatRenderer->GetOverdraw() > 0.0)
+        {
+            snprintf(temp, sizeof(temp), ", overdraw: %.1fx", splatRenderer->GetOverdraw());
+            text += temp;
+        }
+        if (splatRenderer->GetSortPipelining())
+        {
+            snprintf(temp, sizeof(temp), ", sort error: %.1f%%", splatRenderer->GetSortDepthError() * 100.0);
+            text += temp;
+        }
+    }
+    if (opt.dynamicResolution)
+    {
+        text += ", res: " + std::to_string((int)(renderScale * 100.0f + 0.5f)) + "%";
+    }
     textRenderer->RemoveText(fpsText);
     fpsText = textRenderer->AddScreenTextWithDropShadow(glm::ivec2(0, 0), TEXT_NUM_ROWS, WHITE, BLACK, text);
 
@@ -849,27 +1268,27 @@ void App::UpdateFps(float fps)
     {
         float dFps = fpsVec[1] - fpsVec[0];
 
-        uint32_t x = splatRenderer->numBlocksPerWorkgroup - STEP_SIZE;
+        uint32_t x = gpuSorter->numBlocksPerWorkgroup - STEP_SIZE;
         Log::E("    (%.3f -> %.3f) dFps = %.3f, x = %u\n", fpsVec[0], fpsVec[1], dFps, x);
         if (dFps < 0)
         {
             Log::E("    FPS DOWN, new x = %u\n", x - STEP_SIZE);
-            if (splatRenderer->numBlocksPerWorkgroup > STEP_SIZE)
+            if (gpuSorter->numBlocksPerWorkgroup > STEP_SIZE)
             {
-                splatRenderer->numBlocksPerWorkgroup = x - STEP_SIZE;
+                gpuSorter->numBlocksPerWorkgroup = x - STEP_SIZE;
             }
         }
         else
         {
             Log::E("    FPS UP, new x = %u\n", x + STEP_SIZE);
-            splatRenderer->numBlocksPerWorkgroup = x + STEP_SIZE;
+            gpuSorter->numBlocksPerWorkgroup = x + STEP_SIZE;
         }
 
         fpsVec.clear();
     }
     else
     {
-        splatRenderer->numBlocksPerWorkgroup = splatRenderer->numBlocksPerWorkgroup + STEP_SIZE;
+        gpuSorter->numBlocksPerWorkgroup = gpuSorter->numBlocksPerWorkgroup + STEP_SIZE;
     }
 #endif
 }
@@ -905,6 +1324,14 @@ bool App::Process(float dt)
         xrBuddy->GetActionPosition("r_aim_pose", &rightPose.pos, &rightPose.posValid, &rightPose.posTracked);
         xrBuddy->GetActionOrientation("r_aim_pose", &rightPose.rot, &rightPose.rotValid, &rightPose.rotTracked);
 
+        // "gaze_pose" is missing when the runtime has no eye tracking, then the fovea stays at the lens center.
+        gazeValid = false;
+        if (opt.foveation)
+        {
+            bool tracked = false;
+            xrBuddy->GetActionOrientation("gaze_pose", &gazeRot, &gazeValid, &tracked);
+        }
+
         glm::vec2 leftStick(0.0f, 0.0f);
         glm::vec2 rightStick(0.0f, 0.0f);
         bool valid = false;
@@ -982,29 +1409,37 @@ bool App::Render(float dt, const glm::ivec2& windowSize)
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
 #ifndef __ANDROID__
-        // render desktop.
-        Clear(windowSize, true);
-        RenderDesktop(windowSize, desktopProgram, xrBuddy->GetColorTexture(), true);
-
-        if (opt.drawFps)
+        // render desktop, the headset sets the frame rate, so the mirror is only redrawn as often as opt.mirrorRate allows.
+        mirrorTimer += dt;
+        presentFrame = opt.mirrorRate < 0.0f || (opt.mirrorRate > 0.0f && mirrorTimer >= 1.0f / opt.mirrorRate);
+        if (presentFrame)
         {
-            glm::vec4 viewport(0.0f, 0.0f, (float)width, (float)height);
-            glm::vec2 nearFar(Z_NEAR, Z_FAR);
-            glm::mat4 projMat = glm::perspective(FOVY, (float)width / (float)height, Z_NEAR, Z_FAR);
-            textRenderer->Render(glm::mat4(1.0f), projMat, viewport, nearFar);
+            mirrorTimer = 0.0f;
+            Clear(windowSize, true);
+            RenderDesktop(windowSize, desktopProgram, xrBuddy->GetColorTexture(), true);
+
+            if (opt.drawFps)
+            {
+                glm::vec4 viewport(0.0f, 0.0f, (float)width, (float)height);
+                glm::vec2 nearFar(Z_NEAR, Z_FAR);
+                glm::mat4 projMat = glm::perspective(FOVY, (float)width / (float)height, Z_NEAR, Z_FAR);
+                textRenderer->Render(glm::mat4(1.0f), projMat, viewport, nearFar);
+            }
         }
 #endif
     }
     else
     {
-        // lazy init of fbo, fbo is only used for HalfFloat, Float option.
-        if (opt.frameBuffer != Options::FrameBuffer::Default && fboSize != windowSize)
+        // lazy init of fbo, fbo is only used for HalfFloat, Float option, dynamic resolution and idle frame reuse.
+        bool useFbo = opt.frameBuffer != Options::FrameBuffer::Default || opt.dynamicResolution || opt.idleReuse;
+        if (useFbo && fboSize != windowSize)
         {
             fbo = std::make_shared<FrameBuffer>();
 
+            // dynamic resolution upscales with bilinear filtering
             Texture::Params texParams;
-            texParams.minFilter = FilterType::Nearest;
-            texParams.magFilter = FilterType::Nearest;
+            texParams.minFilter = opt.dynamicResolution ? FilterType::Linear : FilterType::Nearest;
+            texParams.magFilter = opt.dynamicResolution ? FilterType::Linear : FilterType::Nearest;
             texParams.sWrap = WrapType::ClampToEdge;
             texParams.tWrap = WrapType::ClampToEdge;
             if (opt.frameBuffer == Options::FrameBuffer::HalfFloat)
@@ -1019,6 +1454,12 @@ bool App::Render(float dt, const glm::ivec2& windowSize)
                                                         GL_RGBA32F, GL_RGBA, GL_FLOAT,
                                                         texParams);
             }
+            else if (opt.dynamicResolution || opt.idleReuse)
+            {
+                fboColorTex = std::make_shared<Texture>(windowSize.x, windowSize.y,
+                                                        GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE,
+                                                        texParams);
+            }
             else
             {
                 Log::E("BAD opt.frameBuffer type!\n");
@@ -1027,58 +1468,140 @@ bool App::Render(float dt, const glm::ivec2& windowSize)
             fbo->AttachColor(fboColorTex);
 
             fboSize = windowSize;
+            idleFrames = 0;
         }
 
-        if (opt.frameBuffer != Options::FrameBuffer::Default && fbo)
+        // the gpu time of the previous frame picks the resolution of this one, without stalling the pipeline.
+        if (frameTimer && frameTimerPending && frameTimer->IsAvailable())
         {
-            fbo->Bind();
+            UpdateRenderScale(frameTimer->Resolve()[0].ms);
+            frameTimerPending = false;
         }
 
-        Clear(windowSize, true);
+        // the scene is rendered into the lower left corner of the fbo, the texture is not resized every time the scale changes.
+        glm::ivec2 renderSize = windowSize;
+        if (opt.dynamicResolution)
+        {
+            renderSize = glm::max(glm::ivec2(glm::vec2(windowSize) * renderScale + 0.5f), glm::ivec2(1, 1));
+        }
 
         glm::mat4 cameraMat = flyCam->GetCameraMat();
-        glm::vec4 viewport(0.0f, 0.0f, (float)width, (float)height);
+        glm::vec4 viewport(0.0f, 0.0f, (float)renderSize.x, (float)renderSize.y);
         glm::vec2 nearFar(Z_NEAR, Z_FAR);
         glm::mat4 projMat = glm::perspective(FOVY, (float)width / (float)height, Z_NEAR, Z_FAR);
 
-        if (opt.drawDebug)
+        // the fbo still holds the last frame, if nothing that is drawn into it changed since then, it is shown again without
+        // a sort or a draw. debug lines are submitted every frame, so a frame with any of them is always drawn.
+        bool reuseFrame = false;
+        if (opt.idleReuse)
         {
-            debugRenderer->Render(cameraMat, projMat, viewport, nearFar);
-        }
+            ViewState viewState;
+            viewState.cameraMat = cameraMat;
+            viewState.renderSize = renderSize;
+            viewState.drawMode = (int)splatRenderer->GetDrawMode();
+            viewState.frontToBack = splatRenderer->GetFrontToBack();
+            viewState.drawPointCloud = opt.drawPointCloud;
+            viewState.drawCarpet = opt.drawCarpet;
+            viewState.drawCameraFrustums = opt.drawCameraFrustums;
+            viewState.drawCameraPath = opt.drawCameraPath;
+            bool debugLines = opt.drawDebug && !debugRenderer->IsEmpty();
+            if (debugLines || !viewState.Equals(lastViewState))
+            {
+                idleFrames = 0;
+            }
+            lastViewState = viewState;
 
-        if (cameraPathRenderer)
-        {
-            cameraPathRenderer->SetShowCameras(opt.drawCameraFrustums);
-            cameraPathRenderer->SetShowPath(opt.drawCameraPath);
-            cameraPathRenderer->Render(cameraMat, projMat, viewport, nearFar);
+            // a pipelined sort is drawn a frame after the view it was sorted for.
+            int settleFrames = opt.temporal ? IDLE_SETTLE_FRAMES : (opt.sortPipelining ? 2 : 1);
+            reuseFrame = idleFrames >= settleFrames;
+            idleFrames++;
         }
 
-        if (opt.drawCarpet)
+        if (!reuseFrame)
         {
-            magicCarpet->Render(cameraMat, projMat, viewport, nearFar);
-        }
+            bool timeFrame = frameTimer && !frameTimerPending;
+            if (timeFrame)
+            {
+                frameTimer->Reset();
+                frameTimer->Begin("frame");
+            }
 
-        if (opt.drawPointCloud && pointRenderer)
-        {
-            pointRenderer->Render(cameraMat, projMat, viewport, nearFar);
+            if (useFbo && fbo)
+            {
+                fbo->Bind();
+            }
+
+            Clear(renderSize, true);
+
+            if (opt.drawDebug)
+            {
+                debugRenderer->Render(cameraMat, projMat, viewport, nearFar);
+            }
+
+            if (cameraPathRenderer)
+            {
+                cameraPathRenderer->SetShowCameras(opt.drawCameraFrustums);
+                cameraPathRenderer->SetShowPath(opt.drawCameraPath);
+                cameraPathRenderer->Render(cameraMat, projMat, viewport, nearFar);
+            }
+
+            if (opt.drawCarpet)
+            {
+                magicCarpet->Render(cameraMat, projMat, viewport, nearFar);
+            }
+
+            if (opt.drawPointCloud && pointRenderer)
+            {
+                pointRenderer->Render(cameraMat, projMat, viewport, nearFar);
+            }
+            else
+            {
+                splatRenderer->Sort(cameraMat, projMat, viewport, nearFar);
+                if (opt.temporal)
+                {
+                    splatRenderer->RenderTemporal(cameraMat, projMat, viewport, nearFar, opt.temporalScale);
+                }
+                else
+                {
+                    splatRenderer->Render(cameraMat, projMat, viewport, nearFar);
+                }
+            }
+
+            if (timeFrame)
+            {
+                frameTimer->End();
+                frameTimerPending = true;
+            }
         }
         else
         {
-            splatRenderer->Sort(cameraMat, projMat, viewport, nearFar);
-            splatRenderer->Render(cameraMat, projMat, viewport, nearFar);
+            std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_SLEEP_MS));
         }
 
-        if (opt.drawFps)
-        {
-            textRenderer->Render(cameraMat, projMat, viewport, nearFar);
-        }
-
-        if (opt.frameBuffer != Options::FrameBuffer::Default && fbo)
+        if (useFbo && fbo)
         {
             // render fbo colorTexture as a full screen quad to the default fbo
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
             Clear(windowSize, true);
-            RenderDesktop(windowSize, desktopProgram, fbo->GetColorTexture()->texture, false);
+            if (opt.dynamicResolution)
+            {
+                glm::vec2 uvScale = glm::vec2(renderSize) / glm::vec2(windowSize);
+                upscaleProgram->Bind();
+                upscaleProgram->SetUniform("uvMax", uvScale);
+                upscaleProgram->SetUniform("sharpness", renderSize != windowSize ? UPSCALE_SHARPNESS : 0.0f);
+                RenderDesktop(windowSize, upscaleProgram, fbo->GetColorTexture()->texture, false, uvScale);
+            }
+            else
+            {
+                RenderDesktop(windowSize, desktopProgram, fbo->GetColorTexture()->texture, false);
+            }
+        }
+
+        // text is drawn at full resolution, after the upscale.
+        if (opt.drawFps)
+        {
+            glm::vec4 windowViewport(0.0f, 0.0f, (float)width, (float)height);
+            textRenderer->Render(cameraMat, projMat, windowViewport, nearFar);
         }
     }
 
@@ -1089,6 +1612,31 @@ bool App::Render(float dt, const glm::ivec2& windowSize)
     return true;
 }
 
+// Picks the render scale of the next frame from the gpu time of a previous one.
+// The cost of a fill rate bound frame is proportional to its pixel count, which is the square of the scale.
+// The scale drops as soon as the target is missed, but only rises one step at a time once there is headroom,
+// and it is quantized so the renderers offscreen targets are not reallocated every frame.
+void App::UpdateRenderScale(double frameMs)
+{
+    if (frameMs <= 0.0)
+    {
+        return;
+    }
+
+    float target = opt.frameTimeTarget;
+    float newScale = renderScale;
+    if (frameMs > target)
+    {
+        newScale = renderScale * sqrtf(target / (float)frameMs);
+        newScale = floorf(newScale / RENDER_SCALE_STEP) * RENDER_SCALE_STEP;
+    }
+    else if (frameMs < RENDER_SCALE_HEADROOM * target)
+    {
+        newScale = renderScale + RENDER_SCALE_STEP;
+    }
+    renderScale = glm::clamp(newScale, MIN_RENDER_SCALE, 1.0f);
+}
+
 void App::OnQuit(const VoidCallback& cb)
 {
     quitCallback = cb;
@@ -7,6 +7,7 @@
 
 #include <functional>
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <memory>
 #include <string>
 
@@ -18,6 +19,8 @@ class DebugRenderer;
 class FlyCam;
 struct FrameBuffer;
 class GaussianCloud;
+class GpuSorter;
+class GpuTimer;
 class InputBuddy;
 class MagicCarpet;
 class PointCloud;
@@ -46,11 +49,15 @@ public:
     ParseResult ParseArguments(int argc, const char* argv[]);
     bool Init();
     bool IsFullscreen() const { return opt.fullscreen; }
+    bool IsSortBench() const { return opt.sortBench; }
     void UpdateFps(float fps);
     void ProcessEvent(const SDL_Event& event);
     bool Process(float dt);
     bool Render(float dt, const glm::ivec2& windowSize);
 
+    // false if the last Render() drew nothing into the window, i.e. a vr frame without a desktop mirror, so there is nothing to swap.
+    bool ShouldPresent() const { return presentFrame; }
+
     using VoidCallback = std::function<void()>;
     void OnQuit(const VoidCallback& cb);
 
@@ -76,9 +83,36 @@ public:
         bool drawCameraFrustums = false;
         bool drawCameraPath = false;
         bool importFullSH = true;
+        bool cpuSort = false;
+        bool sortBench = false;
+        bool geomShader = false;
+        bool falloffLut = true;
+        bool computeTiles = false;
+        bool frontToBack = false;
+        bool occlusionCulling = false;
+        bool weightedBlended = false;
+        float minSplatArea = 0.0f;
+        float pointRadius = 0.0f;
+        bool dynamicResolution = false;
+        float frameTimeTarget = 11.1f;  // ms
+        bool singlePassStereo = false;
+        bool foveation = false;
+        float peripheryScale = 0.5f;
+        bool temporal = false;
+        float temporalScale = 0.5f;
+        bool idleReuse = false;  // desktop only, show the last frame again while nothing that is drawn into it changed
+        float sortLead = 0.0f;  // frames
+        bool sortPipelining = false;  // instanced quads only, draw the order of the previous sort
+        bool pipelined = false;
+        float mirrorRate = -1.0f;  // desktop mirror redraws per second in vr, negative is every frame, zero disables it
+        bool xrSim = false;  // vr mode with SimXrBuddy instead of an openxr runtime
+        std::string xrSimPoseFilename;
+        bool xrSimPaced = true;
     };
 
 protected:
+    void UpdateRenderScale(double frameMs);
+
     MainContext& mainContext;
     Options opt;
     std::string plyFilename;
@@ -96,6 +130,7 @@ protected:
 
     std::shared_ptr<PointCloud> pointCloud;
     std::shared_ptr<GaussianCloud> gaussianCloud;
+    std::shared_ptr<GpuSorter> gpuSorter;
     std::shared_ptr<PointRenderer> pointRenderer;
     std::shared_ptr<SplatRenderer> splatRenderer;
 
@@ -104,6 +139,42 @@ protected:
     glm::ivec2 fboSize = {0, 0};
     std::shared_ptr<Texture> fboColorTex;
 
+    // dynamic resolution, the scene is rendered into the lower left renderScale portion of fboColorTex.
+    std::shared_ptr<Program> upscaleProgram;
+    std::shared_ptr<GpuTimer> frameTimer;
+    bool frameTimerPending = false;
+    float renderScale = 1.0f;
+
+    // idle frame reuse, the state the frame in fbo was drawn with, and the number of frames since it last changed.
+    struct ViewState
+    {
+        glm::mat4 cameraMat = glm::mat4(0.0f);
+        glm::ivec2 renderSize = glm::ivec2(0, 0);
+        int drawMode = -1;
+        bool frontToBack = false;
+        bool drawPointCloud = false;
+        bool drawCarpet = false;
+        bool drawCameraFrustums = false;
+        bool drawCameraPath = false;
+
+        bool Equals(const ViewState& other) const
+        {
+            return cameraMat == other.cameraMat && renderSize == other.renderSize && drawMode == other.drawMode &&
+                frontToBack == other.frontToBack && drawPointCloud == other.drawPointCloud && drawCarpet == other.drawCarpet &&
+                drawCameraFrustums == other.drawCameraFrustums && drawCameraPath == other.drawCameraPath;
+        }
+    };
+    ViewState lastViewState;
+    int idleFrames = 0;
+
+    // eye tracking, in the stage space, used to place the fovea.
+    glm::quat gazeRot = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    bool gazeValid = false;
+
+    // vr desktop mirror, see Options::mirrorRate
+    float mirrorTimer = 0.0f;
+    bool presentFrame = true;
+
     std::shared_ptr<InputBuddy> inputBuddy;
 
     glm::vec2 virtualLeftStick;
@@ -0,0 +1,527 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "cpusorter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#define CPUSORTER_USE_SSE
+#endif
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#else
+#define ZoneScoped
+#define ZoneScopedNC(NAME, COLOR)
+#endif
+
+// 8 bits per pass, 4 passes.
+static const uint32_t RADIX_BITS = 8;
+static const uint32_t RADIX_BINS = 1 << RADIX_BITS;
+static const uint32_t NUM_PASSES = 32 / RADIX_BITS;
+
+// don't bother splitting up work into chunks smaller then this.
+static const uint32_t MIN_CHUNK_SIZE = 16384;
+
+// For positive floats the ieee bit pattern is monotonic, so inverting it gives a key that sorts far to near.
+static inline uint32_t DepthToKey(float depth)
+{
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(uint32_t));
+    return ~bits;
+}
+
+CpuSorter::CpuSorter() : poolNextTask(0)
+{
+}
+
+CpuSorter::~CpuSorter()
+{
+    {
+        std::unique_lock<std::mutex> lock(workerMutex);
+        quit = true;
+    }
+    workerCv.notify_all();
+    if (workerThread.joinable())
+    {
+        workerThread.join();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(poolMutex);
+        poolGeneration++;
+        poolFunc = nullptr;
+    }
+    poolCv.notify_all();
+    for (auto&& t : helperThreads)
+    {
+        t.join();
+    }
+}
+
+void CpuSorter::Init(uint32_t numThreads)
+{
+    assert(!workerThread.joinable());
+
+    if (numThreads == 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // the worker thread participates in ParallelFor, so it needs one less helper.
+    numChunks = numThreads;
+    for (uint32_t i = 1; i < numThreads; i++)
+    {
+        helperThreads.emplace_back(&CpuSorter::HelperMain, this);
+    }
+    workerThread = std::thread(&CpuSorter::WorkerMain, this);
+}
+
+void CpuSorter::StartSort(const std::vector<glm::vec4>& posVec, const glm::mat4& modelViewProjMatIn,
+                          float clipBoundIn, float pixelScaleIn, float minPixelAreaIn)
+{
+    std::unique_lock<std::mutex> lock(workerMutex);
+    assert(!busy);
+
+    keyJob = false;
+    source = &posVec;
+    modelViewProjMat = modelViewProjMatIn;
+    clipBound = clipBoundIn;
+    pixelScale = pixelScaleIn;
+    minPixelArea = minPixelAreaIn;
+    busy = true;
+    jobPending = true;
+    jobDone = false;
+
+    lock.unlock();
+    workerCv.notify_all();
+}
+
+bool CpuSorter::IsBusy() const
+{
+    std::unique_lock<std::mutex> lock(workerMutex);
+    return busy;
+}
+
+void CpuSorter::Wait()
+{
+    ZoneScoped;
+
+    std::unique_lock<std::mutex> lock(workerMutex);
+    workerCv.wait(lock, [this]() { return !busy; });
+}
+
+bool CpuSorter::PollResult(const uint32_t** sortedIndicesOut, uint32_t* countOut, const std::vector<glm::vec4>** sourceOut)
+{
+    std::unique_lock<std::mutex> lock(workerMutex);
+    if (busy || !jobDone || !sortedVals)
+    {
+        return false;
+    }
+
+    jobDone = false;
+    *sortedIndicesOut = sortedVals->data();
+    *countOut = chunkCounts.back();
+    *sourceOut = source;
+    return true;
+}
+
+void CpuSorter::SortKeys(std::vector<uint32_t>& keysInOut, std::vector<uint32_t>& valsInOut, uint32_t count)
+{
+    ZoneScoped;
+
+    Wait();
+
+    assert(count <= keysInOut.size() && count <= valsInOut.size());
+
+    // borrow the callers vectors, so the result can be swapped back without a copy.
+    keys.swap(keysInOut);
+    vals.swap(valsInOut);
+    keys2.resize(keys.size());
+    vals2.resize(vals.size());
+
+    RadixSort(count);
+    ReturnSortedKeys(keysInOut, valsInOut);
+}
+
+void CpuSorter::StartSortKeys(std::vector<uint32_t>& keysInOut, std::vector<uint32_t>& valsInOut, uint32_t count)
+{
+    std::unique_lock<std::mutex> lock(workerMutex);
+    assert(!busy);
+    assert(count <= keysInOut.size() && count <= valsInOut.size());
+
+    keys.swap(keysInOut);
+    vals.swap(valsInOut);
+    keys2.resize(keys.size());
+    vals2.resize(vals.size());
+
+    keyJob = true;
+    keyJobCount = count;
+    busy = true;
+    jobPending = true;
+    jobDone = false;
+
+    lock.unlock();
+    workerCv.notify_all();
+}
+
+void CpuSorter::FinishSortKeys(std::vector<uint32_t>& keysOut, std::vector<uint32_t>& valsOut)
+{
+    ZoneScoped;
+
+    Wait();
+    assert(keyJob);
+    ReturnSortedKeys(keysOut, valsOut);
+}
+
+// swaps the sorted keys and vals out to the caller, the buffers of the sorter are empty until the next sort.
+// this replaces the result of an earlier StartSort(), so PollResult() must not return it anymore.
+void CpuSorter::ReturnSortedKeys(std::vector<uint32_t>& keysOut, std::vector<uint32_t>& valsOut)
+{
+    {
+        std::unique_lock<std::mutex> lock(workerMutex);
+        jobDone = false;
+        keyJob = false;
+    }
+
+    if (sortedVals != &vals)
+    {
+        keys.swap(keys2);
+        vals.swap(vals2);
+    }
+    keys.swap(keysOut);
+    vals.swap(valsOut);
+    sortedVals = nullptr;
+}
+
+void CpuSorter::WorkerMain()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(workerMutex);
+            workerCv.wait(lock, [this]() { return quit || jobPending; });
+            if (quit)
+            {
+                return;
+            }
+            jobPending = false;
+        }
+
+        // keyJob only changes while the worker is idle
+        if (keyJob)
+        {
+            RadixSort(keyJobCount);
+        }
+        else
+        {
+            GenerateKeys();
+            RadixSort(chunkCounts.back());
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(workerMutex);
+            busy = false;
+            jobDone = !keyJob;  // PollResult() only returns the results of StartSort()
+        }
+        workerCv.notify_all();
+    }
+}
+
+void CpuSorter::HelperMain()
+{
+    uint32_t generation = 0;
+    while (true)
+    {
+        const TaskFunc* func = nullptr;
+        uint32_t numTasks = 0;
+        {
+            std::unique_lock<std::mutex> lock(poolMutex);
+            poolCv.wait(lock, [this, generation]() { return poolGeneration != generation; });
+            generation = poolGeneration;
+            if (!poolFunc)
+            {
+                return;  // quit
+            }
+            func = poolFunc;
+            numTasks = poolNumTasks;
+        }
+
+        uint32_t i;
+        while ((i = poolNextTask.fetch_add(1)) < numTasks)
+        {
+            (*func)(i);
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(poolMutex);
+            poolNumActive--;
+        }
+        poolDoneCv.notify_one();
+    }
+}
+
+// calls func(i) for i in [0, numTasks), blocks until every task is complete.
+void CpuSorter::ParallelFor(uint32_t numTasks, const TaskFunc& func)
+{
+    if (helperThreads.empty() || numTasks <= 1)
+    {
+        for (uint32_t i = 0; i < numTasks; i++)
+        {
+            func(i);
+        }
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(poolMutex);
+        poolFunc = &func;
+        poolNumTasks = numTasks;
+        poolNextTask = 0;
+        poolNumActive = (uint32_t)helperThreads.size();
+        poolGeneration++;
+    }
+    poolCv.notify_all();
+
+    uint32_t i;
+    while ((i = poolNextTask.fetch_add(1)) < numTasks)
+    {
+        func(i);
+    }
+
+    std::unique_lock<std::mutex> lock(poolMutex);
+    poolDoneCv.wait(lock, [this]() { return poolNumActive == 0; });
+}
+
+// Writes a key and index for each position inside the view frustum into keys and vals.
+// chunkCounts.back() is the total number of visible positions.
+void CpuSorter::GenerateKeys()
+{
+    ZoneScopedNC("CpuSorter::GenerateKeys()", tracy::Color::Red4);
+
+    const uint32_t numPositions = (uint32_t)source->size();
+    if (keys.size() < numPositions)
+    {
+        keys.resize(numPositions);
+        keys2.resize(numPositions);
+        vals.resize(numPositions);
+        vals2.resize(numPositions);
+    }
+
+    // keep chunk boundaries a multiple of 4, for simd.
+    uint32_t chunkSize = std::max(MIN_CHUNK_SIZE, (numPositions + numChunks - 1) / numChunks);
+    chunkSize = (chunkSize + 3) & ~3u;
+    const uint32_t numTasks = std::max(1u, (numPositions + chunkSize - 1) / chunkSize);
+    chunkCounts.assign(numTasks + 1, 0);
+
+    const glm::vec4* pos = source->data();
+    const glm::mat4& m = modelViewProjMat;
+
+    // same as GpuSorter::ComputeRadiusScale()
+    const float row0 = glm::length(glm::vec3(m[0][0], m[1][0], m[2][0]));
+    const float row1 = glm::length(glm::vec3(m[0][1], m[1][1], m[2][1]));
+    const float row3 = glm::length(glm::vec3(m[0][3], m[1][3], m[2][3]));
+    const float radiusScaleX = row0 + clipBound * row3;
+    const float radiusScaleY = row1 + clipBound * row3;
+
+    // pi * (radius * pixelScale / w)^2 >= minPixelArea is radius^2 * areaScale >= w^2
+    const float areaScale = minPixelArea > 0.0f ? (3.14159265f * pixelScale * pixelScale) / minPixelArea : 0.0f;
+
+    // each chunk compacts its visible positions into the start of its own range
+    ParallelFor(numTasks, [&](uint32_t task)
+    {
+        const uint32_t begin = task * chunkSize;
+        const uint32_t end = std::min(begin + chunkSize, numPositions);
+        uint32_t* keyOut = keys2.data() + begin;
+        uint32_t* valOut = vals2.data() + begin;
+        uint32_t count = 0;
+        uint32_t i = begin;
+
+#ifdef CPUSORTER_USE_SSE
+        // only the x, y and w rows of the clip space transform are needed.
+        const __m128 m0x = _mm_set1_ps(m[0][0]), m1x = _mm_set1_ps(m[1][0]), m2x = _mm_set1_ps(m[2][0]), m3x = _mm_set1_ps(m[3][0]);
+        const __m128 m0y = _mm_set1_ps(m[0][1]), m1y = _mm_set1_ps(m[1][1]), m2y = _mm_set1_ps(m[2][1]), m3y = _mm_set1_ps(m[3][1]);
+        const __m128 m0w = _mm_set1_ps(m[0][3]), m1w = _mm_set1_ps(m[1][3]), m2w = _mm_set1_ps(m[2][3]), m3w = _mm_set1_ps(m[3][3]);
+        const __m128 clipBound4 = _mm_set1_ps(clipBound);
+        const __m128 radiusScaleX4 = _mm_set1_ps(radiusScaleX);
+        const __m128 radiusScaleY4 = _mm_set1_ps(radiusScaleY);
+        const __m128 areaScale4 = _mm_set1_ps(areaScale);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        alignas(16) uint32_t keyLanes[4];
+
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(&pos[i + 0].x);
+            __m128 y = _mm_loadu_ps(&pos[i + 1].x);
+            __m128 z = _mm_loadu_ps(&pos[i + 2].x);
+            __m128 w = _mm_loadu_ps(&pos[i + 3].x);
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+
+            __m128 clipX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0x, x), _mm_mul_ps(m1x, y)), _mm_add_ps(_mm_mul_ps(m2x, z), m3x));
+            __m128 clipY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0y, x), _mm_mul_ps(m1y, y)), _mm_add_ps(_mm_mul_ps(m2y, z), m3y));
+            __m128 clipW = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0w, x), _mm_mul_ps(m1w, y)), _mm_add_ps(_mm_mul_ps(m2w, z), m3w));
+
+            // the w of each position is the radius of its bounding sphere, see GpuSorter::Sort()
+            __m128 radius = w;
+
+            // |x / w| < bound is |x| < bound * w, when w > 0. expanded by the radius of the bounding sphere.
+            __m128 bound = _mm_mul_ps(clipBound4, clipW);
+            __m128 boundX = _mm_add_ps(bound, _mm_mul_ps(radius, radiusScaleX4));
+            __m128 boundY = _mm_add_ps(bound, _mm_mul_ps(radius, radiusScaleY4));
+            __m128 visible = _mm_and_ps(_mm_cmpgt_ps(clipW, zero), _mm_cmpge_ps(radius, zero));
+            visible = _mm_and_ps(visible, _mm_cmplt_ps(_mm_and_ps(clipX, absMask), boundX));
+            visible = _mm_and_ps(visible, _mm_cmplt_ps(_mm_and_ps(clipY, absMask), boundY));
+            if (areaScale > 0.0f)
+            {
+                __m128 radiusSq = _mm_mul_ps(radius, radius);
+                visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_mul_ps(radiusSq, areaScale4), _mm_mul_ps(clipW, clipW)));
+            }
+
+            int mask = _mm_movemask_ps(visible);
+            if (mask)
+            {
+                __m128i key = _mm_xor_si128(_mm_castps_si128(clipW), _mm_set1_epi32(-1));
+                _mm_store_si128((__m128i*)keyLanes, key);
+                for (uint32_t j = 0; j < 4; j++)
+                {
+                    if (mask & (1 << j))
+                    {
+                        keyOut[count] = keyLanes[j];
+                        valOut[count] = i + j;
+                        count++;
+                    }
+                }
+            }
+        }
+#endif
+        for (; i < end; i++)
+        {
+            const glm::vec4 p = pos[i];
+            float clipX = m[0][0] * p.x + m[1][0] * p.y + m[2][0] * p.z + m[3][0];
+            float clipY = m[0][1] * p.x + m[1][1] * p.y + m[2][1] * p.z + m[3][1];
+            float clipW = m[0][3] * p.x + m[1][3] * p.y + m[2][3] * p.z + m[3][3];
+            float bound = clipBound * clipW;
+            bool visible = p.w >= 0.0f && clipW > 0.0f &&
+                fabsf(clipX) < bound + p.w * radiusScaleX && fabsf(clipY) < bound + p.w * radiusScaleY;
+            if (areaScale > 0.0f)
+            {
+                visible = visible && (p.w * p.w * areaScale >= clipW * clipW);
+            }
+            if (visible)
+            {
+                keyOut[count] = DepthToKey(clipW);
+                valOut[count] = i;
+                count++;
+            }
+        }
+
+        chunkCounts[task] = count;
+    });
+
+    // exclusive scan of the chunk counts, the last entry ends up holding the total
+    uint32_t total = 0;
+    for (uint32_t t = 0; t < numTasks; t++)
+    {
+        uint32_t count = chunkCounts[t];
+        chunkCounts[t] = total;
+        total += count;
+    }
+    chunkCounts[numTasks] = total;
+
+    ParallelFor(numTasks, [&](uint32_t task)
+    {
+        const uint32_t begin = task * chunkSize;
+        const uint32_t dst = chunkCounts[task];
+        const uint32_t count = chunkCounts[task + 1] - dst;
+        memcpy(keys.data() + dst, keys2.data() + begin, count * sizeof(uint32_t));
+        memcpy(vals.data() + dst, vals2.data() + begin, count * sizeof(uint32_t));
+    });
+}
+
+// Parallel LSD radix sort of the first count elements of keys and vals.
+// Each pass builds a histogram per chunk, then every chunk scatters into its own slice of each bin, which keeps the sort stable.
+// sortedVals points at whichever of vals or vals2 holds the result.
+void CpuSorter::RadixSort(uint32_t count)
+{
+    ZoneScopedNC("CpuSorter::RadixSort()", tracy::Color::Red4);
+
+    const uint32_t chunkSize = std::max(MIN_CHUNK_SIZE, (count + numChunks - 1) / numChunks);
+    const uint32_t numTasks = std::max(1u, (count + chunkSize - 1) / chunkSize);
+    chunkHistograms.resize(numTasks * RADIX_BINS);
+
+    uint32_t* srcKeys = keys.data();
+    uint32_t* srcVals = vals.data();
+    uint32_t* dstKeys = keys2.data();
+    uint32_t* dstVals = vals2.data();
+
+    for (uint32_t pass = 0; pass < NUM_PASSES; pass++)
+    {
+        const uint32_t shift = pass * RADIX_BITS;
+
+        ParallelFor(numTasks, [&](uint32_t task)
+        {
+            uint32_t* hist = chunkHistograms.data() + task * RADIX_BINS;
+            memset(hist, 0, RADIX_BINS * sizeof(uint32_t));
+            const uint32_t begin = task * chunkSize;
+            const uint32_t end = std::min(begin + chunkSize, count);
+            for (uint32_t i = begin; i < end; i++)
+            {
+                hist[(srcKeys[i] >> shift) & (RADIX_BINS - 1)]++;
+            }
+        });
+
+        // convert histograms into scatter offsets, bin major then chunk.
+        bool skipPass = false;
+        uint32_t offset = 0;
+        for (uint32_t bin = 0; bin < RADIX_BINS; bin++)
+        {
+            const uint32_t binStart = offset;
+            for (uint32_t task = 0; task < numTasks; task++)
+            {
+                uint32_t& h = chunkHistograms[task * RADIX_BINS + bin];
+                uint32_t c = h;
+                h = offset;
+                offset += c;
+            }
+
+            // every key has the same digit, this pass would not change the order.
+            if (offset - binStart == count)
+            {
+                skipPass = true;
+                break;
+            }
+        }
+        if (skipPass)
+        {
+            continue;
+        }
+
+        ParallelFor(numTasks, [&](uint32_t task)
+        {
+            uint32_t* hist = chunkHistograms.data() + task * RADIX_BINS;
+            const uint32_t begin = task * chunkSize;
+            const uint32_t end = std::min(begin + chunkSize, count);
+            for (uint32_t i = begin; i < end; i++)
+            {
+                uint32_t key = srcKeys[i];
+                uint32_t dst = hist[(key >> shift) & (RADIX_BINS - 1)]++;
+                dstKeys[dst] = key;
+                dstVals[dst] = srcVals[i];
+            }
+        });
+
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcVals, dstVals);
+    }
+
+    sortedVals = (srcVals == vals.data()) ? &vals : &vals2;
+}
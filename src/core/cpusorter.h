@@ -0,0 +1,102 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Back to front depth sort of positions on the cpu.
+// Sorts run asynchronously on a worker thread, which splits the work across a pool of helper threads,
+// so the render thread can keep drawing with the previous result while the next sort is in flight.
+class CpuSorter
+{
+public:
+    CpuSorter();
+    ~CpuSorter();
+
+    // numThreads = 0 will use one thread per hardware core.
+    void Init(uint32_t numThreads = 0);
+
+    // Kick off an asynchronous sort of posVec, using a snapshot of modelViewProjMat.
+    // posVec must remain valid until the sort is complete.
+    // The culling is the same as presort_compute.glsl, see GpuSorter::CullParams.
+    // Must not be called while IsBusy() is true.
+    void StartSort(const std::vector<glm::vec4>& posVec, const glm::mat4& modelViewProjMat,
+                   float clipBound = 1.5f, float pixelScale = 0.0f, float minPixelArea = 0.0f);
+
+    bool IsBusy() const;
+
+    // blocks until the sort in flight is complete
+    void Wait();
+
+    // Returns true once per completed sort, sortedIndicesOut will point to countOut indices of visible positions, sorted back to front.
+    // The result is valid until the next call to StartSort(). sourceOut is the posVec that was passed to StartSort().
+    bool PollResult(const uint32_t** sortedIndicesOut, uint32_t* countOut, const std::vector<glm::vec4>** sourceOut);
+
+    // synchronous sort of the first count keys and vals, in ascending key order.
+    void SortKeys(std::vector<uint32_t>& keys, std::vector<uint32_t>& vals, uint32_t count);
+
+    // asynchronous version of SortKeys(), keys and vals are swapped into the sorter until FinishSortKeys() swaps them back sorted.
+    // Must not be called while IsBusy() is true.
+    void StartSortKeys(std::vector<uint32_t>& keys, std::vector<uint32_t>& vals, uint32_t count);
+
+    // blocks until the sort started by StartSortKeys() is complete.
+    void FinishSortKeys(std::vector<uint32_t>& keysOut, std::vector<uint32_t>& valsOut);
+
+protected:
+    using TaskFunc = std::function<void(uint32_t)>;
+
+    void WorkerMain();
+    void HelperMain();
+    void ParallelFor(uint32_t numTasks, const TaskFunc& func);
+
+    void GenerateKeys();
+    void RadixSort(uint32_t count);
+    void ReturnSortedKeys(std::vector<uint32_t>& keysOut, std::vector<uint32_t>& valsOut);
+
+    // sort state, owned by the worker thread while busy
+    const std::vector<glm::vec4>* source = nullptr;
+    glm::mat4 modelViewProjMat;
+    float clipBound = 1.5f;
+    float pixelScale = 0.0f;
+    float minPixelArea = 0.0f;
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> keys2;
+    std::vector<uint32_t> vals;
+    std::vector<uint32_t> vals2;
+    std::vector<uint32_t> chunkCounts;
+    std::vector<uint32_t> chunkHistograms;
+    std::vector<uint32_t>* sortedVals = nullptr;
+    bool keyJob = false;  // the job in flight is from StartSortKeys(), not StartSort()
+    uint32_t keyJobCount = 0;
+
+    // worker thread
+    std::thread workerThread;
+    mutable std::mutex workerMutex;
+    std::condition_variable workerCv;
+    bool jobPending = false;
+    bool jobDone = false;
+    bool busy = false;
+    bool quit = false;
+
+    // helper threads used by ParallelFor
+    std::vector<std::thread> helperThreads;
+    std::mutex poolMutex;
+    std::condition_variable poolCv;
+    std::condition_variable poolDoneCv;
+    const TaskFunc* poolFunc = nullptr;
+    uint32_t poolNumTasks = 0;
+    std::atomic<uint32_t> poolNextTask;
+    uint32_t poolGeneration = 0;
+    uint32_t poolNumActive = 0;
+    uint32_t numChunks = 1;
+};
@@ -25,6 +25,9 @@ public:
 	// call at end of frame.
 	void EndFrame();
 
+	// true when no lines have been added this frame.
+	bool IsEmpty() const { return linePositionVec.empty(); }
+
 	void Line(const glm::vec3& start, const glm::vec3& end, const glm::vec3& color);
 	void Transform(const glm::mat4& m, float axisLen = 1.0f);
 
@@ -0,0 +1,670 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "gpusorter.h"
+
+#ifdef __ANDROID__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <cassert>
+#include <limits>
+#include <string>
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#else
+#define ZoneScoped
+#define ZoneScopedNC(NAME, COLOR)
+#endif
+
+#include "core/cpusorter.h"
+#include "core/gputimer.h"
+#include "core/log.h"
+#include "core/util.h"
+
+#include "radix_sort.hpp"
+
+// 24 bit radix sort still has some artifacts on some datasets, so use 32 bit sort.
+//static const uint32_t NUM_BYTES = useMultiRadixSort ? 3 : 4;
+//static const uint32_t MAX_DEPTH = useMultiRadixSort ? 16777215 : std::numeric_limits<uint32_t>::max();
+static const uint32_t NUM_BYTES = 4;
+static const uint32_t MAX_DEPTH = std::numeric_limits<uint32_t>::max();
+static const uint32_t RADIX_SORT_BINS = 256;
+
+static bool HasSubgroupSupport()
+{
+#ifdef __ANDROID__
+    return false;
+#else
+    return GLEW_KHR_shader_subgroup;
+#endif
+}
+
+static bool HasComputeSupport()
+{
+#ifdef __ANDROID__
+    return true;
+#else
+    return GLEW_VERSION_4_3 || GLEW_ARB_compute_shader;
+#endif
+}
+
+// multi_radixsort_portable.glsl uses 256 invocations per workgroup, GLES 3.1 only guarantees 128.
+static bool HasPortableMultiRadixSortSupport()
+{
+    if (!HasComputeSupport())
+    {
+        return false;
+    }
+    GLint maxInvocations = 0;
+    glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+    return maxInvocations >= (GLint)RADIX_SORT_BINS;
+}
+
+bool GpuSorter::IsBackendSupported(Backend backend)
+{
+    switch (backend)
+    {
+    case Backend::RgcRadixSort:
+        return HasComputeSupport();
+    case Backend::MultiRadixSort:
+        return HasComputeSupport() && HasSubgroupSupport();
+    case Backend::PortableMultiRadixSort:
+        return HasPortableMultiRadixSortSupport();
+    default:
+        return true;
+    }
+}
+
+GpuSorter::GpuSorter() : backend(Backend::RgcRadixSort), maxNumElements(0), sortCount(0), cpuSortSource(nullptr),
+    asyncState(AsyncState::Idle), stagingFence(nullptr), asyncCount(0), sortedValInValBuffer2(false)
+{
+}
+
+GpuSorter::~GpuSorter()
+{
+    if (stagingFence)
+    {
+        glDeleteSync(stagingFence);
+    }
+}
+
+bool GpuSorter::Init(size_t maxNumElementsIn, Backend requestedBackend)
+{
+    ZoneScopedNC("GpuSorter::Init()", tracy::Color::Blue);
+    GL_ERROR_CHECK("GpuSorter::Init() begin");
+
+    assert(maxNumElementsIn <= std::numeric_limits<uint32_t>::max());
+    maxNumElements = maxNumElementsIn;
+
+    backend = requestedBackend;
+    if (backend != Backend::CpuRadixSort)
+    {
+        preSortProg = std::make_shared<Program>();
+        if (!preSortProg->LoadCompute("shader/presort_compute.glsl"))
+        {
+            if (backend != Backend::Auto)
+            {
+                Log::E("Error loading pre-sort compute shader!\n");
+                return false;
+            }
+            Log::W("Error loading pre-sort compute shader, falling back to cpu sort\n");
+            preSortProg = nullptr;
+            backend = Backend::CpuRadixSort;
+        }
+    }
+
+    if (backend == Backend::Auto)
+    {
+        if (IsBackendSupported(Backend::MultiRadixSort))
+        {
+            backend = Backend::MultiRadixSort;
+        }
+        else if (IsBackendSupported(Backend::PortableMultiRadixSort))
+        {
+            backend = Backend::PortableMultiRadixSort;
+        }
+        else
+        {
+            backend = Backend::RgcRadixSort;
+        }
+    }
+    else if (backend == Backend::MultiRadixSort && !IsBackendSupported(backend))
+    {
+        Log::E("multi_radixsort requires GL_KHR_shader_subgroup\n");
+        return false;
+    }
+    else if (backend == Backend::PortableMultiRadixSort && !IsBackendSupported(backend))
+    {
+        Log::E("multi_radixsort_portable requires GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS >= %u\n", RADIX_SORT_BINS);
+        return false;
+    }
+
+    if (backend == Backend::MultiRadixSort || backend == Backend::PortableMultiRadixSort)
+    {
+        const char* sortShader = (backend == Backend::MultiRadixSort) ? "shader/multi_radixsort.glsl" : "shader/multi_radixsort_portable.glsl";
+        Log::I("using %s\n", sortShader);
+
+        sortProg = std::make_shared<Program>();
+        if (!sortProg->LoadCompute(sortShader))
+        {
+            Log::E("Error loading sort compute shader!\n");
+            return false;
+        }
+
+        histogramProg = std::make_shared<Program>();
+        if (!histogramProg->LoadCompute("shader/multi_radixsort_histograms.glsl"))
+        {
+            Log::E("Error loading histogram compute shader!\n");
+            return false;
+        }
+    }
+    else if (backend == Backend::CpuRadixSort)
+    {
+        Log::I("using CpuSorter\n");
+
+        cpuSorter = std::make_shared<CpuSorter>();
+        cpuSorter->Init();
+    }
+    else
+    {
+        Log::I("using rgc::radix_sort\n");
+
+        sorter = std::make_shared<rgc::radix_sort::sorter>(maxNumElements);
+    }
+
+    AllocateBuffers();
+
+    atomicCounterVec.resize(1, 0);
+    atomicCounterBuffer = std::make_shared<BufferObject>(GL_ATOMIC_COUNTER_BUFFER, atomicCounterVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+
+    GL_ERROR_CHECK("GpuSorter::Init() end");
+
+    return true;
+}
+
+void GpuSorter::Resize(size_t maxNumElementsIn)
+{
+    ZoneScopedNC("GpuSorter::Resize()", tracy::Color::Blue);
+
+    assert(maxNumElementsIn <= std::numeric_limits<uint32_t>::max());
+
+    // the worker thread may still be sorting the keys read back from the old buffers.
+    CancelAsyncSortKeys();
+
+    maxNumElements = maxNumElementsIn;
+    sortCount = 0;
+    cpuSortSource = nullptr;
+    sortedValInValBuffer2 = false;
+    stagingBuffer = nullptr;
+    AllocateBuffers();
+
+    // rgc::radix_sort grows its own scratch buffers on the first sort that needs them.
+    GL_ERROR_CHECK("GpuSorter::Resize()");
+}
+
+// (re)creates the key and value buffers for maxNumElements, their contents are written by the pre-sort pass or the caller.
+void GpuSorter::AllocateBuffers()
+{
+    const size_t bufferSize = maxNumElements * sizeof(uint32_t);
+    if (backend == Backend::MultiRadixSort || backend == Backend::PortableMultiRadixSort)
+    {
+        keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, bufferSize, GL_DYNAMIC_STORAGE_BIT);
+        keyBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, bufferSize, GL_DYNAMIC_STORAGE_BIT);
+
+        const uint32_t NUM_ELEMENTS = static_cast<uint32_t>(maxNumElements);
+        const uint32_t NUM_WORKGROUPS = (NUM_ELEMENTS + numBlocksPerWorkgroup - 1) / numBlocksPerWorkgroup;
+
+        std::vector<uint32_t> histogramVec(NUM_WORKGROUPS * RADIX_SORT_BINS, 0);
+        histogramBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, histogramVec, GL_DYNAMIC_STORAGE_BIT);
+
+        valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, bufferSize, GL_DYNAMIC_STORAGE_BIT);
+        valBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, bufferSize, GL_DYNAMIC_STORAGE_BIT);
+    }
+    else if (backend == Backend::CpuRadixSort)
+    {
+        // keys and values are read back when SortKeys() is used, valBuffer2 holds every other result of PollAsyncSortKeys().
+        keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, bufferSize, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+        valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, bufferSize, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+        valBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, bufferSize, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+    }
+    else
+    {
+        keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, bufferSize, GL_DYNAMIC_STORAGE_BIT);
+        valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, bufferSize, GL_DYNAMIC_STORAGE_BIT);
+    }
+}
+
+// Conservative per unit radius offsets for the bounding sphere test in presort_compute.glsl and CpuSorter.
+// Moving a position by radius changes clip x by at most radius * |row0| and clip w by at most radius * |row3|,
+// so |x| < clipBound * w holds somewhere in the sphere if |x| < clipBound * w + radius * (|row0| + clipBound * |row3|).
+glm::vec2 GpuSorter::ComputeRadiusScale(const glm::mat4& modelViewProjMat, float clipBound)
+{
+    const glm::mat4& m = modelViewProjMat;
+    float row0 = glm::length(glm::vec3(m[0][0], m[1][0], m[2][0]));
+    float row1 = glm::length(glm::vec3(m[0][1], m[1][1], m[2][1]));
+    float row3 = glm::length(glm::vec3(m[0][3], m[1][3], m[2][3]));
+    return glm::vec2(row0 + clipBound * row3, row1 + clipBound * row3);
+}
+
+uint32_t GpuSorter::Sort(const std::vector<glm::vec4>& posVec, std::shared_ptr<BufferObject> posBuffer,
+                         const glm::mat4& modelViewProjMat, const glm::vec2& nearFar,
+                         const CullParams& cullParams)
+{
+    ZoneScoped;
+
+    GL_ERROR_CHECK("GpuSorter::Sort() begin");
+
+    const uint32_t numPositions = (uint32_t)posVec.size();
+    assert(numPositions <= maxNumElements);
+
+    if (backend == Backend::CpuRadixSort)
+    {
+        CpuSort(posVec, modelViewProjMat, cullParams);
+        return sortCount;
+    }
+
+    {
+        ZoneScopedNC("pre-sort", tracy::Color::Red4);
+
+        if (timer)
+        {
+            timer->Begin("pre-sort");
+        }
+
+        preSortProg->Bind();
+        preSortProg->SetUniform("modelViewProj", modelViewProjMat);
+        preSortProg->SetUniform("nearFar", nearFar);
+        preSortProg->SetUniform("clipBound", cullParams.clipBound);
+        preSortProg->SetUniform("radiusScale", ComputeRadiusScale(modelViewProjMat, cullParams.clipBound));
+        preSortProg->SetUniform("pixelScale", cullParams.pixelScale);
+        preSortProg->SetUniform("minPixelArea", cullParams.minPixelArea);
+        preSortProg->SetUniform("keyMax", MAX_DEPTH);
+        preSortProg->SetUniform("numPositions", numPositions);
+
+        // reset counter back to zero
+        atomicCounterVec[0] = 0;
+        atomicCounterBuffer->Update(atomicCounterVec);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, posBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer->GetObj());  // writeonly
+        glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 4, atomicCounterBuffer->GetObj());
+
+        const int LOCAL_SIZE = 256;
+        glDispatchCompute((numPositions + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1); // Assuming LOCAL_SIZE threads per group
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+
+        if (timer)
+        {
+            timer->End();
+        }
+
+        GL_ERROR_CHECK("GpuSorter::Sort() pre-sort");
+    }
+
+    uint32_t count = 0;
+    {
+        ZoneScopedNC("get-count", tracy::Color::Green);
+
+        atomicCounterBuffer->Read(atomicCounterVec);
+        count = atomicCounterVec[0];
+
+        assert(count <= numPositions);
+
+        GL_ERROR_CHECK("GpuSorter::Sort() get-count");
+    }
+
+    SortKeys(count);
+
+    return count;
+}
+
+void GpuSorter::SortKeys(uint32_t count)
+{
+    ZoneScopedNC("sort", tracy::Color::Red4);
+
+    assert(count <= maxNumElements);
+    sortCount = count;
+
+    if (backend == Backend::MultiRadixSort || backend == Backend::PortableMultiRadixSort)
+    {
+        MultiRadixSort(count);
+    }
+    else if (backend == Backend::CpuRadixSort)
+    {
+        CancelAsyncSortKeys();
+        ReadBackKeys(count);
+        cpuSorter->SortKeys(cpuKeyVec, cpuValVec, count);
+        UploadSortedKeys(count);
+        GL_ERROR_CHECK("GpuSorter::SortKeys() cpu sort");
+    }
+    else
+    {
+        if (timer)
+        {
+            timer->Begin("rgc sort");
+        }
+        sorter->sort(keyBuffer->GetObj(), valBuffer->GetObj(), count);
+        if (timer)
+        {
+            timer->End();
+        }
+        GL_ERROR_CHECK("GpuSorter::SortKeys() rgc sort");
+    }
+
+    // the sorted values are used directly as an element buffer.
+    glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void GpuSorter::StartAsyncSortKeys(std::shared_ptr<BufferObject> countBuffer)
+{
+    ZoneScopedNC("start async sort", tracy::Color::Red4);
+
+    assert(backend == Backend::CpuRadixSort);
+    CancelAsyncSortKeys();
+
+    // the count is unknown until the gpu is done, so the whole key and value buffers are copied.
+    const size_t HEADER_SIZE = 4 * sizeof(uint32_t);
+    const size_t bufferSize = maxNumElements * sizeof(uint32_t);
+    if (!stagingBuffer)
+    {
+        stagingBuffer = std::make_shared<BufferObject>(GL_COPY_WRITE_BUFFER, nullptr, HEADER_SIZE + 2 * bufferSize, GL_MAP_READ_BIT);
+    }
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stagingBuffer->GetObj());
+    glBindBuffer(GL_COPY_READ_BUFFER, countBuffer->GetObj());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(uint32_t));
+    glBindBuffer(GL_COPY_READ_BUFFER, keyBuffer->GetObj());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, HEADER_SIZE, bufferSize);
+    glBindBuffer(GL_COPY_READ_BUFFER, valBuffer->GetObj());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, HEADER_SIZE + bufferSize, bufferSize);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    // flushed now, so the copy is done by the time the next frame polls.
+    stagingFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    asyncState = AsyncState::ReadBack;
+
+    GL_ERROR_CHECK("GpuSorter::StartAsyncSortKeys()");
+}
+
+bool GpuSorter::PollAsyncSortKeys(uint32_t* countOut, bool wait)
+{
+    if (asyncState == AsyncState::ReadBack)
+    {
+        const GLuint64 FENCE_TIMEOUT_NS = 100000000;  // 100 ms
+        GLenum result = glClientWaitSync(stagingFence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? FENCE_TIMEOUT_NS : 0);
+        if (result == GL_TIMEOUT_EXPIRED && !wait)
+        {
+            return false;
+        }
+        else if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+        {
+            // mapping the staging buffer still waits for the copy.
+            Log::W("GpuSorter: staging fence %s\n", result == GL_WAIT_FAILED ? "wait failed" : "timed out");
+        }
+        glDeleteSync(stagingFence);
+        stagingFence = nullptr;
+
+        ZoneScopedNC("read back staging", tracy::Color::Green);
+
+        const size_t HEADER_SIZE = 4 * sizeof(uint32_t);
+        const size_t bufferSize = maxNumElements * sizeof(uint32_t);
+        stagingBuffer->Read(&asyncCount, 0, sizeof(uint32_t));
+        assert(asyncCount <= maxNumElements);
+        cpuKeyVec.resize(maxNumElements);
+        cpuValVec.resize(maxNumElements);
+        stagingBuffer->Read(cpuKeyVec.data(), HEADER_SIZE, asyncCount * sizeof(uint32_t));
+        stagingBuffer->Read(cpuValVec.data(), HEADER_SIZE + bufferSize, asyncCount * sizeof(uint32_t));
+
+        cpuSorter->StartSortKeys(cpuKeyVec, cpuValVec, asyncCount);
+        asyncState = AsyncState::Sorting;
+
+        GL_ERROR_CHECK("GpuSorter::PollAsyncSortKeys() read back");
+    }
+
+    if (asyncState == AsyncState::Sorting)
+    {
+        if (!wait && cpuSorter->IsBusy())
+        {
+            return false;
+        }
+
+        ZoneScopedNC("upload async sort", tracy::Color::Green);
+
+        cpuSorter->FinishSortKeys(cpuKeyVec, cpuValVec);
+        asyncState = AsyncState::Idle;
+
+        // valBuffer is never the buffer with the previous result, the values that were copied from it are no longer needed.
+        // only the values are uploaded, the keys in keyBuffer are left as they were written.
+        valBuffer->Update(cpuValVec.data(), asyncCount * sizeof(uint32_t));
+        std::swap(valBuffer, valBuffer2);
+        sortedValInValBuffer2 = true;
+        cpuSortSource = nullptr;
+        sortCount = asyncCount;
+        *countOut = asyncCount;
+
+        // the sorted values are used directly as an element buffer.
+        glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        GL_ERROR_CHECK("GpuSorter::PollAsyncSortKeys() upload");
+        return true;
+    }
+
+    return false;
+}
+
+// the worker threads are waited for, because they own cpuKeyVec and cpuValVec until they are done.
+void GpuSorter::CancelAsyncSortKeys()
+{
+    if (asyncState == AsyncState::ReadBack)
+    {
+        glDeleteSync(stagingFence);
+        stagingFence = nullptr;
+    }
+    else if (asyncState == AsyncState::Sorting)
+    {
+        cpuSorter->FinishSortKeys(cpuKeyVec, cpuValVec);
+    }
+    asyncState = AsyncState::Idle;
+}
+
+// cpu backend only, copies the first count keys and values to cpuKeyVec and cpuValVec, waits for the gpu.
+void GpuSorter::ReadBackKeys(uint32_t count)
+{
+    if (timer)
+    {
+        timer->Begin("read back");
+    }
+    cpuKeyVec.resize(maxNumElements);
+    cpuValVec.resize(maxNumElements);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    keyBuffer->Read(cpuKeyVec.data(), count * sizeof(uint32_t));
+    valBuffer->Read(cpuValVec.data(), count * sizeof(uint32_t));
+    if (timer)
+    {
+        timer->End();
+    }
+}
+
+// cpu backend only, the sorted cpuKeyVec and cpuValVec back into the key and value buffers.
+void GpuSorter::UploadSortedKeys(uint32_t count)
+{
+    if (timer)
+    {
+        timer->Begin("upload");
+    }
+    keyBuffer->Update(cpuKeyVec.data(), count * sizeof(uint32_t));
+    valBuffer->Update(cpuValVec.data(), count * sizeof(uint32_t));
+    if (timer)
+    {
+        timer->End();
+    }
+
+    // valBuffer no longer holds a sorted copy of any position array.
+    cpuSortSource = nullptr;
+    sortedValInValBuffer2 = false;
+}
+
+std::shared_ptr<BufferObject> GpuSorter::GetSortedValBuffer() const
+{
+    if (backend == Backend::CpuRadixSort)
+    {
+        return sortedValInValBuffer2 ? valBuffer2 : valBuffer;
+    }
+
+    // multi_radixsort ping-pongs between valBuffer and valBuffer2 once per byte,
+    // rgc::radix_sort always ends up back in valBuffer.
+    if (valBuffer2 && (NUM_BYTES % 2) == 1)  // odd
+    {
+        return valBuffer2;
+    }
+    else
+    {
+        return valBuffer;
+    }
+}
+
+std::shared_ptr<BufferObject> GpuSorter::GetSortedKeyBuffer() const
+{
+    // same ping-pong as the values
+    if (keyBuffer2 && (NUM_BYTES % 2) == 1)  // odd
+    {
+        return keyBuffer2;
+    }
+    else
+    {
+        return keyBuffer;
+    }
+}
+
+void GpuSorter::CpuSort(const std::vector<glm::vec4>& posVec, const glm::mat4& modelViewProjMat, const CullParams& cullParams)
+{
+    ZoneScopedNC("cpu sort", tracy::Color::Red4);
+
+    // the worker thread runs one sort at a time
+    CancelAsyncSortKeys();
+    UploadCpuSortResult(posVec);
+
+    if (cpuSortSource != &posVec)
+    {
+        // There is no previous order for these positions to draw, so wait for this sort to complete.
+        // This happens on the first frame, or when switching between point cloud and splats.
+        cpuSorter->Wait();
+        UploadCpuSortResult(posVec);  // discard any result for the other positions
+        cpuSorter->StartSort(posVec, modelViewProjMat, cullParams.clipBound, cullParams.pixelScale, cullParams.minPixelArea);
+        cpuSorter->Wait();
+        UploadCpuSortResult(posVec);
+    }
+    else if (!cpuSorter->IsBusy())
+    {
+        cpuSorter->StartSort(posVec, modelViewProjMat, cullParams.clipBound, cullParams.pixelScale, cullParams.minPixelArea);
+    }
+}
+
+// copies the most recently completed cpu sort of posVec into valBuffer, if there is one.
+void GpuSorter::UploadCpuSortResult(const std::vector<glm::vec4>& posVec)
+{
+    const uint32_t* sortedIndices = nullptr;
+    uint32_t count = 0;
+    const std::vector<glm::vec4>* source = nullptr;
+    if (cpuSorter->PollResult(&sortedIndices, &count, &source) && source == &posVec)
+    {
+        ZoneScopedNC("upload", tracy::Color::Green);
+
+        assert(count <= maxNumElements);
+        valBuffer->Update(sortedIndices, count * sizeof(uint32_t));
+        sortCount = count;
+        cpuSortSource = source;
+        sortedValInValBuffer2 = false;
+
+        GL_ERROR_CHECK("GpuSorter::UploadCpuSortResult()");
+    }
+}
+
+void GpuSorter::MultiRadixSort(uint32_t count)
+{
+    const uint32_t NUM_ELEMENTS = count;
+    const uint32_t NUM_WORKGROUPS = (NUM_ELEMENTS + numBlocksPerWorkgroup - 1) / numBlocksPerWorkgroup;
+
+    sortProg->Bind();
+    sortProg->SetUniform("g_num_elements", NUM_ELEMENTS);
+    sortProg->SetUniform("g_num_workgroups", NUM_WORKGROUPS);
+    sortProg->SetUniform("g_num_blocks_per_workgroup", numBlocksPerWorkgroup);
+
+    histogramProg->Bind();
+    histogramProg->SetUniform("g_num_elements", NUM_ELEMENTS);
+    //histogramProg->SetUniform("g_num_workgroups", NUM_WORKGROUPS);
+    histogramProg->SetUniform("g_num_blocks_per_workgroup", numBlocksPerWorkgroup);
+
+    for (uint32_t i = 0; i < NUM_BYTES; i++)
+    {
+        if (timer)
+        {
+            timer->Begin("histogram " + std::to_string(i));
+        }
+
+        histogramProg->Bind();
+        histogramProg->SetUniform("g_shift", 8 * i);
+
+        if (i == 0 || i == 2)
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer->GetObj());
+        }
+        else
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer2->GetObj());
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, histogramBuffer->GetObj());
+
+        glDispatchCompute(NUM_WORKGROUPS, 1, 1);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        if (timer)
+        {
+            timer->End();
+            timer->Begin("scatter " + std::to_string(i));
+        }
+
+        sortProg->Bind();
+        sortProg->SetUniform("g_shift", 8 * i);
+
+        if ((i % 2) == 0)  // even
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer->GetObj());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer2->GetObj());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer->GetObj());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, valBuffer2->GetObj());
+        }
+        else  // odd
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer2->GetObj());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer->GetObj());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer2->GetObj());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, valBuffer->GetObj());
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, histogramBuffer->GetObj());
+
+        glDispatchCompute(NUM_WORKGROUPS, 1, 1);
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        if (timer)
+        {
+            timer->End();
+        }
+    }
+
+    GL_ERROR_CHECK("GpuSorter::MultiRadixSort()");
+}
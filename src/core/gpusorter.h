@@ -0,0 +1,165 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include "core/program.h"
+#include "core/vertexbuffer.h"
+
+class CpuSorter;
+class GpuTimer;
+
+namespace rgc::radix_sort
+{
+    struct sorter;
+}
+
+// Back to front depth sort of positions, on the gpu or on the cpu.
+// Owns the key/value scratch buffers, so a single instance can be shared between renderers.
+class GpuSorter
+{
+public:
+    enum class Backend
+    {
+        Auto,  // pick the fastest backend supported by the driver.
+        RgcRadixSort,  // rgc::radix_sort, works everywhere compute shaders are supported.
+        MultiRadixSort,  // multi_radixsort.glsl, faster but requires subgroup operations.
+        PortableMultiRadixSort,  // multi_radixsort_portable.glsl, uses shared memory scans instead of subgroups, runs on GLES 3.1.
+        CpuRadixSort  // CpuSorter, runs on worker threads, results are one or more frames behind.
+    };
+
+    GpuSorter();
+    ~GpuSorter();
+
+    // returns true if the current gl context can run the requested backend, Backend::Auto is always supported.
+    static bool IsBackendSupported(Backend backend);
+
+    // maxNumElements is the largest number of positions that will ever be passed to Sort()
+    // if compute shaders are unavailable, Backend::Auto will fall back to Backend::CpuRadixSort.
+    bool Init(size_t maxNumElements, Backend requestedBackend = Backend::Auto);
+
+    // reallocates the key and value buffers for a new maxNumElements, without recompiling the sort programs.
+    // the contents of the buffers are lost, and a pending StartAsyncSortKeys() is dropped.
+    void Resize(size_t maxNumElements);
+
+    // Culling applied by Sort(), in addition to the w > 0 test of each position.
+    struct CullParams
+    {
+        CullParams() : clipBound(1.5f), pixelScale(0.0f), minPixelArea(0.0f) {}
+
+        // a position is visible if its bounding sphere overlaps |ndc.xy| < clipBound,
+        // positions without a radius use a bound larger then one as a guard band.
+        float clipBound;
+        // pixels per unit of radius at a clip space w of one, i.e. 0.5 * viewport height * projMat[1][1]
+        float pixelScale;
+        // positions with a projected bounding circle smaller then this many pixels are culled, zero disables the test.
+        float minPixelArea;
+    };
+
+    // Generates a depth key for each position that is inside the view frustum,
+    // then sorts the visible indices back to front.
+    // posVec and posBuffer hold the same array of vec4, xyz is the position and w is the radius of its bounding sphere.
+    // Positions with a negative radius are always culled.
+    // The gpu backends read posBuffer, the cpu backend reads posVec, which must outlive this sorter.
+    // The cpu backend sorts asynchronously, in that case the indices from the most recently completed sort are returned,
+    // while the next sort runs in the background.
+    // returns the number of visible elements, the sorted indices are in GetSortedValBuffer()
+    uint32_t Sort(const std::vector<glm::vec4>& posVec, std::shared_ptr<BufferObject> posBuffer,
+                  const glm::mat4& modelViewProjMat, const glm::vec2& nearFar,
+                  const CullParams& cullParams = CullParams());
+
+    // per unit radius clip space offsets used by the bounding sphere test of Sort()
+    static glm::vec2 ComputeRadiusScale(const glm::mat4& modelViewProjMat, float clipBound);
+
+    // sort the first count keys in GetKeyBuffer() along with their values in GetValBuffer()
+    void SortKeys(uint32_t count);
+
+    // cpu backend only. sorts the keys and values in GetKeyBuffer() and GetValBuffer() over the next frames, without waiting
+    // for the gpu. the number of keys is the uint at the start of countBuffer, written by the same gpu pass as the keys.
+    // the count, keys and values are copied into a staging buffer and fenced, PollAsyncSortKeys() maps it once the fence
+    // has signaled, and sorts the keys on the worker threads.
+    void StartAsyncSortKeys(std::shared_ptr<BufferObject> countBuffer);
+
+    // advances the sort started by StartAsyncSortKeys(), if wait is false this never blocks on the gpu or the worker threads.
+    // returns true once the sort is done, then the sorted values are in GetSortedValBuffer() and countOut is set.
+    // the values are uploaded into the other one of two value buffers, so the result of the previous sort can be drawn
+    // until then, and GetValBuffer() is never the buffer that holds it. the sorted keys are not uploaded.
+    bool PollAsyncSortKeys(uint32_t* countOut, bool wait = false);
+
+    // true between StartAsyncSortKeys() and the PollAsyncSortKeys() that returns true, or until the sort is dropped.
+    // any other sort drops it, as does Resize().
+    bool IsAsyncSortKeysPending() const { return asyncState != AsyncState::Idle; }
+
+    // drops the sort started by StartAsyncSortKeys(), if there is one. waits for the worker threads if they are sorting.
+    void CancelAsyncSortKeys();
+
+    Backend GetBackend() const { return backend; }
+    size_t GetMaxNumElements() const { return maxNumElements; }
+    uint32_t GetSortCount() const { return sortCount; }
+
+    std::shared_ptr<BufferObject> GetKeyBuffer() const { return keyBuffer; }
+    std::shared_ptr<BufferObject> GetValBuffer() const { return valBuffer; }
+
+    // buffer holding the values after SortKeys(), suitable for use as an element buffer.
+    std::shared_ptr<BufferObject> GetSortedValBuffer() const;
+
+    // buffer holding the keys after SortKeys()
+    std::shared_ptr<BufferObject> GetSortedKeyBuffer() const;
+
+    // if set, each pass of the sort is recorded as a section of timer.
+    void SetTimer(std::shared_ptr<GpuTimer> timerIn) { timer = timerIn; }
+
+public:
+    uint32_t numBlocksPerWorkgroup = 1024;
+protected:
+    void AllocateBuffers();
+    void MultiRadixSort(uint32_t count);
+    void CpuSort(const std::vector<glm::vec4>& posVec, const glm::mat4& modelViewProjMat, const CullParams& cullParams);
+    void UploadCpuSortResult(const std::vector<glm::vec4>& posVec);
+    void ReadBackKeys(uint32_t count);
+    void UploadSortedKeys(uint32_t count);
+
+    Backend backend;
+    size_t maxNumElements;
+    uint32_t sortCount;
+
+    std::shared_ptr<rgc::radix_sort::sorter> sorter;
+    std::shared_ptr<CpuSorter> cpuSorter;
+    std::shared_ptr<GpuTimer> timer;
+    const std::vector<glm::vec4>* cpuSortSource;
+    std::vector<uint32_t> cpuKeyVec;
+    std::vector<uint32_t> cpuValVec;
+
+    // state of StartAsyncSortKeys(), the staging buffer holds the count, padded to 16 bytes, followed by maxNumElements keys
+    // and maxNumElements values.
+    enum class AsyncState
+    {
+        Idle,
+        ReadBack,  // the copy into stagingBuffer is in flight on the gpu
+        Sorting  // the keys are on the worker threads
+    };
+    AsyncState asyncState;
+    std::shared_ptr<BufferObject> stagingBuffer;
+    struct __GLsync* stagingFence;
+    uint32_t asyncCount;
+    bool sortedValInValBuffer2;  // the cpu backend flips valBuffer and valBuffer2 after each completed async sort
+    std::shared_ptr<Program> preSortProg;
+    std::shared_ptr<Program> histogramProg;
+    std::shared_ptr<Program> sortProg;
+
+    std::vector<uint32_t> atomicCounterVec;
+
+    std::shared_ptr<BufferObject> keyBuffer;
+    std::shared_ptr<BufferObject> keyBuffer2;
+    std::shared_ptr<BufferObject> histogramBuffer;
+    std::shared_ptr<BufferObject> valBuffer;
+    std::shared_ptr<BufferObject> valBuffer2;
+    std::shared_ptr<BufferObject> atomicCounterBuffer;
+};
@@ -0,0 +1,114 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "gputimer.h"
+
+#ifdef __ANDROID__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <cassert>
+
+GpuTimer::GpuTimer() : inSection(false)
+{
+}
+
+GpuTimer::~GpuTimer()
+{
+#ifndef __ANDROID__
+    if (!queryVec.empty())
+    {
+        glDeleteQueries((GLsizei)queryVec.size(), queryVec.data());
+    }
+#endif
+}
+
+void GpuTimer::Reset()
+{
+    assert(!inSection);
+    sectionVec.clear();
+}
+
+void GpuTimer::Begin(const std::string& name)
+{
+    assert(!inSection);
+    inSection = true;
+
+    // queries are reused across resets, only allocate when more sections are used then before.
+    if (2 * sectionVec.size() == queryVec.size())
+    {
+        uint32_t queries[2] = {0, 0};
+#ifndef __ANDROID__
+        glGenQueries(2, queries);
+#endif
+        queryVec.push_back(queries[0]);
+        queryVec.push_back(queries[1]);
+    }
+
+#ifndef __ANDROID__
+    glQueryCounter(queryVec[2 * sectionVec.size()], GL_TIMESTAMP);
+#endif
+    sectionVec.push_back({name, 0.0});
+}
+
+void GpuTimer::End()
+{
+    assert(inSection);
+    inSection = false;
+
+#ifndef __ANDROID__
+    glQueryCounter(queryVec[2 * sectionVec.size() - 1], GL_TIMESTAMP);
+#endif
+}
+
+const std::vector<GpuTimer::Section>& GpuTimer::Resolve()
+{
+    assert(!inSection);
+
+#ifndef __ANDROID__
+    for (size_t i = 0; i < sectionVec.size(); i++)
+    {
+        // blocks until the result is available
+        GLuint64 beginNs = 0;
+        GLuint64 endNs = 0;
+        glGetQueryObjectui64v(queryVec[2 * i], GL_QUERY_RESULT, &beginNs);
+        glGetQueryObjectui64v(queryVec[2 * i + 1], GL_QUERY_RESULT, &endNs);
+        sectionVec[i].ms = (double)(endNs - beginNs) / 1000000.0;
+    }
+#endif
+
+    return sectionVec;
+}
+
+bool GpuTimer::IsAvailable() const
+{
+    assert(!inSection);
+
+#ifndef __ANDROID__
+    // queries complete in order, so only the last one needs to be checked.
+    if (!sectionVec.empty())
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(queryVec[2 * sectionVec.size() - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        return available != 0;
+    }
+#endif
+
+    return true;
+}
+
+bool GpuTimer::IsSupported()
+{
+#ifdef __ANDROID__
+    return false;
+#else
+    return GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+#endif
+}
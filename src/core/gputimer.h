@@ -0,0 +1,43 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Measures the gpu time of a sequence of named sections, using a pair of GL_TIMESTAMP queries per section.
+// Sections of one timer can not be nested, but they can overlap the sections of another timer.
+// Not supported on android, where all sections will report zero.
+class GpuTimer
+{
+public:
+    GpuTimer();
+    ~GpuTimer();
+
+    struct Section
+    {
+        std::string name;
+        double ms;
+    };
+
+    void Reset();
+    void Begin(const std::string& name);
+    void End();
+
+    // waits for the gpu to finish all sections since the last Reset()
+    const std::vector<Section>& Resolve();
+
+    // returns true if Resolve() would not block, useful for timing a frame without stalling the pipeline.
+    bool IsAvailable() const;
+
+    static bool IsSupported();
+
+protected:
+    std::vector<uint32_t> queryVec;  // begin and end timestamp of each section
+    std::vector<Section> sectionVec;
+    bool inSection;
+};
@@ -128,6 +128,24 @@ void Program::AddMacro(const std::string& key, const std::string& value)
     macros.push_back(std::pair(token, value));
 }
 
+void Program::AddExtension(const std::string& name)
+{
+    const std::string headerToken = "/*%%HEADER%%*/";
+    for (auto& macro : macros)
+    {
+        if (macro.first == headerToken)
+        {
+            // the #version is the first line of the header
+            size_t pos = macro.second.find('\n');
+            if (pos == std::string::npos)
+            {
+                pos = macro.second.size();
+            }
+            macro.second.insert(pos, "\n#extension " + name + " : require");
+        }
+    }
+}
+
 bool Program::LoadVertFrag(const std::string& vertFilename, const std::string& fragFilename)
 {
     return LoadVertGeomFrag(vertFilename, std::string(), fragFilename);
@@ -375,6 +393,11 @@ void Program::SetUniformRaw(int loc, const glm::vec2& value) const
     glUniform2fv(loc, 1, (float*)&value);
 }
 
+void Program::SetUniformRaw(int loc, const glm::ivec2& value) const
+{
+    glUniform2iv(loc, 1, (int*)&value);
+}
+
 void Program::SetUniformRaw(int loc, const glm::vec3& value) const
 {
     glUniform3fv(loc, 1, (float*)&value);
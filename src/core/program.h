@@ -23,6 +23,10 @@ public:
     // will replace the string /*%%FOO%%*/ in the source shader with BAR
     void AddMacro(const std::string& key, const std::string& value);
 
+    // adds "#extension NAME : require" to the HEADER macro, right after the #version,
+    // because extension directives must come before any other code.
+    void AddExtension(const std::string& name);
+
     bool LoadVertFrag(const std::string& vertFilename, const std::string& fragFilename);
     bool LoadVertGeomFrag(const std::string& vertFilename, const std::string& geomFilename, const std::string& fragFilename);
     bool LoadCompute(const std::string& computeFilename);
@@ -49,6 +53,7 @@ public:
     void SetUniformRaw(int loc, uint32_t value) const;
     void SetUniformRaw(int loc, float value) const;
     void SetUniformRaw(int loc, const glm::vec2& value) const;
+    void SetUniformRaw(int loc, const glm::ivec2& value) const;
     void SetUniformRaw(int loc, const glm::vec3& value) const;
     void SetUniformRaw(int loc, const glm::vec4& value) const;
     void SetUniformRaw(int loc, const glm::mat2& value) const;
@@ -0,0 +1,590 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "simxrbuddy.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <glm/gtc/constants.hpp>
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#else
+#define ZoneScoped
+#define ZoneScopedNC(NAME, COLOR)
+#endif
+
+#include "gputimer.h"
+#include "log.h"
+#include "util.h"
+
+// how often the stats are logged, in seconds.
+static const float STATS_PERIOD = 5.0f;
+
+// head relative offsets of the simulated controllers
+static const glm::vec3 LEFT_HAND_OFFSET(-0.2f, -0.35f, -0.35f);
+static const glm::vec3 RIGHT_HAND_OFFSET(0.2f, -0.35f, -0.35f);
+
+// used to compute the velocities by finite difference, in seconds.
+static const double VELOCITY_DT = 0.001;
+
+static XrPosef MakePose(const glm::vec3& pos, const glm::quat& rot)
+{
+    XrPosef pose;
+    pose.position = {pos.x, pos.y, pos.z};
+    pose.orientation = {rot.x, rot.y, rot.z, rot.w};
+    return pose;
+}
+
+// angular velocity in the base space, that rotates q0 into q1 over dt
+static glm::vec3 AngularVelocity(const glm::quat& q0, const glm::quat& q1, float dt)
+{
+    glm::quat dq = q1 * glm::inverse(q0);
+    if (dq.w < 0.0f)
+    {
+        dq = -dq;
+    }
+    return glm::axis(dq) * glm::angle(dq) / dt;
+}
+
+SimXrBuddy::SimXrBuddy(MainContext& mainContextIn, const glm::vec2& nearFarIn, const Config& configIn) :
+    XrBuddy(mainContextIn, nearFarIn, false),
+    config(configIn)
+{
+    constructorSucceded = true;
+}
+
+SimXrBuddy::~SimXrBuddy()
+{
+    // before BlockingWaitFrame() is gone
+    StopFrameWaitThread();
+
+    // the app does not always call Shutdown(), the gl context may already be gone here, so just log what was resolved.
+    if (sessionReady)
+    {
+        FlushStats();
+        LogStats("SimXrBuddy total", totalStats);
+    }
+}
+
+bool SimXrBuddy::Init()
+{
+    if (!config.poseFilename.empty())
+    {
+        if (!LoadPoses(config.poseFilename))
+        {
+            Log::E("SimXrBuddy: failed to load poses from \"%s\"\n", config.poseFilename.c_str());
+            return false;
+        }
+    }
+
+    if (config.displayRate <= 0.0f)
+    {
+        Log::E("SimXrBuddy: bad display rate %.2f\n", config.displayRate);
+        return false;
+    }
+    displayPeriod = (XrDuration)(1.0e9 / config.displayRate);
+
+    glGenFramebuffers(1, &frameBuffer);
+
+    // "swapchain" images, a few per view, just like a runtime would rotate through them.
+    // the format is one a runtime could pick, that is available on all platforms.
+    const uint32_t numViews = 2;
+    swapchains.resize(numViews);
+    swapchainImages.resize(numViews);
+    depthTextures.resize(numViews * numImages);
+    for (uint32_t i = 0; i < numViews; i++)
+    {
+        swapchains[i] = {XR_NULL_HANDLE, GL_RGBA8, config.eyeSize.x, config.eyeSize.y};
+        swapchainImages[i].resize(numImages);
+        for (uint32_t j = 0; j < numImages; j++)
+        {
+            uint32_t colorTexture = 0;
+            glGenTextures(1, &colorTexture);
+            glBindTexture(GL_TEXTURE_2D, colorTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, config.eyeSize.x, config.eyeSize.y);
+
+            uint32_t depthTexture = 0;
+            glGenTextures(1, &depthTexture);
+            glBindTexture(GL_TEXTURE_2D, depthTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, config.eyeSize.x, config.eyeSize.y);
+
+            swapchainImages[i][j] = {};
+            swapchainImages[i][j].image = colorTexture;
+            depthTextures[i * numImages + j] = depthTexture;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GL_ERROR_CHECK("SimXrBuddy::Init() textures");
+
+    for (auto&& gpuTimer : gpuTimers)
+    {
+        gpuTimer = std::make_shared<GpuTimer>();
+    }
+    if (!GpuTimer::IsSupported())
+    {
+        Log::W("SimXrBuddy: gpu timer queries are not supported, gpu times will be zero\n");
+    }
+
+    // the same pose actions the app reads from the real XrBuddy
+    for (auto&& name : {"l_aim_pose", "r_aim_pose", "l_grip_pose", "r_grip_pose"})
+    {
+        actionMap[name] = ActionInfo(XR_NULL_HANDLE, XR_ACTION_TYPE_POSE_INPUT, XR_NULL_HANDLE);
+        actionMap[name].u.poseState = {};
+        actionMap[name].u.poseState.isActive = XR_TRUE;
+    }
+
+    startTime = Clock::now();
+    lastWaitTime = startTime;
+    lastLogTime = startTime;
+    waitDisplayTime = displayPeriod;
+    lastPredictedDisplayTime = displayPeriod;
+    lastPredictedDisplayPeriod = displayPeriod;
+    UpdatePoses(0.0);
+
+    state = XR_SESSION_STATE_FOCUSED;
+    sessionReady = true;
+
+    Log::I("SimXrBuddy: %d x %d per eye at %.1f hz, %s, %s\n", config.eyeSize.x, config.eyeSize.y, config.displayRate,
+           config.paced ? "paced" : "unpaced", poses.empty() ? "synthetic poses" : config.poseFilename.c_str());
+
+    return true;
+}
+
+bool SimXrBuddy::PollEvents()
+{
+    return true;
+}
+
+bool SimXrBuddy::SyncInput()
+{
+    // poses are updated in RenderFrame(), for the predicted display time of each frame, like XrBuddy::LocateSpaces().
+    return true;
+}
+
+bool SimXrBuddy::SessionReady() const
+{
+    return sessionReady;
+}
+
+XrResult SimXrBuddy::BlockingWaitFrame(XrFrameState& frameState)
+{
+    // xrWaitFrame() returns one display period before the predicted display time.
+    XrTime displayTime = waitDisplayTime + displayPeriod;
+    Clock::time_point now = Clock::now();
+    XrTime elapsed = (XrTime)std::chrono::duration_cast<std::chrono::nanoseconds>(now - startTime).count();
+    if (config.paced)
+    {
+        XrTime frameStart = displayTime - displayPeriod;
+        if (elapsed < frameStart)
+        {
+            ZoneScopedNC("wait frame", tracy::Color::Red4);
+            std::this_thread::sleep_for(std::chrono::nanoseconds(frameStart - elapsed));
+        }
+        else if (elapsed - frameStart >= displayPeriod)
+        {
+            // too late for this display time, the compositor would have shown the previous frame again.
+            XrDuration missed = (elapsed - frameStart) / displayPeriod;
+            displayTime += missed * displayPeriod;
+            waitMisses += missed;
+        }
+    }
+    else
+    {
+        if (waitCount > 0 && std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastWaitTime).count() > displayPeriod)
+        {
+            waitMisses++;
+        }
+        displayTime = elapsed + displayPeriod;
+    }
+    lastWaitTime = Clock::now();
+    waitDisplayTime = displayTime;
+    waitCount++;
+
+    frameState.type = XR_TYPE_FRAME_STATE;
+    frameState.next = NULL;
+    frameState.predictedDisplayTime = displayTime;
+    frameState.predictedDisplayPeriod = displayPeriod;
+    frameState.shouldRender = XR_TRUE;
+    return XR_SUCCESS;
+}
+
+bool SimXrBuddy::RenderFrame()
+{
+    ZoneScoped;
+
+    XrFrameState fs = {};
+    if (!WaitFrame(fs))
+    {
+        return false;
+    }
+    // picked up before the next wait is requested, which may update them on the frame wait thread.
+    stats.cpuMisses += waitMisses;
+    waitMisses = 0;
+
+    // there is no xrBeginFrame() to wait for, the next frame can be waited on right away.
+    if (pipelined)
+    {
+        RequestFrameWait();
+    }
+
+    Clock::time_point frameStart = Clock::now();
+    lastPredictedDisplayTime = fs.predictedDisplayTime;
+    lastPredictedDisplayPeriod = fs.predictedDisplayPeriod;
+
+    UpdatePoses((double)fs.predictedDisplayTime * 1.0e-9);
+
+    // at most two frames of gpu work in flight, like a runtime waiting on the swapchain images.
+    WaitFrameFence();
+
+    ResolveStats(false);
+    if (gpuTimerPending[gpuTimerIndex])
+    {
+        ResolveStats(true);
+    }
+
+    // build the views from the head pose, the same way xrLocateViews() would.
+    glm::vec3 headPos(viewSpaceLocation.pose.position.x, viewSpaceLocation.pose.position.y, viewSpaceLocation.pose.position.z);
+    const XrQuaternionf& o = viewSpaceLocation.pose.orientation;
+    glm::quat headRot(o.w, o.x, o.y, o.z);
+
+    const uint32_t numViews = (uint32_t)swapchains.size();
+    std::vector<XrCompositionLayerProjectionView> layerViews(numViews);
+    std::vector<uint32_t> colorTextures(numViews);
+    std::vector<uint32_t> viewDepthTextures(numViews);
+    for (uint32_t i = 0; i < numViews; i++)
+    {
+        const float side = (i == 0) ? -1.0f : 1.0f;
+        glm::vec3 eyePos = headPos + headRot * glm::vec3(side * 0.5f * config.ipd, 0.0f, 0.0f);
+
+        layerViews[i] = {};
+        layerViews[i].type = XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW;
+        layerViews[i].pose = MakePose(eyePos, headRot);
+        layerViews[i].fov.angleLeft = (i == 0) ? -config.fovOuter : -config.fovInner;
+        layerViews[i].fov.angleRight = (i == 0) ? config.fovInner : config.fovOuter;
+        layerViews[i].fov.angleUp = config.fovUp;
+        layerViews[i].fov.angleDown = -config.fovDown;
+        layerViews[i].subImage.swapchain = XR_NULL_HANDLE;
+        layerViews[i].subImage.imageRect.offset = {0, 0};
+        layerViews[i].subImage.imageRect.extent = {swapchains[i].width, swapchains[i].height};
+
+        colorTextures[i] = swapchainImages[i][imageIndex].image;
+        viewDepthTextures[i] = depthTextures[i * numImages + imageIndex];
+    }
+
+    prevLastColorTexture = lastColorTexture;
+    lastColorTexture = colorTextures[0];  // save for rendering onto desktop.
+
+    GpuTimer* gpuTimer = gpuTimers[gpuTimerIndex].get();
+    gpuTimer->Reset();
+    DrawViews(layerViews, colorTextures, viewDepthTextures, gpuTimer);
+    gpuTimerPending[gpuTimerIndex] = true;
+    gpuTimerIndex = (gpuTimerIndex + 1) % NUM_TIMERS;
+
+    SignalFrameFence();
+    imageIndex = (imageIndex + 1) % numImages;
+    frameCount++;
+
+    // cpu time of the submit, the time between frames is covered by the deadline misses above.
+    Clock::time_point frameEnd = Clock::now();
+    double cpuMs = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+    stats.frames++;
+    stats.cpuMs += cpuMs;
+    stats.maxCpuMs = std::max(stats.maxCpuMs, cpuMs);
+
+    if (std::chrono::duration<float>(frameEnd - lastLogTime).count() >= STATS_PERIOD)
+    {
+        FlushStats();
+        lastLogTime = frameEnd;
+    }
+
+    GL_ERROR_CHECK("SimXrBuddy::RenderFrame()");
+
+    return true;
+}
+
+bool SimXrBuddy::Shutdown()
+{
+    StopFrameWaitThread();
+    glFinish();
+    ResolveStats(true);
+    FlushStats();
+    LogStats("SimXrBuddy total", totalStats);
+
+    for (auto&& fence : frameFences)
+    {
+        if (fence)
+        {
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+    for (auto&& images : swapchainImages)
+    {
+        for (auto&& image : images)
+        {
+            glDeleteTextures(1, &image.image);
+        }
+    }
+    swapchainImages.clear();
+    swapchains.clear();
+    glDeleteTextures((GLsizei)depthTextures.size(), depthTextures.data());
+    depthTextures.clear();
+
+    if (stereoFrameBuffer)
+    {
+        glDeleteFramebuffers(1, &stereoFrameBuffer);
+        glDeleteTextures(1, &stereoColorTexture);
+        glDeleteTextures(1, &stereoDepthTexture);
+        stereoFrameBuffer = 0;
+    }
+    glDeleteFramebuffers(1, &frameBuffer);
+    frameBuffer = 0;
+
+    for (auto&& gpuTimer : gpuTimers)
+    {
+        gpuTimer.reset();
+    }
+
+    sessionReady = false;
+    state = XR_SESSION_STATE_EXITING;
+    return true;
+}
+
+void SimXrBuddy::CycleColorSpace()
+{
+    // no compositor, so no color space to change.
+}
+
+bool SimXrBuddy::LoadPoses(const std::string& filename)
+{
+    std::ifstream f(filename);
+    if (f.fail())
+    {
+        return false;
+    }
+
+    poses.clear();
+    std::string line;
+    while (std::getline(f, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::istringstream ss(line);
+        PoseSample s;
+        if (!(ss >> s.time >> s.pos.x >> s.pos.y >> s.pos.z >> s.rot.x >> s.rot.y >> s.rot.z >> s.rot.w))
+        {
+            Log::E("SimXrBuddy: bad pose line \"%s\"\n", line.c_str());
+            return false;
+        }
+        s.rot = glm::normalize(s.rot);
+        if (!poses.empty() && s.time <= poses.back().time)
+        {
+            Log::E("SimXrBuddy: pose times must be increasing, \"%s\"\n", line.c_str());
+            return false;
+        }
+        poses.push_back(s);
+    }
+
+    if (poses.size() < 2)
+    {
+        Log::E("SimXrBuddy: at least two poses are required\n");
+        return false;
+    }
+
+    Log::I("SimXrBuddy: loaded %d poses, %.2f sec\n", (int)poses.size(), poses.back().time - poses.front().time);
+    return true;
+}
+
+void SimXrBuddy::SampleHeadPose(double time, glm::vec3& posOut, glm::quat& rotOut) const
+{
+    if (poses.empty())
+    {
+        // standing, looking around with a slow yaw and a little pitch and sway, roughly what a viewer does.
+        const float t = (float)time;
+        float yaw = 0.7f * sinf(0.4f * t) + 0.2f * sinf(1.3f * t);
+        float pitch = 0.15f * sinf(0.7f * t);
+        posOut = glm::vec3(0.05f * sinf(0.5f * t), 1.6f + 0.02f * sinf(1.1f * t), 0.05f * sinf(0.3f * t));
+        rotOut = glm::angleAxis(yaw, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::angleAxis(pitch, glm::vec3(1.0f, 0.0f, 0.0f));
+        return;
+    }
+
+    // loop the recording
+    const double start = poses.front().time;
+    const double duration = poses.back().time - start;
+    double t = start + fmod(time, duration);
+
+    auto iter = std::upper_bound(poses.begin(), poses.end(), t, [](double t, const PoseSample& s) { return t < s.time; });
+    if (iter == poses.begin())
+    {
+        iter++;
+    }
+    else if (iter == poses.end())
+    {
+        iter--;
+    }
+    const PoseSample& a = *(iter - 1);
+    const PoseSample& b = *iter;
+    float alpha = glm::clamp((float)((t - a.time) / (b.time - a.time)), 0.0f, 1.0f);
+    posOut = glm::mix(a.pos, b.pos, alpha);
+    rotOut = SafeMix(a.rot, b.rot, alpha);
+}
+
+void SimXrBuddy::UpdatePoses(double time)
+{
+    glm::vec3 pos0, pos1;
+    glm::quat rot0, rot1;
+    SampleHeadPose(time, pos0, rot0);
+    SampleHeadPose(time + VELOCITY_DT, pos1, rot1);
+    glm::vec3 linearVel = (pos1 - pos0) / (float)VELOCITY_DT;
+    glm::vec3 angularVel = AngularVelocity(rot0, rot1, (float)VELOCITY_DT);
+
+    const XrSpaceLocationFlags locationFlags = XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_POSITION_TRACKED_BIT |
+        XR_SPACE_LOCATION_ORIENTATION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_TRACKED_BIT;
+    const XrSpaceVelocityFlags velocityFlags = XR_SPACE_VELOCITY_LINEAR_VALID_BIT | XR_SPACE_VELOCITY_ANGULAR_VALID_BIT;
+
+    viewSpaceLocation.type = XR_TYPE_SPACE_LOCATION;
+    viewSpaceLocation.locationFlags = locationFlags;
+    viewSpaceLocation.pose = MakePose(pos0, rot0);
+    viewSpaceVelocity.type = XR_TYPE_SPACE_VELOCITY;
+    viewSpaceVelocity.velocityFlags = velocityFlags;
+    viewSpaceVelocity.linearVelocity = {linearVel.x, linearVel.y, linearVel.z};
+    viewSpaceVelocity.angularVelocity = {angularVel.x, angularVel.y, angularVel.z};
+
+    // the controllers are rigidly attached to the head
+    glm::vec3 leftPos = pos0 + rot0 * LEFT_HAND_OFFSET;
+    glm::vec3 rightPos = pos0 + rot0 * RIGHT_HAND_OFFSET;
+    glm::vec3 leftVel = linearVel + glm::cross(angularVel, rot0 * LEFT_HAND_OFFSET);
+    glm::vec3 rightVel = linearVel + glm::cross(angularVel, rot0 * RIGHT_HAND_OFFSET);
+    SetActionPose("l_aim_pose", leftPos, rot0, leftVel, angularVel);
+    SetActionPose("l_grip_pose", leftPos, rot0, leftVel, angularVel);
+    SetActionPose("r_aim_pose", rightPos, rot0, rightVel, angularVel);
+    SetActionPose("r_grip_pose", rightPos, rot0, rightVel, angularVel);
+}
+
+void SimXrBuddy::SetActionPose(const std::string& actionName, const glm::vec3& pos, const glm::quat& rot,
+                               const glm::vec3& linearVel, const glm::vec3& angularVel)
+{
+    auto iter = actionMap.find(actionName);
+    if (iter == actionMap.end())
+    {
+        return;
+    }
+
+    ActionInfo& info = iter->second;
+    info.spaceLocation.locationFlags = viewSpaceLocation.locationFlags;
+    info.spaceLocation.pose = MakePose(pos, rot);
+    info.spaceVelocity.velocityFlags = viewSpaceVelocity.velocityFlags;
+    info.spaceVelocity.linearVelocity = {linearVel.x, linearVel.y, linearVel.z};
+    info.spaceVelocity.angularVelocity = {angularVel.x, angularVel.y, angularVel.z};
+}
+
+// accumulates the gpu times of the frames that are done, if block is true, waits for all of them.
+void SimXrBuddy::ResolveStats(bool block)
+{
+    const double periodMs = (double)displayPeriod * 1.0e-6;
+
+    // oldest first
+    for (int k = 0; k < NUM_TIMERS; k++)
+    {
+        const uint32_t i = (gpuTimerIndex + k) % NUM_TIMERS;
+        if (!gpuTimerPending[i] || !gpuTimers[i])
+        {
+            continue;
+        }
+        if (!block && !gpuTimers[i]->IsAvailable())
+        {
+            break;
+        }
+
+        double frameMs = 0.0;
+        for (auto&& section : gpuTimers[i]->Resolve())
+        {
+            frameMs += section.ms;
+            auto iter = std::find_if(stats.sectionMs.begin(), stats.sectionMs.end(),
+                                     [&section](const std::pair<std::string, double>& p) { return p.first == section.name; });
+            if (iter == stats.sectionMs.end())
+            {
+                stats.sectionMs.push_back(std::make_pair(section.name, section.ms));
+            }
+            else
+            {
+                iter->second += section.ms;
+            }
+        }
+        gpuTimerPending[i] = false;
+
+        stats.gpuFrames++;
+        stats.gpuMs += frameMs;
+        stats.maxGpuMs = std::max(stats.maxGpuMs, frameMs);
+        if (frameMs > periodMs)
+        {
+            stats.gpuMisses++;
+        }
+    }
+}
+
+void SimXrBuddy::LogStats(const char* label, const Stats& s) const
+{
+    if (s.frames == 0)
+    {
+        return;
+    }
+
+    std::string sections;
+    for (auto&& p : s.sectionMs)
+    {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), ", %s %.2f ms", p.first.c_str(), s.gpuFrames ? p.second / s.gpuFrames : 0.0);
+        sections += buffer;
+    }
+
+    Log::I("%s: %llu frames, cpu %.2f ms (max %.2f), gpu %.2f ms (max %.2f)%s, missed deadlines cpu %llu gpu %llu, budget %.2f ms\n",
+           label, (unsigned long long)s.frames, s.cpuMs / s.frames, s.maxCpuMs,
+           s.gpuFrames ? s.gpuMs / s.gpuFrames : 0.0, s.maxGpuMs, sections.c_str(),
+           (unsigned long long)s.cpuMisses, (unsigned long long)s.gpuMisses, (double)displayPeriod * 1.0e-6);
+}
+
+// logs the stats since the last flush, and folds them into the totals
+void SimXrBuddy::FlushStats()
+{
+    LogStats("SimXrBuddy", stats);
+
+    totalStats.frames += stats.frames;
+    totalStats.gpuFrames += stats.gpuFrames;
+    totalStats.cpuMisses += stats.cpuMisses;
+    totalStats.gpuMisses += stats.gpuMisses;
+    totalStats.cpuMs += stats.cpuMs;
+    totalStats.maxCpuMs = std::max(totalStats.maxCpuMs, stats.maxCpuMs);
+    totalStats.gpuMs += stats.gpuMs;
+    totalStats.maxGpuMs = std::max(totalStats.maxGpuMs, stats.maxGpuMs);
+    for (auto&& p : stats.sectionMs)
+    {
+        auto iter = std::find_if(totalStats.sectionMs.begin(), totalStats.sectionMs.end(),
+                                 [&p](const std::pair<std::string, double>& q) { return q.first == p.first; });
+        if (iter == totalStats.sectionMs.end())
+        {
+            totalStats.sectionMs.push_back(p);
+        }
+        else
+        {
+            iter->second += p.second;
+        }
+    }
+    stats = Stats();
+}
@@ -0,0 +1,121 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "xrbuddy.h"
+
+class GpuTimer;
+
+// Headless stand-in for XrBuddy, used to benchmark the vr render path without a headset or an openxr runtime.
+// The head and controller poses are synthetic or played back from a recording, the views use a quest like
+// asymmetric stereo projection and the frames are paced to the display rate. Each view is rendered into an
+// offscreen "swapchain" texture, which is never displayed, except by the desktop mirror.
+// The gpu time of each view and the number of missed frame deadlines are logged periodically and on Shutdown().
+class SimXrBuddy : public XrBuddy
+{
+public:
+    struct Config
+    {
+        glm::ivec2 eyeSize = glm::ivec2(1440, 1584);
+        float displayRate = 90.0f;  // hz
+        float ipd = 0.063f;  // meters
+
+        // tangent half angles of the left eye, in radians, the right eye is mirrored.
+        float fovOuter = glm::radians(52.0f);
+        float fovInner = glm::radians(42.0f);
+        float fovUp = glm::radians(42.0f);
+        float fovDown = glm::radians(48.0f);
+
+        // optional, one pose per line "time px py pz qx qy qz qw", time in seconds.
+        // the recording is looped, when empty a synthetic head motion is used.
+        std::string poseFilename;
+
+        // when false frames are rendered back to back, i.e. to measure throughput instead of deadline misses.
+        bool paced = true;
+    };
+
+    SimXrBuddy(MainContext& mainContextIn, const glm::vec2& nearFarIn, const Config& configIn);
+    virtual ~SimXrBuddy();
+
+    virtual bool Init() override;
+    virtual bool PollEvents() override;
+    virtual bool SyncInput() override;
+    virtual bool SessionReady() const override;
+    virtual bool RenderFrame() override;
+    virtual bool Shutdown() override;
+    virtual void CycleColorSpace() override;
+
+protected:
+    struct PoseSample
+    {
+        double time;
+        glm::vec3 pos;
+        glm::quat rot;
+    };
+
+    // simulates xrWaitFrame(), paces the frames to the display rate.
+    virtual XrResult BlockingWaitFrame(XrFrameState& frameState) override;
+
+    bool LoadPoses(const std::string& filename);
+    void SampleHeadPose(double time, glm::vec3& posOut, glm::quat& rotOut) const;
+    void UpdatePoses(double time);
+    void SetActionPose(const std::string& actionName, const glm::vec3& pos, const glm::quat& rot,
+                       const glm::vec3& linearVel, const glm::vec3& angularVel);
+    void ResolveStats(bool block);
+    void FlushStats();
+
+    Config config;
+    std::vector<PoseSample> poses;
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point startTime;
+    XrDuration displayPeriod = 0;
+
+    // only touched by BlockingWaitFrame(), which may run on the frame wait thread.
+    XrTime waitDisplayTime = 0;
+    Clock::time_point lastWaitTime;
+    uint64_t waitCount = 0;
+    uint64_t waitMisses = 0;  // since the last RenderFrame() picked them up
+    uint64_t frameCount = 0;
+
+    // one timer per frame in flight, resolved a couple of frames later so the gpu is never stalled.
+    static const int NUM_TIMERS = 3;
+    std::array<std::shared_ptr<GpuTimer>, NUM_TIMERS> gpuTimers;
+    std::array<bool, NUM_TIMERS> gpuTimerPending = {};
+    uint32_t gpuTimerIndex = 0;
+
+    uint32_t numImages = 3;
+    uint32_t imageIndex = 0;
+    std::vector<uint32_t> depthTextures;
+
+    // accumulated since the last LogStats()
+    struct Stats
+    {
+        uint64_t frames = 0;
+        uint64_t gpuFrames = 0;
+        uint64_t cpuMisses = 0;
+        uint64_t gpuMisses = 0;
+        double cpuMs = 0.0;
+        double maxCpuMs = 0.0;
+        double gpuMs = 0.0;
+        double maxGpuMs = 0.0;
+        std::vector<std::pair<std::string, double>> sectionMs;  // summed over gpuFrames
+    };
+    void LogStats(const char* label, const Stats& s) const;
+
+    Stats stats;
+    Stats totalStats;
+    Clock::time_point lastLogTime;
+};
@@ -83,7 +83,7 @@ Texture::Texture(const Image& image, const Params& params)
 }
 
 Texture::Texture(uint32_t width, uint32_t height, uint32_t internalFormat,
-                 uint32_t format, uint32_t type, const Params& params)
+                 uint32_t format, uint32_t type, const Params& params, const void* data)
 {
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
@@ -93,7 +93,7 @@ Texture::Texture(uint32_t width, uint32_t height, uint32_t internalFormat,
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapTypeToGL[(int)params.sWrap]);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapTypeToGL[(int)params.tWrap]);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, data);
 }
 
 Texture::~Texture()
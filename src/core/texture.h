@@ -38,8 +38,9 @@ struct Texture
     };
 
     Texture(const Image& image, const Params& params);
+    // data is optional, the texture is left uninitialized if it is nullptr.
     Texture(uint32_t width, uint32_t height, uint32_t internalFormat,
-            uint32_t format, uint32_t type, const Params& params);
+            uint32_t format, uint32_t type, const Params& params, const void* data = nullptr);
     ~Texture();
 
     void Bind(int unit) const;
@@ -168,6 +168,13 @@ void BufferObject::Update(const std::vector<uint32_t>& data)
 	Unbind();
 }
 
+void BufferObject::Update(const void* data, size_t size)
+{
+	Bind();
+	glBufferSubData(target, 0, size, data);
+	Unbind();
+}
+
 void BufferObject::Read(std::vector<uint32_t>& data)
 {
 	Bind();
@@ -178,8 +185,29 @@ void BufferObject::Read(std::vector<uint32_t>& data)
 	if (rawBuffer)
 	{
 		memcpy((void*)data.data(), rawBuffer, bufferSize);
+		glUnmapBuffer(target);  // unmapping a buffer that failed to map is an error of its own
+	}
+	Unbind();
+}
+
+void BufferObject::Read(void* data, size_t size)
+{
+	Read(data, 0, size);
+}
+
+void BufferObject::Read(void* data, size_t offset, size_t size)
+{
+	if (size == 0)
+	{
+		return;  // mapping an empty range is an error
+	}
+	Bind();
+	void* rawBuffer = glMapBufferRange(target, offset, size, GL_MAP_READ_BIT);
+	if (rawBuffer)
+	{
+		memcpy(data, rawBuffer, size);
+		glUnmapBuffer(target);
 	}
-	glUnmapBuffer(target);
 	Unbind();
 }
 
@@ -218,11 +246,12 @@ void VertexArrayObject::SetAttribBuffer(int loc, std::shared_ptr<BufferObject> a
 
 void VertexArrayObject::SetElementBuffer(std::shared_ptr<BufferObject> elementBufferIn)
 {
-	assert(elementBufferIn->target == GL_ELEMENT_ARRAY_BUFFER);
 	elementBuffer = elementBufferIn;
 
+	// NOTE: buffer objects are not typed, so any buffer (such as the output of a compute shader sort)
+	// can be used as the element buffer, regardless of the target it was created with.
 	Bind();
-	elementBufferIn->Bind();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBufferIn->obj);
 	Unbind();
 }
 
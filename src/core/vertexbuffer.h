@@ -48,8 +48,11 @@ public:
 	void Update(const std::vector<glm::vec3>& data);
 	void Update(const std::vector<glm::vec4>& data);
 	void Update(const std::vector<uint32_t>& data);
+	void Update(const void* data, size_t size);  // updates the first size bytes of the buffer
 
 	void Read(std::vector<uint32_t>& data);
+	void Read(void* data, size_t size);  // reads the first size bytes of the buffer
+	void Read(void* data, size_t offset, size_t size);
 
 	uint32_t GetObj() const { return obj; }
 
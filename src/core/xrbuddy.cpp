@@ -9,7 +9,10 @@
 #include <string.h>
 #include <vector>
 
-#ifndef __ANDROID__
+#ifdef __ANDROID__
+#include <GLES3/gl32.h>
+#include <GLES2/gl2ext.h>  // GL_OVR_multiview
+#else
 #include <GL/glew.h>
 #endif
 
@@ -22,6 +25,7 @@
 #define ZoneScopedNC(NAME, COLOR)
 #endif
 
+#include "gputimer.h"
 #include "log.h"
 #include "util.h"
 
@@ -480,7 +484,7 @@ static bool CreateSession(XrInstance instance, XrSystemId systemId, XrSession& s
 }
 
 static bool CreateActions(XrInstance instance, XrSystemId systemId, XrSession session, XrActionSet& actionSet,
-                          std::map<std::string, XrBuddy::ActionInfo>& actionMap)
+                          std::map<std::string, XrBuddy::ActionInfo>& actionMap, bool eyeGazeSupported)
 {
     XrResult result;
 
@@ -523,6 +527,11 @@ static bool CreateActions(XrInstance instance, XrSystemId systemId, XrSession se
         {"r_stick", XR_ACTION_TYPE_VECTOR2F_INPUT}
     };
 
+    if (eyeGazeSupported)
+    {
+        actionPairVec.push_back({"gaze_pose", XR_ACTION_TYPE_POSE_INPUT});
+    }
+
     for (auto& actionPair : actionPairVec)
     {
         // selectAction
@@ -679,6 +688,28 @@ static bool CreateActions(XrInstance instance, XrSystemId systemId, XrSession se
         }
     }
 
+    // eye tracking, the gaze pose is in the stage space like the other poses, looking down its -z axis.
+    if (eyeGazeSupported)
+    {
+        XrPath interactionProfilePath = XR_NULL_PATH;
+        xrStringToPath(instance, "/interaction_profiles/ext/eye_gaze_interaction", &interactionProfilePath);
+        std::vector<XrActionSuggestedBinding> bindings = {
+            {actionMap["gaze_pose"].action, pathCache["/user/eyes_ext/input/gaze_ext/pose"]}
+        };
+
+        XrInteractionProfileSuggestedBinding suggestedBindings = {};
+        suggestedBindings.type = XR_TYPE_INTERACTION_PROFILE_SUGGESTED_BINDING;
+        suggestedBindings.next = NULL;
+        suggestedBindings.interactionProfile = interactionProfilePath;
+        suggestedBindings.suggestedBindings = bindings.data();
+        suggestedBindings.countSuggestedBindings = (uint32_t)bindings.size();
+        result = xrSuggestInteractionProfileBindings(instance, &suggestedBindings);
+        if (!CheckResult(instance, result, "xrSuggestInteractionProfileBindings"))
+        {
+            return false;
+        }
+    }
+
     // TODO
 #if 0
     // microsoft mixed reality
@@ -922,6 +953,7 @@ static bool CreateSwapchains(XrInstance instance, XrSession session,
         }
 
         swapchains[i].handle = swapchainHandle;
+        swapchains[i].format = sci.format;
         swapchains[i].width = sci.width;
         swapchains[i].height = sci.height;
 
@@ -974,17 +1006,26 @@ static GLuint CreateDepthTexture(GLuint colorTexture, GLint width, GLint height)
     return depthTexture;
 }
 
-XrBuddy::XrBuddy(MainContext& mainContextIn, const glm::vec2& nearFarIn):
+XrBuddy::XrBuddy(MainContext& mainContextIn, const glm::vec2& nearFarIn) :
+    XrBuddy(mainContextIn, nearFarIn, true)
+{
+}
+
+XrBuddy::XrBuddy(MainContext& mainContextIn, const glm::vec2& nearFarIn, bool useRuntime):
     mainContext(mainContextIn)
 {
     nearFar = nearFarIn;
+    if (!useRuntime)
+    {
+        return;
+    }
 
 #ifdef XR_USE_GRAPHICS_API_OPENGL
     std::vector<const char*> requiredExtensionVec = {XR_KHR_OPENGL_ENABLE_EXTENSION_NAME};
 #elif defined(XR_USE_GRAPHICS_API_OPENGL_ES)
     std::vector<const char*> requiredExtensionVec = {XR_KHR_OPENGL_ES_ENABLE_EXTENSION_NAME};
 #endif
-    std::vector<const char*> optionalExtensionVec = {XR_FB_COLOR_SPACE_EXTENSION_NAME};
+    std::vector<const char*> optionalExtensionVec = {XR_FB_COLOR_SPACE_EXTENSION_NAME, XR_EXT_EYE_GAZE_INTERACTION_EXTENSION_NAME};
     std::vector<const char*> extensionVec;
 
 #ifdef __ANDROID__
@@ -1057,6 +1098,12 @@ XrBuddy::XrBuddy(MainContext& mainContextIn, const glm::vec2& nearFarIn):
     constructorSucceded = true;
 }
 
+XrBuddy::~XrBuddy()
+{
+    // the app does not always call Shutdown(), a wait thread that is still running would terminate the process.
+    StopFrameWaitThread();
+}
+
 bool XrBuddy::Init()
 {
     if (!constructorSucceded)
@@ -1074,7 +1121,9 @@ bool XrBuddy::Init()
         SetColorSpace(instance, session, XR_COLOR_SPACE_REC709_FB);
     }
 
-    if (!CreateActions(instance, systemId, session, actionSet, actionMap))
+    // the "gaze_pose" action only exists when the runtime supports eye tracking.
+    bool eyeGazeSupported = ExtensionSupported(extensionProps, XR_EXT_EYE_GAZE_INTERACTION_EXTENSION_NAME);
+    if (!CreateActions(instance, systemId, session, actionSet, actionMap, eyeGazeSupported))
     {
         return false;
     }
@@ -1151,6 +1200,7 @@ bool XrBuddy::PollEvents()
             case XR_SESSION_STATE_STOPPING:
                 Log::D("XR_SESSION_STATE_STOPPING\n");
                 // The application should exit its frame loop and call xrEndSession.
+                StopFrameWaitThread();
                 if (!EndSession(instance, systemId, session))
                 {
                     return false;
@@ -1545,36 +1595,31 @@ bool XrBuddy::RenderFrame()
         state == XR_SESSION_STATE_FOCUSED)
     {
         XrFrameState fs = {};
-        fs.type = XR_TYPE_FRAME_STATE;
-        fs.next = NULL;
-
-        XrFrameWaitInfo fwi = {};
-        fwi.type = XR_TYPE_FRAME_WAIT_INFO;
-        fwi.next = NULL;
-
-        XrResult result;
+        if (!WaitFrame(fs))
         {
-            ZoneScopedNC("xrWaitFrame", tracy::Color::Red4);
-            result = xrWaitFrame(session, &fwi, &fs);
-            if (!CheckResult(instance, result, "xrWaitFrame"))
-            {
-                return false;
-            }
+            return false;
         }
         lastPredictedDisplayTime = fs.predictedDisplayTime;
+        lastPredictedDisplayPeriod = fs.predictedDisplayPeriod;
 
         XrFrameBeginInfo fbi = {};
         fbi.type = XR_TYPE_FRAME_BEGIN_INFO;
         fbi.next = NULL;
         {
             ZoneScopedNC("xrBeginFrame", tracy::Color::DarkGreen);
-            result = xrBeginFrame(session, &fbi);
+            XrResult result = xrBeginFrame(session, &fbi);
             if (!CheckResult(instance, result, "xrBeginFrame"))
             {
                 return false;
             }
         }
 
+        // the runtime blocks the next xrWaitFrame() until this frame has begun, so it can start now.
+        if (pipelined)
+        {
+            RequestFrameWait();
+        }
+
         std::vector<XrCompositionLayerBaseHeader*> layers;
         XrCompositionLayerProjection layer = {};
         layer.type = XR_TYPE_COMPOSITION_LAYER_PROJECTION;
@@ -1587,10 +1632,22 @@ bool XrBuddy::RenderFrame()
             {
                 return false;
             }
+
+            // wait for the gpu to finish the frame before last, instead of whatever the driver and runtime would block on.
+            if (pipelined)
+            {
+                WaitFrameFence();
+            }
+
             if (RenderLayer(fs.predictedDisplayTime, projectionLayerViews, layer))
             {
                 layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&layer));
             }
+
+            if (pipelined)
+            {
+                SignalFrameFence();
+            }
         }
 
         XrFrameEndInfo fei = {};
@@ -1604,7 +1661,7 @@ bool XrBuddy::RenderFrame()
         {
             ZoneScopedNC("xrEndFrame", tracy::Color::Red4);
 
-            result = xrEndFrame(session, &fei);
+            XrResult result = xrEndFrame(session, &fei);
             if (!CheckResult(instance, result, "xrEndFrame"))
             {
                 return false;
@@ -1615,8 +1672,158 @@ bool XrBuddy::RenderFrame()
     return true;
 }
 
+bool XrBuddy::WaitFrame(XrFrameState& frameState)
+{
+    ZoneScopedNC("xrWaitFrame", tracy::Color::Red4);
+
+    XrResult result;
+    if (pipelined)
+    {
+        std::unique_lock<std::mutex> lock(frameWaitMutex);
+        if (!frameWaitThread.joinable())
+        {
+            // the first frame has nothing to overlap with
+            frameWaitRequested = true;
+            frameWaitInFlight = true;
+            frameWaitDone = false;
+            frameWaitQuit = false;
+            frameWaitThread = std::thread(&XrBuddy::FrameWaitMain, this);
+        }
+        else if (!frameWaitInFlight)
+        {
+            // the previous frame did not request one, i.e. its xrBeginFrame() or this wait failed.
+            frameWaitRequested = true;
+            frameWaitInFlight = true;
+            frameWaitCv.notify_all();
+        }
+        frameWaitCv.wait(lock, [this]() { return frameWaitDone; });
+        frameWaitDone = false;
+        frameWaitInFlight = false;
+        frameState = frameWaitState;
+        result = frameWaitResult;
+    }
+    else
+    {
+        result = BlockingWaitFrame(frameState);
+    }
+
+    return CheckResult(instance, result, "xrWaitFrame");
+}
+
+XrResult XrBuddy::BlockingWaitFrame(XrFrameState& frameState)
+{
+    frameState.type = XR_TYPE_FRAME_STATE;
+    frameState.next = NULL;
+
+    XrFrameWaitInfo fwi = {};
+    fwi.type = XR_TYPE_FRAME_WAIT_INFO;
+    fwi.next = NULL;
+    return xrWaitFrame(session, &fwi, &frameState);
+}
+
+void XrBuddy::RequestFrameWait()
+{
+    std::unique_lock<std::mutex> lock(frameWaitMutex);
+    if (!frameWaitInFlight && frameWaitThread.joinable())
+    {
+        frameWaitRequested = true;
+        frameWaitInFlight = true;
+        frameWaitCv.notify_all();
+    }
+}
+
+// calls BlockingWaitFrame() once per request, the result is picked up by the next WaitFrame().
+void XrBuddy::FrameWaitMain()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(frameWaitMutex);
+            frameWaitCv.wait(lock, [this]() { return frameWaitRequested || frameWaitQuit; });
+            if (frameWaitQuit)
+            {
+                return;
+            }
+            frameWaitRequested = false;
+        }
+
+        XrFrameState fs = {};
+        XrResult result = BlockingWaitFrame(fs);
+
+        {
+            std::unique_lock<std::mutex> lock(frameWaitMutex);
+            frameWaitState = fs;
+            frameWaitResult = result;
+            frameWaitDone = true;
+            frameWaitCv.notify_all();
+        }
+    }
+}
+
+void XrBuddy::StopFrameWaitThread()
+{
+    if (frameWaitThread.joinable())
+    {
+        {
+            std::unique_lock<std::mutex> lock(frameWaitMutex);
+            frameWaitQuit = true;
+            frameWaitCv.notify_all();
+        }
+
+        // a wait in flight returns within a display period
+        frameWaitThread.join();
+        frameWaitRequested = false;
+        frameWaitInFlight = false;
+        frameWaitDone = false;
+    }
+}
+
+void XrBuddy::WaitFrameFence()
+{
+    GLsync& fence = frameFences[frameFenceIndex];
+    if (fence)
+    {
+        ZoneScopedNC("frame fence", tracy::Color::Red4);
+        const GLuint64 FENCE_TIMEOUT_NS = 100000000;  // 100 ms
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            // a very slow frame, still wait for it, otherwise the frames in flight pile up.
+            Log::W("XrBuddy: frame fence timed out, the gpu is more than %d ms behind\n", (int)(FENCE_TIMEOUT_NS / 1000000));
+            glFinish();
+        }
+        else if (result == GL_WAIT_FAILED)
+        {
+            Log::E("XrBuddy: frame fence wait failed\n");
+            glFinish();
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+}
+
+void XrBuddy::SignalFrameFence()
+{
+    // flushed now so the gpu starts on this frame while the cpu moves on to the next.
+    GLsync& fence = frameFences[frameFenceIndex];
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    frameFenceIndex = (frameFenceIndex + 1) % (uint32_t)frameFences.size();
+}
+
 bool XrBuddy::Shutdown()
 {
+    StopFrameWaitThread();
+
+    for (auto& fence : frameFences)
+    {
+        if (fence)
+        {
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+
     for (auto& swapchain : swapchains)
     {
         xrDestroySwapchain(swapchain.handle);
@@ -1636,6 +1843,16 @@ bool XrBuddy::Shutdown()
         frameBuffer = 0;
     }
 
+    if (stereoFrameBuffer)
+    {
+        glDeleteFramebuffers(1, &stereoFrameBuffer);
+        glDeleteTextures(1, &stereoColorTexture);
+        glDeleteTextures(1, &stereoDepthTexture);
+        stereoFrameBuffer = 0;
+        stereoColorTexture = 0;
+        stereoDepthTexture = 0;
+    }
+
     if (stageSpace != XR_NULL_HANDLE)
     {
         xrDestroySpace(stageSpace);
@@ -1686,6 +1903,22 @@ bool XrBuddy::Shutdown()
     return true;
 }
 
+static void ComputeViewMats(const XrCompositionLayerProjectionView& layerView, const glm::vec2& nearFar,
+                            glm::mat4& projMat, glm::mat4& eyeMat)
+{
+    const float tanLeft = tanf(layerView.fov.angleLeft);
+    const float tanRight = tanf(layerView.fov.angleRight);
+    const float tanDown = tanf(layerView.fov.angleDown);
+    const float tanUp = tanf(layerView.fov.angleUp);
+
+    CreateProjection(glm::value_ptr(projMat), GRAPHICS_OPENGL, tanLeft, tanRight, tanUp, tanDown, nearFar.x, nearFar.y);
+
+    const auto& pose = layerView.pose;
+    glm::quat eyeRot(pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z);
+    glm::vec3 eyePos(pose.position.x, pose.position.y, pose.position.z);
+    eyeMat = MakeMat4(eyeRot, eyePos);
+}
+
 bool XrBuddy::RenderLayer(XrTime predictedDisplayTime,
                           std::vector<XrCompositionLayerProjectionView>& projectionLayerViews,
                           XrCompositionLayerProjection& layer)
@@ -1726,8 +1959,10 @@ bool XrBuddy::RenderLayer(XrTime predictedDisplayTime,
         assert(viewCountOutput == swapchains.size());
 
         projectionLayerViews.resize(viewCountOutput);
+        std::vector<uint32_t> colorTextures(viewCountOutput);
+        std::vector<uint32_t> depthTextures(viewCountOutput);
 
-        // Render view to the appropriate part of the swapchain image.
+        // Acquire the swapchain image of each view.
         for (uint32_t i = 0; i < viewCountOutput; i++)
         {
             // Each view has a separate swapchain which is acquired, rendered to, and released.
@@ -1779,8 +2014,15 @@ bool XrBuddy::RenderLayer(XrTime predictedDisplayTime,
                 iter = colorToDepthMap.insert(std::make_pair(colorTexture, depthTexture)).first;
             }
 
-            RenderView(projectionLayerViews[i], frameBuffer, iter->first, iter->second, i);
+            colorTextures[i] = iter->first;
+            depthTextures[i] = iter->second;
+        }
+
+        DrawViews(projectionLayerViews, colorTextures, depthTextures);
 
+        for (uint32_t i = 0; i < viewCountOutput; i++)
+        {
+            const SwapchainInfo& viewSwapchain = swapchains[i];
             XrSwapchainImageReleaseInfo ri = {};
             ri.type = XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO;
             ri.next = NULL;
@@ -1799,6 +2041,63 @@ bool XrBuddy::RenderLayer(XrTime predictedDisplayTime,
     return true;
 }
 
+void XrBuddy::DrawViews(const std::vector<XrCompositionLayerProjectionView>& layerViews,
+                        const std::vector<uint32_t>& colorTextures, const std::vector<uint32_t>& depthTextures,
+                        GpuTimer* gpuTimer)
+{
+    const uint32_t numViews = (uint32_t)layerViews.size();
+    if (preRenderCallback)
+    {
+        if (gpuTimer)
+        {
+            gpuTimer->Begin("prerender");
+        }
+        std::vector<glm::mat4> projMats(numViews);
+        std::vector<glm::mat4> eyeMats(numViews);
+        for (uint32_t i = 0; i < numViews; i++)
+        {
+            ComputeViewMats(layerViews[i], nearFar, projMats[i], eyeMats[i]);
+        }
+        const XrRect2Di& rect = layerViews[0].subImage.imageRect;
+        glm::vec4 viewport(rect.offset.x, rect.offset.y, rect.extent.width, rect.extent.height);
+        preRenderCallback(projMats.data(), eyeMats.data(), numViews, viewport, nearFar);
+        if (gpuTimer)
+        {
+            gpuTimer->End();
+        }
+    }
+
+    // Render both views in a single pass if possible, otherwise render each view to the appropriate part of its swapchain image.
+    bool renderedStereo = false;
+    if (stereoRenderCallback && numViews == 2)
+    {
+        if (gpuTimer)
+        {
+            gpuTimer->Begin("stereo");
+        }
+        renderedStereo = RenderStereoViews(layerViews, colorTextures);
+        if (gpuTimer)
+        {
+            gpuTimer->End();
+        }
+    }
+    if (!renderedStereo)
+    {
+        for (uint32_t i = 0; i < numViews; i++)
+        {
+            if (gpuTimer)
+            {
+                gpuTimer->Begin(i == 0 ? "left" : (i == 1 ? "right" : "view"));
+            }
+            RenderView(layerViews[i], frameBuffer, colorTextures[i], depthTextures[i], i);
+            if (gpuTimer)
+            {
+                gpuTimer->End();
+            }
+        }
+    }
+}
+
 void XrBuddy::RenderView(const XrCompositionLayerProjectionView& layerView, uint32_t frameBuffer,
                          uint32_t colorTexture, uint32_t depthTexture, int32_t viewNum)
 {
@@ -1812,21 +2111,102 @@ void XrBuddy::RenderView(const XrCompositionLayerProjectionView& layerView, uint
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
 
-    const float tanLeft = tanf(layerView.fov.angleLeft);
-    const float tanRight = tanf(layerView.fov.angleRight);
-    const float tanDown = tanf(layerView.fov.angleDown);
-    const float tanUp = tanf(layerView.fov.angleUp);
-
     glm::mat4 projMat;
-    CreateProjection(glm::value_ptr(projMat), GRAPHICS_OPENGL, tanLeft, tanRight, tanUp, tanDown, nearFar.x, nearFar.y);
-
-    const auto& pose = layerView.pose;
-    glm::quat eyeRot(pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z);
-    glm::vec3 eyePos(pose.position.x, pose.position.y, pose.position.z);
-    glm::mat4 eyeMat = MakeMat4(eyeRot, eyePos);
+    glm::mat4 eyeMat;
+    ComputeViewMats(layerView, nearFar, projMat, eyeMat);
     glm::vec4 viewport(layerView.subImage.imageRect.offset.x, layerView.subImage.imageRect.offset.y,
                        layerView.subImage.imageRect.extent.width, layerView.subImage.imageRect.extent.height);
     renderCallback(projMat, eyeMat, viewport, nearFar, viewNum);
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
+
+// Renders both views into the layers of stereoColorTexture with the stereoRenderCallback,
+// then copies each layer into the swapchain image of its view. returns false if nothing was rendered.
+bool XrBuddy::RenderStereoViews(const std::vector<XrCompositionLayerProjectionView>& layerViews,
+                                const std::vector<uint32_t>& colorTextures)
+{
+    ZoneScoped;
+
+    // both views share one viewport and one array texture.
+    const XrRect2Di& rect0 = layerViews[0].subImage.imageRect;
+    const XrRect2Di& rect1 = layerViews[1].subImage.imageRect;
+    if (rect0.extent.width != rect1.extent.width || rect0.extent.height != rect1.extent.height ||
+        swapchains[0].format != swapchains[1].format)
+    {
+        return false;
+    }
+
+    glm::ivec2 size(rect0.extent.width, rect0.extent.height);
+    if (!stereoFrameBuffer || stereoSize != size)
+    {
+        if (stereoFrameBuffer)
+        {
+            glDeleteFramebuffers(1, &stereoFrameBuffer);
+            glDeleteTextures(1, &stereoColorTexture);
+            glDeleteTextures(1, &stereoDepthTexture);
+        }
+
+        // same format as the swapchain images, so the layers can be copied into them.
+        glGenTextures(1, &stereoColorTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, stereoColorTexture);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, (GLenum)swapchains[0].format, size.x, size.y, 2);
+        glGenTextures(1, &stereoDepthTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, stereoDepthTexture);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, size.x, size.y, 2);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenFramebuffers(1, &stereoFrameBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, stereoFrameBuffer);
+        if (stereoMultiview)
+        {
+#ifdef __ANDROID__
+            static PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC glFramebufferTextureMultiviewOVR =
+                (PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC)eglGetProcAddress("glFramebufferTextureMultiviewOVR");
+#endif
+            glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, stereoColorTexture, 0, 0, 2);
+            glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, stereoDepthTexture, 0, 0, 2);
+        }
+        else
+        {
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, stereoColorTexture, 0);
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, stereoDepthTexture, 0);
+        }
+
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            Log::W("Single pass stereo framebuffer is incomplete, status = 0x%x, rendering each view separately\n", status);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            stereoRenderCallback = nullptr;
+            return false;
+        }
+        stereoSize = size;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, stereoFrameBuffer);
+    glViewport(0, 0, size.x, size.y);
+
+    glm::mat4 projMats[2];
+    glm::mat4 eyeMats[2];
+    for (int i = 0; i < 2; i++)
+    {
+        ComputeViewMats(layerViews[i], nearFar, projMats[i], eyeMats[i]);
+    }
+    glm::vec4 viewport(0.0f, 0.0f, (float)size.x, (float)size.y);
+    bool rendered = stereoRenderCallback(projMats, eyeMats, viewport, nearFar);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (rendered)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            const XrRect2Di& rect = layerViews[i].subImage.imageRect;
+            glCopyImageSubData(stereoColorTexture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i,
+                               colorTextures[i], GL_TEXTURE_2D, 0, rect.offset.x, rect.offset.y, 0,
+                               size.x, size.y, 1);
+        }
+    }
+    return rendered;
+}
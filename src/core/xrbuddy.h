@@ -6,9 +6,12 @@
 #pragma once
 
 #include <array>
+#include <condition_variable>
 #include <functional>
 #include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #if defined(WIN32)
@@ -48,27 +51,55 @@
 
 #include "maincontext.h"
 
+class GpuTimer;
+
 class XrBuddy
 {
 public:
     XrBuddy(MainContext& mainContextIn, const glm::vec2& nearFarIn);
+    virtual ~XrBuddy();
 
-    bool Init();
-    bool PollEvents();
-    bool SyncInput();
+    virtual bool Init();
+    virtual bool PollEvents();
+    virtual bool SyncInput();
 
     using RenderCallback = std::function<void(const glm::mat4& projMat, const glm::mat4& eyeMat, const glm::vec4& viewport, const glm::vec2& nearFar, int32_t viewNum)>;
     void SetRenderCallback(RenderCallback renderCallbackIn)
     {
         renderCallback = renderCallbackIn;
     }
-    bool SessionReady() const;
-    bool RenderFrame();
-    bool Shutdown();
+
+    // optional, draws both views in a single pass into a 2 layer array texture, which is then copied into each views swapchain image.
+    // projMats and eyeMats have one element per view. returning false falls back to the RenderCallback for each view.
+    // when multiview is true the layers are attached with glFramebufferTextureMultiviewOVR(), otherwise with glFramebufferTexture().
+    using StereoRenderCallback = std::function<bool(const glm::mat4* projMats, const glm::mat4* eyeMats, const glm::vec4& viewport, const glm::vec2& nearFar)>;
+    void SetStereoRenderCallback(StereoRenderCallback stereoRenderCallbackIn, bool multiviewIn)
+    {
+        stereoRenderCallback = stereoRenderCallbackIn;
+        stereoMultiview = multiviewIn;
+    }
+
+    // optional, called once per frame before any view is rendered, with the matrices of every view.
+    // i.e. to do work that is shared by all the views, such as a sort. viewport is the same as for the first view.
+    using PreRenderCallback = std::function<void(const glm::mat4* projMats, const glm::mat4* eyeMats, uint32_t numViews, const glm::vec4& viewport, const glm::vec2& nearFar)>;
+    void SetPreRenderCallback(PreRenderCallback preRenderCallbackIn)
+    {
+        preRenderCallback = preRenderCallbackIn;
+    }
+    // when pipelined, xrWaitFrame() for the next frame runs on its own thread as soon as the current frame has begun,
+    // so it overlaps the rendering of the current frame, and whatever the app does between RenderFrame() calls.
+    // each frame also ends with a fence, and at most two frames of gpu work are in flight.
+    void SetPipelined(bool pipelinedIn) { pipelined = pipelinedIn; }
+    bool GetPipelined() const { return pipelined; }
+
+    virtual bool SessionReady() const;
+    virtual bool RenderFrame();
+    virtual bool Shutdown();
 
     struct SwapchainInfo
     {
         XrSwapchain handle;
+        int64_t format;
         int32_t width;
         int32_t height;
     };
@@ -107,7 +138,10 @@ public:
 
     uint32_t GetColorTexture() const;
 
-    void CycleColorSpace();
+    // seconds between displayed frames, as predicted by the last xrWaitFrame(), zero before the first frame.
+    float GetPredictedDisplayPeriod() const { return (float)lastPredictedDisplayPeriod * 1.0e-9f; }
+
+    virtual void CycleColorSpace();
 
 #if defined(XR_USE_GRAPHICS_API_OPENGL)
     using SwapchainImage = XrSwapchainImageOpenGLKHR;
@@ -116,12 +150,32 @@ public:
 #endif
 
 protected:
+    // for a subclass that does not use an openxr runtime, i.e. SimXrBuddy.
+    XrBuddy(MainContext& mainContextIn, const glm::vec2& nearFarIn, bool useRuntime);
+
     bool LocateSpaces(XrTime predictedDisplayTime);
     bool RenderLayer(XrTime predictedDisplayTime,
                      std::vector<XrCompositionLayerProjectionView>& projectionLayerViews,
                      XrCompositionLayerProjection& layer);
+    // calls the preRenderCallback, then renders every view into its color and depth texture.
+    // if gpuTimer is not null, each step is timed in its own section.
+    void DrawViews(const std::vector<XrCompositionLayerProjectionView>& layerViews,
+                   const std::vector<uint32_t>& colorTextures, const std::vector<uint32_t>& depthTextures,
+                   GpuTimer* gpuTimer = nullptr);
     void RenderView(const XrCompositionLayerProjectionView& layerView, uint32_t frameBuffer,
                     uint32_t colorTexture, uint32_t depthTexture, int32_t viewNum);
+    bool RenderStereoViews(const std::vector<XrCompositionLayerProjectionView>& layerViews,
+                           const std::vector<uint32_t>& colorTextures);
+    bool WaitFrame(XrFrameState& frameState);
+    // blocks until the next frame can start, i.e. xrWaitFrame(). when pipelined it runs on the frame wait thread.
+    virtual XrResult BlockingWaitFrame(XrFrameState& frameState);
+    // starts the wait for the next frame, once the current one has begun.
+    void RequestFrameWait();
+    void FrameWaitMain();
+    void StopFrameWaitThread();
+    // waits on the fence of the frame before last, then fences the current frame, so at most two frames of gpu work are in flight.
+    void WaitFrameFence();
+    void SignalFrameFence();
 
     bool constructorSucceded = false;
     MainContext& mainContext;
@@ -149,10 +203,35 @@ protected:
     uint32_t frameBuffer = 0;
     std::map<uint32_t, uint32_t> colorToDepthMap;
     XrTime lastPredictedDisplayTime = 0;
+    XrDuration lastPredictedDisplayPeriod = 0;
     uint32_t prevLastColorTexture = 0;
     uint32_t lastColorTexture = 0;
     bool sessionReady = false;
 
     RenderCallback renderCallback;
+    PreRenderCallback preRenderCallback;
     glm::vec2 nearFar;
+
+    // single pass stereo target, created on first use
+    StereoRenderCallback stereoRenderCallback;
+    bool stereoMultiview = false;
+    uint32_t stereoFrameBuffer = 0;
+    uint32_t stereoColorTexture = 0;
+    uint32_t stereoDepthTexture = 0;
+    glm::ivec2 stereoSize = {0, 0};
+
+    // pipelined frame loop, see SetPipelined()
+    bool pipelined = false;
+    std::thread frameWaitThread;
+    std::mutex frameWaitMutex;
+    std::condition_variable frameWaitCv;
+    bool frameWaitRequested = false;
+    bool frameWaitInFlight = false;  // requested, and not yet picked up by WaitFrame()
+    bool frameWaitDone = false;
+    bool frameWaitQuit = false;
+    XrFrameState frameWaitState = {};
+    XrResult frameWaitResult = XR_SUCCESS;
+    std::array<GLsync, 2> frameFences = {};
+    uint32_t frameFenceIndex = 0;
 };
+
@@ -23,13 +23,12 @@
 #define ZoneScopedNC(NAME, COLOR)
 #endif
 
+#include "core/gpusorter.h"
 #include "core/image.h"
 #include "core/log.h"
 #include "core/texture.h"
 #include "core/util.h"
 
-#include "radix_sort.hpp"
-
 static void SetupAttrib(int loc, const BinaryAttribute& attrib, int32_t numElems, size_t stride)
 {
     assert(attrib.type == BinaryAttribute::Type::Float);
@@ -45,11 +44,13 @@ PointRenderer::~PointRenderer()
 {
 }
 
-bool PointRenderer::Init(std::shared_ptr<PointCloud> pointCloud, bool isFramebufferSRGBEnabledIn)
+bool PointRenderer::Init(std::shared_ptr<PointCloud> pointCloud, bool isFramebufferSRGBEnabledIn,
+                         std::shared_ptr<GpuSorter> gpuSorterIn)
 {
     GL_ERROR_CHECK("PointRenderer::Init() begin");
 
     isFramebufferSRGBEnabled = isFramebufferSRGBEnabledIn;
+    gpuSorter = gpuSorterIn;
 
     Image pointImg;
     if (!pointImg.Load("texture/sphere.png"))
@@ -69,32 +70,23 @@ bool PointRenderer::Init(std::shared_ptr<PointCloud> pointCloud, bool isFramebuf
         return false;
     }
 
-    preSortProg = std::make_shared<Program>();
-    if (!preSortProg->LoadCompute("shader/presort_compute.glsl"))
-    {
-        Log::E("Error loading point pre-sort compute shader!\n");
-        return false;
-    }
-
     const size_t numPoints = pointCloud->GetNumPoints();
 
     // build posVec
     posVec.reserve(numPoints);
     pointCloud->ForEachPosition([this](const float* pos)
     {
-        posVec.emplace_back(glm::vec4(pos[0], pos[1], pos[2], pos[3]));
+        // w is the radius used for culling by the sort, points are culled by their center.
+        posVec.emplace_back(glm::vec4(pos[0], pos[1], pos[2], 0.0f));
     });
 
     BuildVertexArrayObject(pointCloud);
 
-    depthVec.resize(numPoints);
-    keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
-    valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
+    assert(numPoints <= gpuSorter->GetMaxNumElements());
     posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, posVec);
-    sorter = std::make_shared<rgc::radix_sort::sorter>(numPoints);
 
-    atomicCounterVec.resize(1, 0);
-    atomicCounterBuffer = std::make_shared<BufferObject>(GL_ATOMIC_COUNTER_BUFFER, atomicCounterVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+    // draw directly from the output of the sort.
+    pointVao->SetElementBuffer(gpuSorter->GetSortedValBuffer());
 
     GL_ERROR_CHECK("PointRenderer::Init() end");
 
@@ -108,66 +100,9 @@ void PointRenderer::Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
 
     GL_ERROR_CHECK("PointRenderer::Render() begin");
 
-    const size_t numPoints = posVec.size();
     glm::mat4 modelViewMat = glm::inverse(cameraMat);
 
-    const uint32_t MAX_DEPTH = std::numeric_limits<uint32_t>::max();
-
-    {
-        ZoneScopedNC("pre-sort", tracy::Color::Red4);
-
-        preSortProg->Bind();
-        preSortProg->SetUniform("modelViewProj", projMat * modelViewMat);
-        preSortProg->SetUniform("nearFar", nearFar);
-        preSortProg->SetUniform("keyMax", MAX_DEPTH);
-
-        glm::mat4 modelViewProjMat = projMat * modelViewMat;
-
-        // reset counter back to 0
-        atomicCounterVec[0] = 0;
-        atomicCounterBuffer->Update(atomicCounterVec);
-
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, posBuffer->GetObj());
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer->GetObj());
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer->GetObj());
-        glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 4, atomicCounterBuffer->GetObj());
-
-        const int LOCAL_SIZE = 256;
-        glDispatchCompute(((GLuint)numPoints + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1); // Assuming LOCAL_SIZE threads per group
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
-
-        GL_ERROR_CHECK("PointRenderer::Render() pre-sort");
-    }
-
-    uint32_t sortCount = 0;
-    {
-        ZoneScopedNC("get-count", tracy::Color::Green);
-
-        atomicCounterBuffer->Read(atomicCounterVec);
-        sortCount = atomicCounterVec[0];
-
-        assert(sortCount <= (uint32_t)numPoints);
-
-        GL_ERROR_CHECK("PointRenderer::Render() get-count");
-    }
-
-    {
-        ZoneScopedNC("sort", tracy::Color::Red4);
-
-        sorter->sort(keyBuffer->GetObj(), valBuffer->GetObj(), sortCount);
-
-        GL_ERROR_CHECK("PointRenderer::Render() sort");
-    }
-
-    {
-        ZoneScopedNC("copy-sorted", tracy::Color::DarkGreen);
-
-        glBindBuffer(GL_COPY_READ_BUFFER, valBuffer->GetObj());
-        glBindBuffer(GL_COPY_WRITE_BUFFER, pointVao->GetElementBuffer()->GetObj());
-        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sortCount * sizeof(uint32_t));
-
-        GL_ERROR_CHECK("PointRenderer::Render() copy-sorted");
-    }
+    uint32_t sortCount = gpuSorter->Sort(posVec, posBuffer, projMat * modelViewMat, nearFar);
 
     {
         ZoneScopedNC("draw", tracy::Color::Red4);
@@ -199,27 +134,15 @@ void PointRenderer::BuildVertexArrayObject(std::shared_ptr<PointCloud> pointClou
 {
     pointVao = std::make_shared<VertexArrayObject>();
 
-    const size_t numPoints = pointCloud->GetNumPoints();
-
     // allocate large buffer to hold interleaved vertex data
     pointDataBuffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER, pointCloud->GetRawDataPtr(),
                                                      pointCloud->GetTotalSize(), 0);
 
-    // build element array
-    indexVec.reserve(numPoints);
-    assert(numPoints <= std::numeric_limits<uint32_t>::max());
-    for (uint32_t i = 0; i < (uint32_t)numPoints; i++)
-    {
-        indexVec.push_back(i);
-    }
-    auto indexBuffer = std::make_shared<BufferObject>(GL_ELEMENT_ARRAY_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
-
     pointVao->Bind();
     pointDataBuffer->Bind();
 
     SetupAttrib(pointProg->GetAttribLoc("position"), pointCloud->GetPositionAttrib(), 4, pointCloud->GetStride());
     SetupAttrib(pointProg->GetAttribLoc("color"), pointCloud->GetColorAttrib(), 4, pointCloud->GetStride());
 
-    pointVao->SetElementBuffer(indexBuffer);
     pointDataBuffer->Unbind();
 }
@@ -16,10 +16,7 @@
 
 #include "pointcloud.h"
 
-namespace rgc::radix_sort
-{
-    struct sorter;
-}
+class GpuSorter;
 
 class PointRenderer
 {
@@ -27,7 +24,8 @@ public:
     PointRenderer();
     ~PointRenderer();
 
-    bool Init(std::shared_ptr<PointCloud> pointCloud, bool isFramebufferSRGBEnabledIn);
+    bool Init(std::shared_ptr<PointCloud> pointCloud, bool isFramebufferSRGBEnabledIn,
+              std::shared_ptr<GpuSorter> gpuSorterIn);
 
     // viewport = (x, y, width, height)
     void Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
@@ -37,21 +35,14 @@ protected:
 
     std::shared_ptr<Texture> pointTex;
     std::shared_ptr<Program> pointProg;
-    std::shared_ptr<Program> preSortProg;
     std::shared_ptr<VertexArrayObject> pointVao;
 
     std::shared_ptr<BufferObject> pointDataBuffer;
 
-    std::vector<uint32_t> indexVec;
-    std::vector<uint32_t> depthVec;
     std::vector<glm::vec4> posVec;
-    std::vector<uint32_t> atomicCounterVec;
 
-    std::shared_ptr<BufferObject> keyBuffer;
-    std::shared_ptr<BufferObject> valBuffer;
     std::shared_ptr<BufferObject> posBuffer;
-    std::shared_ptr<BufferObject> atomicCounterBuffer;
 
-    std::shared_ptr<rgc::radix_sort::sorter> sorter;
+    std::shared_ptr<GpuSorter> gpuSorter;
     bool isFramebufferSRGBEnabled;
 };
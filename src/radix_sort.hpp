@@ -251,12 +251,13 @@ namespace rgc::radix_sort
 		program m_local_offsets_program;
 		program m_reorder_program;
 
-		size_t m_internal_arr_len;
+		size_t m_internal_arr_len = 0;
 
-		GLuint m_local_offsets_buf;
-		GLuint m_keys_scratch_buf;
-		GLuint m_values_scratch_buf;
-		GLuint m_glob_counts_buf;
+		// must start at zero, resize_internal_buf() deletes any non-zero names.
+		GLuint m_local_offsets_buf = 0;
+		GLuint m_keys_scratch_buf = 0;
+		GLuint m_values_scratch_buf = 0;
+		GLuint m_glob_counts_buf = 0;
 
 		GLuint calc_thread_blocks_num(size_t arr_len)
 		{
@@ -335,6 +336,7 @@ namespace rgc::radix_sort
 			if (m_local_offsets_buf != 0) glDeleteBuffers(1, &m_local_offsets_buf);
 			if (m_glob_counts_buf != 0) glDeleteBuffers(1, &m_glob_counts_buf);
 			if (m_keys_scratch_buf != 0) glDeleteBuffers(1, &m_keys_scratch_buf);
+			if (m_values_scratch_buf != 0) glDeleteBuffers(1, &m_values_scratch_buf);
 		}
 
 		void sort(GLuint key_buf, GLuint val_buf, size_t arr_len)
@@ -24,6 +24,7 @@
 #include "core/util.h"
 
 #include "app.h"
+#include "sortbench.h"
 
 //#define SOFTWARE_SPLATS
 
@@ -79,7 +80,12 @@ int main(int argc, char *argv[])
     SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
 
     uint32_t windowFlags = SDL_WINDOW_OPENGL;
-    if (app.IsFullscreen())
+    if (app.IsSortBench())
+    {
+        // only a gl context is needed
+        windowFlags |= SDL_WINDOW_HIDDEN;
+    }
+    else if (app.IsFullscreen())
     {
         windowFlags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
     }
@@ -123,6 +129,17 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if (app.IsSortBench())
+    {
+        SortBench sortBench;
+        bool passed = sortBench.Run();
+
+        SDL_GL_DeleteContext(ctx.gl_context);
+        SDL_DestroyWindow(ctx.window);
+        SDL_Quit();
+        return passed ? 0 : 1;
+    }
+
     // AJT: TODO REMOVE disable vsync for benchmarks
     SDL_GL_SetSwapInterval(0);
 
@@ -187,7 +204,10 @@ int main(int argc, char *argv[])
             return 1;
         }
 
-        SDL_GL_SwapWindow(ctx.window);
+        if (app.ShouldPresent())
+        {
+            SDL_GL_SwapWindow(ctx.window);
+        }
 
         frameCount++;
 
@@ -0,0 +1,257 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#include "sortbench.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdio.h>
+#include <string>
+
+#include "core/gputimer.h"
+#include "core/log.h"
+#include "core/util.h"
+#include "core/vertexbuffer.h"
+
+enum class Distribution
+{
+    Uniform,
+    Clustered,
+    NearlySorted,
+    Duplicates,
+    NumDistributions
+};
+
+static const char* DistributionName(Distribution dist)
+{
+    switch (dist)
+    {
+    case Distribution::Uniform: return "uniform";
+    case Distribution::Clustered: return "clustered";
+    case Distribution::NearlySorted: return "nearly-sorted";
+    case Distribution::Duplicates: return "duplicates";
+    default: return "?";
+    }
+}
+
+static const char* BackendName(GpuSorter::Backend backend)
+{
+    switch (backend)
+    {
+    case GpuSorter::Backend::RgcRadixSort: return "rgc_radix_sort";
+    case GpuSorter::Backend::MultiRadixSort: return "multi_radixsort";
+    case GpuSorter::Backend::PortableMultiRadixSort: return "multi_radixsort_portable";
+    case GpuSorter::Backend::CpuRadixSort: return "cpu_radix_sort";
+    default: return "auto";
+    }
+}
+
+static void GenerateKeys(Distribution dist, uint32_t count, std::vector<uint32_t>& keyVec)
+{
+    // same seed every run, so results are comparable between backends and runs.
+    std::mt19937 rng(count + (uint32_t)dist);
+    keyVec.resize(count);
+
+    switch (dist)
+    {
+    case Distribution::Uniform:
+        for (auto&& key : keyVec)
+        {
+            key = rng();
+        }
+        break;
+    case Distribution::Clustered:
+    {
+        // a few dense clumps, like the depths of splats in a scene with a handful of objects.
+        const uint32_t NUM_CLUSTERS = 8;
+        std::vector<double> centerVec(NUM_CLUSTERS);
+        for (auto&& center : centerVec)
+        {
+            center = (double)rng();
+        }
+        std::normal_distribution<double> offset(0.0, 65536.0);
+        for (auto&& key : keyVec)
+        {
+            double k = centerVec[rng() % NUM_CLUSTERS] + offset(rng);
+            key = (uint32_t)std::clamp(k, 0.0, 4294967295.0);
+        }
+        break;
+    }
+    case Distribution::NearlySorted:
+    {
+        // like the previous frames order, after a small camera motion.
+        for (uint32_t i = 0; i < count; i++)
+        {
+            keyVec[i] = (uint32_t)(((uint64_t)i << 32) / count);
+        }
+        const uint32_t numSwaps = count / 100;
+        for (uint32_t i = 0; i < numSwaps; i++)
+        {
+            std::swap(keyVec[rng() % count], keyVec[rng() % count]);
+        }
+        break;
+    }
+    case Distribution::Duplicates:
+        for (auto&& key : keyVec)
+        {
+            key = rng() % 16;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+SortBench::SortBench() :
+    backendVec({GpuSorter::Backend::MultiRadixSort, GpuSorter::Backend::PortableMultiRadixSort,
+                GpuSorter::Backend::RgcRadixSort, GpuSorter::Backend::CpuRadixSort}),
+    sizeVec({10000, 100000, 1000000, 4000000, 16000000}),
+    numIterations(3)
+{
+}
+
+bool SortBench::Run()
+{
+    const uint32_t maxSize = *std::max_element(sizeVec.begin(), sizeVec.end());
+
+    printf("GL_VENDOR = %s\n", glGetString(GL_VENDOR));
+    printf("GL_RENDERER = %s\n", glGetString(GL_RENDERER));
+    printf("GL_VERSION = %s\n", glGetString(GL_VERSION));
+    if (!GpuTimer::IsSupported())
+    {
+        printf("timer queries not supported, gpu pass times will be zero\n");
+    }
+
+    std::shared_ptr<GpuTimer> timer = std::make_shared<GpuTimer>();
+
+    std::vector<uint32_t> zeroVec(maxSize, 0);
+    auto readbackBuffer = std::make_shared<BufferObject>(GL_COPY_WRITE_BUFFER, zeroVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+    zeroVec.clear();
+
+    std::vector<uint32_t> keyVec;
+    std::vector<uint32_t> valVec;
+    std::vector<uint32_t> expectedVec;
+    std::vector<uint32_t> resultVec(maxSize);
+
+    bool allPassed = true;
+    for (auto backend : backendVec)
+    {
+        printf("\n%s\n", BackendName(backend));
+
+        // so an error left behind by the previous backend is not blamed on this one.
+        GLenum prevError = glGetError();
+        if (prevError != GL_NO_ERROR)
+        {
+            printf("    gl error 0x%x before init\n", prevError);
+            while (glGetError() != GL_NO_ERROR) {}
+        }
+        if (!GpuSorter::IsBackendSupported(backend))
+        {
+            printf("    not supported, skipping\n");
+            continue;
+        }
+
+        auto sorter = std::make_shared<GpuSorter>();
+        if (!sorter->Init(maxSize, backend))
+        {
+            printf("    init failed\n");
+            allPassed = false;
+            continue;
+        }
+        sorter->SetTimer(timer);
+
+        printf("    %10s  %-14s  %-6s  %9s  %9s  %s\n", "size", "distribution", "result", "wall ms", "Mkeys/s", "gpu ms per pass");
+        for (auto size : sizeVec)
+        {
+            for (uint32_t d = 0; d < (uint32_t)Distribution::NumDistributions; d++)
+            {
+                Distribution dist = (Distribution)d;
+                GenerateKeys(dist, size, keyVec);
+
+                expectedVec.resize(size);
+                std::iota(expectedVec.begin(), expectedVec.end(), 0);
+                std::stable_sort(expectedVec.begin(), expectedVec.end(), [&keyVec](uint32_t a, uint32_t b)
+                {
+                    return keyVec[a] < keyVec[b];
+                });
+
+                valVec.resize(size);
+                std::iota(valVec.begin(), valVec.end(), 0);
+
+                double totalWallMs = 0.0;
+                std::map<std::string, double> passMsMap;
+                std::vector<std::string> passNameVec;
+                bool passed = true;
+                for (uint32_t iter = 0; iter < numIterations; iter++)
+                {
+                    sorter->GetKeyBuffer()->Update(keyVec);
+                    sorter->GetValBuffer()->Update(valVec);
+                    glFinish();
+
+                    timer->Reset();
+                    auto start = std::chrono::high_resolution_clock::now();
+                    sorter->SortKeys(size);
+                    glFinish();
+                    auto end = std::chrono::high_resolution_clock::now();
+                    totalWallMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+                    for (auto&& section : timer->Resolve())
+                    {
+                        if (passMsMap.find(section.name) == passMsMap.end())
+                        {
+                            passNameVec.push_back(section.name);
+                        }
+                        passMsMap[section.name] += section.ms;
+                    }
+
+                    // only the first iteration needs to be checked, the inputs are identical.
+                    if (iter == 0)
+                    {
+                        // a readback that fails must not pass with the result of an earlier sort.
+                        std::fill(resultVec.begin(), resultVec.end(), 0xffffffff);
+                        glBindBuffer(GL_COPY_READ_BUFFER, sorter->GetSortedValBuffer()->GetObj());
+                        glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer->GetObj());
+                        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size * sizeof(uint32_t));
+                        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+                        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+                        readbackBuffer->Read(resultVec.data(), size * sizeof(uint32_t));
+                        passed = std::equal(expectedVec.begin(), expectedVec.end(), resultVec.begin());
+                    }
+                }
+                // the bench checks for itself, GL_ERROR_CHECK is compiled out of release builds.
+                GLenum error = glGetError();
+                if (error != GL_NO_ERROR)
+                {
+                    printf("    gl error 0x%x\n", error);
+                    passed = false;
+                }
+
+                double wallMs = totalWallMs / numIterations;
+                double mkeysPerSec = wallMs > 0.0 ? ((double)size / 1000.0) / wallMs : 0.0;
+                std::string passStr;
+                for (auto&& name : passNameVec)
+                {
+                    char temp[64];
+                    snprintf(temp, sizeof(temp), "%s%s %.3f", passStr.empty() ? "" : ", ", name.c_str(), passMsMap[name] / numIterations);
+                    passStr += temp;
+                }
+                printf("    %10u  %-14s  %-6s  %9.3f  %9.1f  %s\n", size, DistributionName(dist), passed ? "ok" : "FAIL",
+                       wallMs, mkeysPerSec, passStr.c_str());
+                fflush(stdout);
+
+                allPassed = allPassed && passed;
+            }
+        }
+    }
+
+    printf("\n%s\n", allPassed ? "all sorts passed" : "SOME SORTS FAILED");
+    return allPassed;
+}
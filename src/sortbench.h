@@ -0,0 +1,27 @@
+/*
+    Copyright (c) 2024 Anthony J. Thibault
+    This software is licensed under the MIT License. See LICENSE for more details.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "core/gpusorter.h"
+
+// Runs every supported GpuSorter backend over a range of sizes and key distributions.
+// Each result is checked against std::stable_sort, and the wall clock and per pass gpu times are printed.
+// Requires a current gl context, but nothing is rendered, so a hidden window on a software gl driver will work.
+class SortBench
+{
+public:
+    SortBench();
+
+    // returns false if any backend produced an incorrect result.
+    bool Run();
+
+    std::vector<GpuSorter::Backend> backendVec;
+    std::vector<uint32_t> sizeVec;
+    uint32_t numIterations;
+};
@@ -14,6 +14,12 @@
 #include <GL/glew.h>
 #endif
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
 #include <glm/gtc/matrix_transform.hpp>
 
 #ifdef TRACY_ENABLE
@@ -23,14 +29,27 @@
 #define ZoneScopedNC(NAME, COLOR)
 #endif
 
+#include "core/framebuffer.h"
+#include "core/gpusorter.h"
+#include "core/gputimer.h"
 #include "core/image.h"
 #include "core/log.h"
 #include "core/texture.h"
 #include "core/util.h"
 
-#include "radix_sort.hpp"
-
-static const uint32_t NUM_BLOCKS_PER_WORKGROUP = 1024;
+static bool HasExtension(const char* name)
+{
+    GLint numExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+    for (GLint i = 0; i < numExtensions; i++)
+    {
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
 
 static void SetupAttrib(int loc, const BinaryAttribute& attrib, int32_t count, size_t stride)
 {
@@ -39,27 +58,269 @@ static void SetupAttrib(int loc, const BinaryAttribute& attrib, int32_t count, s
     glEnableVertexAttribArray(loc);
 }
 
-SplatRenderer::SplatRenderer()
+// one record per visible splat, written by splat_preprocess_compute.glsl and read by the quad, saturate, sort error and tile shaders.
+// this list is the only declaration of the layout, the c++ struct and the glsl struct injected as the SPLAT_RECORD macro are both built from it.
+// the c++ struct must have the same layout as the std430 one, see the static_asserts below.
+#define SPLAT_RECORD_MEMBERS(MEMBER) \
+    MEMBER(glm::vec3, vec3, p)  /* center of the gaussian in ndc */ \
+    MEMBER(uint32_t, uint, index)  /* of the gaussian, the records are compacted so it differs from the record id */ \
+    MEMBER(glm::vec4, vec4, axes)  /* xy = major axis, zw = minor axis of the quad, in pixels */ \
+    MEMBER(glm::vec4, vec4, cov2inv)  /* inverse of the 2D screen space covariance matrix of the gaussian */ \
+    MEMBER(glm::vec4, vec4, color)  /* radiance and alpha of the splat, alpha is zero if it is culled */
+
+struct SplatRecord
+{
+#define SPLAT_RECORD_CPP_MEMBER(CPP_TYPE, GLSL_TYPE, NAME) CPP_TYPE NAME;
+    SPLAT_RECORD_MEMBERS(SPLAT_RECORD_CPP_MEMBER)
+#undef SPLAT_RECORD_CPP_MEMBER
+};
+
+// in std430 a vec3 is 16 byte aligned, and a following scalar is packed into its fourth component.
+static_assert(offsetof(SplatRecord, index) == 12, "SplatRecord::index must follow the vec3 in the same 16 bytes");
+static_assert(offsetof(SplatRecord, axes) % 16 == 0 && offsetof(SplatRecord, cov2inv) % 16 == 0 && offsetof(SplatRecord, color) % 16 == 0,
+              "SplatRecord vec4 members must be 16 byte aligned");
+static_assert(sizeof(SplatRecord) % 16 == 0, "SplatRecord stride must be a multiple of 16 bytes");
+static const size_t SPLAT_RECORD_SIZE = sizeof(SplatRecord);
+
+// value of the SPLAT_RECORD macro
+static std::string BuildSplatRecordStruct()
+{
+    std::string decl = "struct SplatRecord\n{\n";
+#define SPLAT_RECORD_GLSL_MEMBER(CPP_TYPE, GLSL_TYPE, NAME) decl += "    " #GLSL_TYPE " " #NAME ";\n";
+    SPLAT_RECORD_MEMBERS(SPLAT_RECORD_GLSL_MEMBER)
+#undef SPLAT_RECORD_GLSL_MEMBER
+    decl += "};\n";
+    return decl;
+}
+static const uint32_t MAX_DEPTH = std::numeric_limits<uint32_t>::max();
+
+// must match TILE_SIZE in splat_tile_bin_compute.glsl and splat_tile_raster_compute.glsl
+static const uint32_t TILE_SIZE = 16;
+
+// must match NUM_DEPTH_BUCKETS in splat_tile_bin_compute.glsl
+static const uint32_t NUM_TILE_DEPTH_BUCKETS = 240;
+
+// memory budget of the tile sorter, each entry has a key and a value, and the sort backends need a second copy of both.
+// past this many entries the farthest splats are not binned.
+static const size_t MAX_TILE_SORTER_BYTES = 256 * 1024 * 1024;
+static const size_t MAX_TILE_ENTRIES = MAX_TILE_SORTER_BYTES / (4 * sizeof(uint32_t));
+
+// front to back quads are drawn in this many chunks, with the saturated pixels marked between them.
+static const uint32_t FRONT_TO_BACK_CHUNKS = 8;
+
+// pixels with less transmittance then this are considered opaque by splat_saturate_frag.glsl,
+// the same 1/256 threshold splat_frag.glsl uses to discard a fragment.
+static const float MIN_TRANSMITTANCE = 1.0f / 256.0f;
+
+// the occluder pyramid is not used if the camera moved or turned more then this since it was built,
+// splats that were hidden in that frame but are not anymore would be missing for a frame.
+static const float OCCLUSION_MAX_TRANSLATION = 0.05f;
+static const float OCCLUSION_MIN_COS_ANGLE = 0.9994f;  // about 2 degrees
+
+// variance of the low-pass filter added to every splat by splat_preprocess_compute.glsl, in pixels squared.
+static const float FILTER_VARIANCE = 0.3f;
+
+// RenderFoveated() fades the fovea into the periphery over this many pixels at its edge.
+static const float FOVEA_FEATHER_WIDTH = 8.0f;
+
+// must match FALLOFF_SIZE and FALLOFF_MAX_Q in splat_frag.glsl
+static const uint32_t FALLOFF_SIZE = 256;
+static const float FALLOFF_MAX_Q = 2.0f * logf(256.0f);
+
+// The app owns the framebuffer, viewport, blend and depth state, the offscreen draw modes restore it before compositing.
+struct SavedDrawState
+{
+    SavedDrawState()
+    {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrcRGB);
+        glGetIntegerv(GL_BLEND_DST_RGB, &blendDstRGB);
+        glGetIntegerv(GL_BLEND_SRC_ALPHA, &blendSrcAlpha);
+        glGetIntegerv(GL_BLEND_DST_ALPHA, &blendDstAlpha);
+        glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+        blendEnabled = glIsEnabled(GL_BLEND);
+        depthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
+    }
+
+    void RestoreFramebuffer() const
+    {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+    }
+
+    void Restore() const
+    {
+        RestoreFramebuffer();
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glBlendFuncSeparate(blendSrcRGB, blendDstRGB, blendSrcAlpha, blendDstAlpha);
+        glDepthFunc(depthFunc);
+        glDepthMask(depthMask);
+        if (blendEnabled)
+        {
+            glEnable(GL_BLEND);
+        }
+        else
+        {
+            glDisable(GL_BLEND);
+        }
+        if (depthTestEnabled)
+        {
+            glEnable(GL_DEPTH_TEST);
+        }
+        else
+        {
+            glDisable(GL_DEPTH_TEST);
+        }
+    }
+
+    GLint drawFramebuffer = 0;
+    GLint readFramebuffer = 0;
+    GLint viewport[4] = {0, 0, 0, 0};
+    GLint blendSrcRGB = 0;
+    GLint blendDstRGB = 0;
+    GLint blendSrcAlpha = 0;
+    GLint blendDstAlpha = 0;
+    GLint depthFunc = 0;
+    GLboolean depthMask = GL_TRUE;
+    GLboolean blendEnabled = GL_FALSE;
+    GLboolean depthTestEnabled = GL_FALSE;
+};
+
+// Radius of a sphere that bounds the part of the gaussian where alpha * g is above the 1/256 threshold in splat_frag.glsl,
+// the same opacity aware extent used to size the quads. Negative if the splat is never above the threshold.
+// cov is the symmetric 3x3 covariance matrix, the radius is k times the square root of its largest eigenvalue.
+static float ComputeSplatRadius(float alpha, const float* col0, const float* col1, const float* col2)
+{
+    if (alpha <= (1.0f / 256.0f))
+    {
+        return -1.0f;
+    }
+    float k = sqrtf(2.0f * logf(256.0f * alpha));
+
+    // closed form eigenvalues of a symmetric 3x3 matrix
+    // see https://en.wikipedia.org/wiki/Eigenvalue_algorithm#3%C3%973_matrices
+    float a = col0[0], b = col1[0], c = col2[0];
+    float d = col1[1], e = col2[1];
+    float f = col2[2];
+    float p1 = b * b + c * c + e * e;
+    float maxEigen;
+    if (p1 == 0.0f)
+    {
+        maxEigen = std::max(a, std::max(d, f));
+    }
+    else
+    {
+        float q = (a + d + f) / 3.0f;
+        float p2 = (a - q) * (a - q) + (d - q) * (d - q) + (f - q) * (f - q) + 2.0f * p1;
+        float p = sqrtf(p2 / 6.0f);
+        float ba = (a - q) / p, bd = (d - q) / p, bf = (f - q) / p;
+        float bb = b / p, bc = c / p, be = e / p;
+        float detB = ba * (bd * bf - be * be) - bb * (bb * bf - be * bc) + bc * (bb * be - bd * bc);
+        float r = std::clamp(detB / 2.0f, -1.0f, 1.0f);
+        float phi = acosf(r) / 3.0f;
+        maxEigen = q + 2.0f * p * cosf(phi);
+    }
+    return k * sqrtf(std::max(maxEigen, 0.0f));
+}
+
+// splat_preprocess_compute.glsl indexes the gaussian data as an array of floats.
+static std::string OffsetDefine(const char* name, const BinaryAttribute& attrib)
+{
+    assert(attrib.type == BinaryAttribute::Type::Float);
+    assert(attrib.offset % sizeof(float) == 0);
+    return std::string("#define ") + name + " " + std::to_string(attrib.offset / sizeof(float)) + "U\n";
+}
+
+bool SplatRenderer::IsInstancedQuadsSupported()
+{
+#ifndef __ANDROID__
+    if (!(GLEW_VERSION_4_3 || GLEW_ARB_compute_shader))
+    {
+        return false;
+    }
+#endif
+
+    // the splat records and the sorted indices
+    const GLint NUM_REQUIRED_BLOCKS = 2;
+    GLint maxVertexBlocks = 0;
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &maxVertexBlocks);
+    return maxVertexBlocks >= NUM_REQUIRED_BLOCKS;
+}
+
+SplatRenderer::SplatRenderer() :
+    numTilesX(0),
+    numTilesY(0),
+    tileBits(1),
+    numTileEntries(0),
+    offscreenSize(0, 0),
+    foveaSize(0, 0),
+    peripherySize(0, 0),
+    temporalSize(0, 0),
+    expectedDepthPass(false),
+    filterVariance(FILTER_VARIANCE),
+    occluderTexSize(0, 0),
+    occluderNumLevels(0),
+    occluderValid(false),
+    occluderPending(false),
+    sortCount(0),
+    isFramebufferSRGBEnabled(false),
+    useFalloffLut(true),
+    minPixelArea(0.0f),
+    pointRadius(0.0f),
+    sortMargin(0.0f),
+    drawMode(DrawMode::GeometryShader),
+    frontToBack(false),
+    occlusionCulling(false),
+    stereoMultiview(false),
+    drawTimerPending(false),
+    drawTimerActive(false),
+    drawMs(0.0),
+    sortTimerPending(false),
+    sortMs(0.0),
+    fragmentQuery(0),
+    fragmentQueryArea(0.0),
+    fragmentQueryPasses(0),
+    overdraw(0.0),
+    sortPipelining(false),
+    sortPending(false),
+    sortErrorPending(false),
+    sortDepthError(0.0)
 {
 }
 
 SplatRenderer::~SplatRenderer()
 {
+#ifndef __ANDROID__
+    if (fragmentQuery)
+    {
+        glDeleteQueries(1, &fragmentQuery);
+    }
+#endif
 }
 
-bool SplatRenderer::Init(std::shared_ptr<GaussianCloud> gaussianCloud,
-                         bool isFramebufferSRGBEnabledIn, bool useRgcSortOverrideIn)
+bool SplatRenderer::Init(std::shared_ptr<GaussianCloud> gaussianCloud, bool isFramebufferSRGBEnabledIn,
+                         std::shared_ptr<GpuSorter> gpuSorterIn, bool useFalloffLutIn)
 {
     ZoneScopedNC("SplatRenderer::Init()", tracy::Color::Blue);
     GL_ERROR_CHECK("SplatRenderer::Init() begin");
 
     isFramebufferSRGBEnabled = isFramebufferSRGBEnabledIn;
-    useRgcSortOverride = useRgcSortOverrideIn;
+    gpuSorter = gpuSorterIn;
+    useFalloffLut = useFalloffLutIn;
+
+    // used by splat_frag.glsl in both draw modes
+    std::string fragDefines = "";
+    if (useFalloffLut)
+    {
+        fragDefines += "#define FALLOFF_LUT\n";
+    }
 
     splatProg = std::make_shared<Program>();
-    if (isFramebufferSRGBEnabled || gaussianCloud->HasFullSH())
     {
-        std::string defines = "";
+        std::string defines = fragDefines;
         if (isFramebufferSRGBEnabled)
         {
             defines += "#define FRAMEBUFFER_SRGB\n";
@@ -76,241 +337,590 @@ bool SplatRenderer::Init(std::shared_ptr<GaussianCloud> gaussianCloud,
         return false;
     }
 
-    preSortProg = std::make_shared<Program>();
-    if (!preSortProg->LoadCompute("shader/presort_compute.glsl"))
+    if (IsInstancedQuadsSupported())
     {
-        Log::E("Error loading pre-sort compute shader!\n");
-        return false;
-    }
+        std::string defines = BuildPreprocessDefines(gaussianCloud);
+        const std::string splatRecordStruct = BuildSplatRecordStruct();
+        preprocessProg = std::make_shared<Program>();
+        preprocessProg->AddMacro("DEFINES", defines);
+        preprocessProg->AddMacro("SPLAT_RECORD", splatRecordStruct);
+        reprojectProg = std::make_shared<Program>();
+        reprojectProg->AddMacro("DEFINES", defines + "#define REPROJECT\n");
+        reprojectProg->AddMacro("SPLAT_RECORD", splatRecordStruct);
+        quadProg = std::make_shared<Program>();
+        quadProg->AddMacro("DEFINES", fragDefines);
+        quadProg->AddMacro("SPLAT_RECORD", splatRecordStruct);
+        if (preprocessProg->LoadCompute("shader/splat_preprocess_compute.glsl") &&
+            reprojectProg->LoadCompute("shader/splat_preprocess_compute.glsl") &&
+            quadProg->LoadVertFrag("shader/splat_quad_vert.glsl", "shader/splat_frag.glsl"))
+        {
+            // all of the splat data comes from shader storage buffers, but a vao still needs to be bound to draw.
+            quadVao = std::make_shared<VertexArrayObject>();
+            drawMode = DrawMode::InstancedQuads;
+
+            // used by ComputeTiles and front to back quads
+            compositeProg = std::make_shared<Program>();
+            saturateProg = std::make_shared<Program>();
+            saturateProg->AddMacro("SPLAT_RECORD", splatRecordStruct);
+            if (!compositeProg->LoadVertFrag("shader/splat_composite_vert.glsl", "shader/splat_composite_frag.glsl") ||
+                !saturateProg->LoadVertFrag("shader/splat_saturate_vert.glsl", "shader/splat_saturate_frag.glsl"))
+            {
+                Log::W("Error loading splat composite shaders, front to back quads and compute tiles are not available\n");
+                compositeProg = nullptr;
+                saturateProg = nullptr;
+            }
+
+            occluderReduceProg = std::make_shared<Program>();
+            if (!occluderReduceProg->LoadCompute("shader/splat_occluder_reduce_compute.glsl"))
+            {
+                Log::W("Error loading splat occluder shader, occlusion culling is not available\n");
+                occluderReduceProg = nullptr;
+            }
+
+            sortErrorProg = std::make_shared<Program>();
+            sortErrorProg->AddMacro("SPLAT_RECORD", splatRecordStruct);
+            if (!sortErrorProg->LoadCompute("shader/splat_sort_error_compute.glsl"))
+            {
+                Log::W("Error loading splat sort error shader, the sort depth error is not measured\n");
+                sortErrorProg = nullptr;
+            }
+
+            // sort free quads, with a second output for the weights
+            weightedProg = std::make_shared<Program>();
+            weightedProg->AddMacro("DEFINES", fragDefines + "#define WEIGHTED_BLENDED\n");
+            weightedProg->AddMacro("SPLAT_RECORD", splatRecordStruct);
+            weightedCompositeProg = std::make_shared<Program>();
+            if (!compositeProg ||
+                !weightedProg->LoadVertFrag("shader/splat_quad_vert.glsl", "shader/splat_frag.glsl") ||
+                !weightedCompositeProg->LoadVertFrag("shader/splat_composite_vert.glsl", "shader/splat_wboit_composite_frag.glsl"))
+            {
+                Log::W("Error loading splat weighted blended shaders, weighted blended oit is not available\n");
+                weightedProg = nullptr;
+                weightedCompositeProg = nullptr;
+            }
+
+            // both views of a stereo pair in one draw, the second view needs one more storage block in the vertex shader.
+            GLint maxVertexBlocks = 0;
+            glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &maxVertexBlocks);
+            stereoMultiview = HasExtension("GL_OVR_multiview2");
+            if (maxVertexBlocks >= 3 && (stereoMultiview || HasExtension("GL_ARB_shader_viewport_layer_array")))
+            {
+                stereoQuadProg = std::make_shared<Program>();
+                stereoQuadProg->AddMacro("SPLAT_RECORD", splatRecordStruct);
+                if (stereoMultiview)
+                {
+                    stereoQuadProg->AddExtension("GL_OVR_multiview2");
+                    stereoQuadProg->AddMacro("DEFINES", fragDefines + "#define STEREO\n#define MULTIVIEW\n");
+                }
+                else
+                {
+                    stereoQuadProg->AddExtension("GL_ARB_shader_viewport_layer_array");
+                    stereoQuadProg->AddMacro("DEFINES", fragDefines + "#define STEREO\n");
+                }
+                if (!stereoQuadProg->LoadVertFrag("shader/splat_quad_vert.glsl", "shader/splat_frag.glsl"))
+                {
+                    Log::W("Error loading splat stereo shaders, single pass stereo is not available\n");
+                    stereoQuadProg = nullptr;
+                }
+            }
+            stereoMultiview = stereoMultiview && stereoQuadProg;
+
+            // fovea and periphery of RenderFoveated()
+            foveatedCompositeProg = std::make_shared<Program>();
+            if (!foveatedCompositeProg->LoadVertFrag("shader/splat_composite_vert.glsl", "shader/splat_foveated_composite_frag.glsl"))
+            {
+                Log::W("Error loading splat foveated composite shader, foveated rendering is not available\n");
+                foveatedCompositeProg = nullptr;
+            }
+
+            // jittered low resolution splats with their expected depth, and the temporal resolve of RenderTemporal()
+            expectedDepthQuadProg = std::make_shared<Program>();
+            expectedDepthQuadProg->AddMacro("DEFINES", fragDefines + "#define EXPECTED_DEPTH\n");
+            expectedDepthQuadProg->AddMacro("SPLAT_RECORD", splatRecordStruct);
+            temporalProg = std::make_shared<Program>();
+            if (!expectedDepthQuadProg->LoadVertFrag("shader/splat_quad_vert.glsl", "shader/splat_frag.glsl") ||
+                !temporalProg->LoadVertFrag("shader/splat_composite_vert.glsl", "shader/splat_temporal_frag.glsl"))
+            {
+                Log::W("Error loading splat temporal shaders, temporal upsampling is not available\n");
+                expectedDepthQuadProg = nullptr;
+                temporalProg = nullptr;
+            }
 
-    bool useMultiRadixSort = GLEW_KHR_shader_subgroup && !useRgcSortOverride;
+            // the tile rasterizer uses the same records
+            tileBinProg = std::make_shared<Program>();
+            tileRangesProg = std::make_shared<Program>();
+            tileRasterProg = std::make_shared<Program>();
+            tileRasterProg->AddMacro("DEFINES", fragDefines);
+            tileBinProg->AddMacro("SPLAT_RECORD", splatRecordStruct);
+            tileRasterProg->AddMacro("SPLAT_RECORD", splatRecordStruct);
+            if (!compositeProg ||
+                !tileBinProg->LoadCompute("shader/splat_tile_bin_compute.glsl") ||
+                !tileRangesProg->LoadCompute("shader/splat_tile_ranges_compute.glsl") ||
+                !tileRasterProg->LoadCompute("shader/splat_tile_raster_compute.glsl"))
+            {
+                Log::W("Error loading splat tile shaders, compute tiles are not available\n");
+                tileBinProg = nullptr;
+                tileRangesProg = nullptr;
+                tileRasterProg = nullptr;
+            }
+        }
+        else
+        {
+            Log::W("Error loading splat quad shaders, falling back to geometry shader\n");
+            preprocessProg = nullptr;
+            reprojectProg = nullptr;
+            quadProg = nullptr;
+        }
+    }
 
-    if (useMultiRadixSort)
+    if (GpuTimer::IsSupported())
     {
-        sortProg = std::make_shared<Program>();
-        if (!sortProg->LoadCompute("shader/multi_radixsort.glsl"))
+        drawTimer = std::make_shared<GpuTimer>();
+        sortTimer = std::make_shared<GpuTimer>();
+#ifndef __ANDROID__
+        if (GLEW_ARB_pipeline_statistics_query)
         {
-            Log::E("Error loading sort compute shader!\n");
-            return false;
+            glGenQueries(1, &fragmentQuery);
         }
+#endif
+    }
 
-        histogramProg = std::make_shared<Program>();
-        if (!histogramProg->LoadCompute("shader/multi_radixsort_histograms.glsl"))
+    if (useFalloffLut)
+    {
+        // lookup table for the gaussian falloff in splat_frag.glsl, texel i = exp(-0.5 * q) where q = FALLOFF_MAX_Q * i / (FALLOFF_SIZE - 1)
+        std::vector<float> falloffVec(FALLOFF_SIZE);
+        for (uint32_t i = 0; i < FALLOFF_SIZE; i++)
         {
-            Log::E("Error loading histogram compute shader!\n");
-            return false;
+            float q = FALLOFF_MAX_Q * (float)i / (float)(FALLOFF_SIZE - 1);
+            falloffVec[i] = expf(-0.5f * q);
         }
+        Texture::Params falloffParams = {FilterType::Linear, FilterType::Linear, WrapType::ClampToEdge, WrapType::ClampToEdge};
+        falloffTex = std::make_shared<Texture>(FALLOFF_SIZE, 1, GL_R16F, GL_RED, GL_FLOAT, falloffParams, falloffVec.data());
     }
 
-    // build posVec
+    // build posVec, w is the radius of each splat for culling in GpuSorter::Sort()
     size_t numGaussians = gaussianCloud->GetNumGaussians();
     posVec.reserve(numGaussians);
-    gaussianCloud->ForEachPosWithAlpha([this](const float* pos)
     {
-        posVec.emplace_back(glm::vec4(pos[0], pos[1], pos[2], 1.0f));
-    });
+        const uint8_t* data = (const uint8_t*)gaussianCloud->GetRawDataPtr();
+        const size_t stride = gaussianCloud->GetStride();
+        const size_t posOffset = gaussianCloud->GetPosWithAlphaAttrib().offset;
+        const size_t col0Offset = gaussianCloud->GetCov3_Col0Attrib().offset;
+        const size_t col1Offset = gaussianCloud->GetCov3_Col1Attrib().offset;
+        const size_t col2Offset = gaussianCloud->GetCov3_Col2Attrib().offset;
+        for (size_t i = 0; i < numGaussians; i++)
+        {
+            const uint8_t* ptr = data + i * stride;
+            const float* pos = (const float*)(ptr + posOffset);
+            float radius = ComputeSplatRadius(pos[3], (const float*)(ptr + col0Offset),
+                                              (const float*)(ptr + col1Offset), (const float*)(ptr + col2Offset));
+            posVec.emplace_back(glm::vec4(pos[0], pos[1], pos[2], radius));
+        }
+    }
 
     BuildVertexArrayObject(gaussianCloud);
 
-    depthVec.resize(numGaussians);
+    assert(numGaussians <= gpuSorter->GetMaxNumElements());
+    posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, posVec);
+
+    // draw directly from the output of the sort, instead of copying it into a seperate element buffer.
+    splatVao->SetElementBuffer(gpuSorter->GetSortedValBuffer());
 
-    if (useMultiRadixSort)
+    if (quadProg)
     {
-        Log::I("using multi_radixsort.glsl\n");
+        // one record per gaussian, in case they are all visible. written by the gpu only.
+        recordBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, numGaussians * SPLAT_RECORD_SIZE, 0);
 
-        keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
-        keyBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
+        atomicCounterVec.resize(1, 0);
+        atomicCounterBuffer = std::make_shared<BufferObject>(GL_ATOMIC_COUNTER_BUFFER, atomicCounterVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+
+        // inverted pairs and pairs of the sort error measurement
+        sortErrorVec.resize(2, 0);
+        sortErrorBuffer = std::make_shared<BufferObject>(GL_ATOMIC_COUNTER_BUFFER, sortErrorVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+    }
 
-        const uint32_t NUM_ELEMENTS = static_cast<uint32_t>(numGaussians);
-        const uint32_t NUM_WORKGROUPS = (NUM_ELEMENTS + numBlocksPerWorkgroup - 1) / numBlocksPerWorkgroup;
-        const uint32_t RADIX_SORT_BINS = 256;
+    GL_ERROR_CHECK("SplatRenderer::Init() end");
 
-        std::vector<uint32_t> histogramVec(NUM_WORKGROUPS * RADIX_SORT_BINS, 0);
-        histogramBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, histogramVec, GL_DYNAMIC_STORAGE_BIT);
+    return true;
+}
 
-        valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
-        valBuffer2 = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
-        posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, posVec);
+void SplatRenderer::SetDrawMode(DrawMode drawModeIn)
+{
+    if (drawModeIn == DrawMode::InstancedQuads && !quadProg)
+    {
+        Log::W("Instanced quads are not supported, using geometry shader\n");
+        drawMode = DrawMode::GeometryShader;
+    }
+    else if (drawModeIn == DrawMode::ComputeTiles && !tileRasterProg)
+    {
+        Log::W("Compute tiles are not supported, using geometry shader\n");
+        drawMode = DrawMode::GeometryShader;
+    }
+    else if (drawModeIn == DrawMode::WeightedBlended && !weightedProg)
+    {
+        Log::W("Weighted blended oit is not supported, using geometry shader\n");
+        drawMode = DrawMode::GeometryShader;
     }
     else
     {
-        Log::I("using rgc::radix_sort\n");
-        keyBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, depthVec, GL_DYNAMIC_STORAGE_BIT);
-        valBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
-        posBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, posVec);
+        drawMode = drawModeIn;
+    }
+
+    // the records and the sorted indices from the other mode can not be drawn, wait for the next Sort()
+    sortCount = 0;
+    occluderValid = false;
+    CancelPendingSort();
+}
 
-        sorter = std::make_shared<rgc::radix_sort::sorter>(numGaussians);
+void SplatRenderer::SetSortPipelining(bool sortPipeliningIn)
+{
+    if (sortPipeliningIn && !quadProg)
+    {
+        Log::W("Sort pipelining needs instanced quads, which are not supported\n");
+        sortPipeliningIn = false;
+    }
+    if (sortPipeliningIn && gpuSorter->GetBackend() != GpuSorter::Backend::CpuRadixSort)
+    {
+        // a gpu sort is done in the frame it is started anyway, pipelining it only adds a frame of latency.
+        Log::W("Sort pipelining is only supported with the cpu sort backend\n");
+        sortPipeliningIn = false;
     }
+    if (sortPipelining != sortPipeliningIn)
+    {
+        // the indices that are drawn move to other buffers, wait for the next Sort()
+        CancelPendingSort();
+        sortPipelining = sortPipeliningIn;
+        sortCount = 0;
+        sortDepthError = 0.0;
+    }
+}
 
-    atomicCounterVec.resize(1, 0);
-    atomicCounterBuffer = std::make_shared<BufferObject>(GL_ATOMIC_COUNTER_BUFFER, atomicCounterVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+// grows the frustum of projMat by margin radians on every side, and the viewport with it, so a pixel covers the same angle.
+static void WidenFrustum(const glm::mat4& projMat, const glm::vec4& viewport, const glm::vec2& nearFar, float margin,
+                         glm::mat4& projMatOut, glm::vec4& viewportOut)
+{
+    // tangents of the frustum sides, for an off center projection like glm::frustum()
+    glm::vec2 tanMin((projMat[2][0] - 1.0f) / projMat[0][0], (projMat[2][1] - 1.0f) / projMat[1][1]);
+    glm::vec2 tanMax((projMat[2][0] + 1.0f) / projMat[0][0], (projMat[2][1] + 1.0f) / projMat[1][1]);
 
-    GL_ERROR_CHECK("SplatRenderer::Init() end");
+    const float MAX_ANGLE = glm::radians(85.0f);
+    glm::vec2 newTanMin, newTanMax;
+    for (int i = 0; i < 2; i++)
+    {
+        newTanMin[i] = tanf(std::max(atanf(tanMin[i]) - margin, -MAX_ANGLE));
+        newTanMax[i] = tanf(std::min(atanf(tanMax[i]) + margin, MAX_ANGLE));
+    }
 
-    return true;
+    float nearDist = nearFar.x;
+    projMatOut = glm::frustum(newTanMin.x * nearDist, newTanMax.x * nearDist, newTanMin.y * nearDist, newTanMax.y * nearDist,
+                              nearDist, nearFar.y);
+    glm::vec2 scale = (newTanMax - newTanMin) / (tanMax - tanMin);
+    viewportOut = glm::vec4(viewport.x, viewport.y, roundf(viewport.z * scale.x), roundf(viewport.w * scale.y));
 }
 
-void SplatRenderer::Sort(const glm::mat4& cameraMat, const glm::mat4& projMat,
-                         const glm::vec4& viewport, const glm::vec2& nearFar)
+void SplatRenderer::Sort(const glm::mat4& cameraMat, const glm::mat4& projMatIn,
+                         const glm::vec4& viewportIn, const glm::vec2& nearFar)
 {
     ZoneScoped;
 
     GL_ERROR_CHECK("SplatRenderer::Sort() begin");
 
-    const size_t numPoints = posVec.size();
-    glm::mat4 modelViewMat = glm::inverse(cameraMat);
-
-    bool useMultiRadixSort = GLEW_KHR_shader_subgroup && !useRgcSortOverride;
-
-    // 24 bit radix sort still has some artifacts on some datasets, so use 32 bit sort.
-    //const uint32_t NUM_BYTES = useMultiRadixSort ? 3 : 4;
-    //const uint32_t MAX_DEPTH = useMultiRadixSort ? 16777215 : std::numeric_limits<uint32_t>::max();
-    const uint32_t NUM_BYTES = 4;
-    const uint32_t MAX_DEPTH = std::numeric_limits<uint32_t>::max();
-
+    // the records of a wider frustum are re-projected by Render() like those of any other view,
+    // the tiles are binned for the view they are drawn with, so they are not widened.
+    glm::mat4 projMat = projMatIn;
+    glm::vec4 viewport = viewportIn;
+    if (sortMargin > 0.0f && drawMode != DrawMode::ComputeTiles)
     {
-        ZoneScopedNC("pre-sort", tracy::Color::Red4);
+        WidenFrustum(projMatIn, viewportIn, nearFar, sortMargin, projMat, viewport);
+    }
 
-        preSortProg->Bind();
-        preSortProg->SetUniform("modelViewProj", projMat * modelViewMat);
-        preSortProg->SetUniform("nearFar", nearFar);
-        preSortProg->SetUniform("keyMax", MAX_DEPTH);
+    // same as the draw timer, read back the previous measurement without stalling.
+    if (sortTimer && sortTimerPending && sortTimer->IsAvailable())
+    {
+        sortMs = sortTimer->Resolve()[0].ms;
+        sortTimerPending = false;
+    }
+    bool timeSort = sortTimer && !sortTimerPending;
+    if (timeSort)
+    {
+        sortTimer->Reset();
+        sortTimer->Begin("splat sort");
+    }
 
-        // reset counter back to zero
-        atomicCounterVec[0] = 0;
-        atomicCounterBuffer->Update(atomicCounterVec);
+    if (drawMode == DrawMode::ComputeTiles)
+    {
+        BuildTiles(cameraMat, projMat, viewport, nearFar);
+        occluderPending = true;
+    }
+    else if (drawMode == DrawMode::InstancedQuads && sortPipelining)
+    {
+        SortPipelined(cameraMat, projMat, viewport, nearFar);
+        occluderPending = true;
+    }
+    else if (drawMode == DrawMode::InstancedQuads)
+    {
+        uint32_t count = PreprocessAndCount(cameraMat, projMat, viewport, nearFar);
+        occluderPending = true;
 
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, posBuffer->GetObj());  // readonly
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer->GetObj());  // writeonly
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer->GetObj());  // writeonly
-        glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 4, atomicCounterBuffer->GetObj());
+        // the values are the indices of the records, sort them back to front.
+        gpuSorter->SortKeys(count);
+        sortCount = count;
 
-        const int LOCAL_SIZE = 256;
-        glDispatchCompute(((GLuint)numPoints + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1); // Assuming LOCAL_SIZE threads per group
-        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+        recordCameraMat = cameraMat;
+        recordProjMat = projMat;
+        recordViewport = viewport;
+    }
+    else if (drawMode == DrawMode::WeightedBlended)
+    {
+        // order independent, the records are drawn in the order Preprocess() wrote them.
+        sortCount = PreprocessAndCount(cameraMat, projMat, viewport, nearFar);
 
-        GL_ERROR_CHECK("SplatRenderer::Sort() pre-sort");
+        recordCameraMat = cameraMat;
+        recordProjMat = projMat;
+        recordViewport = viewport;
+    }
+    else
+    {
+        // the radius in posVec makes the frustum test conservative, so no guard band is needed.
+        GpuSorter::CullParams cullParams;
+        cullParams.clipBound = 1.0f;
+        cullParams.pixelScale = 0.5f * std::max(fabsf(projMat[0][0]) * viewport.z, fabsf(projMat[1][1]) * viewport.w);
+        cullParams.minPixelArea = minPixelArea;
+
+        glm::mat4 modelViewMat = glm::inverse(cameraMat);
+        sortCount = gpuSorter->Sort(posVec, posBuffer, projMat * modelViewMat, nearFar, cullParams);
     }
 
+    if (timeSort)
     {
-        ZoneScopedNC("get-count", tracy::Color::Green);
+        sortTimer->End();
+        sortTimerPending = true;
+    }
 
-        atomicCounterBuffer->Read(atomicCounterVec);
-        sortCount = atomicCounterVec[0];
+    GL_ERROR_CHECK("SplatRenderer::Sort() end");
+}
 
-        assert(sortCount <= (uint32_t)numPoints);
+// promotes the pending records once their order is sorted, then preprocesses this view into the pending records and starts
+// sorting them. the count and keys are read back asynchronously, so neither this nor the draws wait for the gpu or the sort.
+// while a sort is in flight no new one is started, so with a slow sort the order that is drawn can be several frames old.
+void SplatRenderer::SortPipelined(const glm::mat4& cameraMat, const glm::mat4& projMat,
+                                  const glm::vec4& viewport, const glm::vec2& nearFar)
+{
+    if (sortPending && !gpuSorter->IsAsyncSortKeysPending())
+    {
+        // another sort on gpuSorter dropped it.
+        sortPending = false;
+    }
 
-        GL_ERROR_CHECK("SplatRenderer::Render() get-count");
+    if (sortPending)
+    {
+        // there is no older order to draw yet, so wait for it.
+        PromotePendingSort(sortCount == 0);
+        if (sortPending)
+        {
+            return;
+        }
     }
 
-    if (useMultiRadixSort)
+    if (!pendingRecordBuffer)
     {
-        ZoneScopedNC("sort", tracy::Color::Red4);
+        size_t numGaussians = posVec.size();
+        pendingRecordBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, numGaussians * SPLAT_RECORD_SIZE, 0);
+    }
 
-        const uint32_t NUM_ELEMENTS = static_cast<uint32_t>(sortCount);
-        const uint32_t NUM_WORKGROUPS = (NUM_ELEMENTS + numBlocksPerWorkgroup - 1) / numBlocksPerWorkgroup;
+    // Preprocess() writes recordBuffer, which is still drawn until the sort is done.
+    std::swap(recordBuffer, pendingRecordBuffer);
+    PreprocessVisible(cameraMat, projMat, viewport, nearFar);
+    std::swap(recordBuffer, pendingRecordBuffer);
 
-        sortProg->Bind();
-        sortProg->SetUniform("g_num_elements", NUM_ELEMENTS);
-        sortProg->SetUniform("g_num_workgroups", NUM_WORKGROUPS);
-        sortProg->SetUniform("g_num_blocks_per_workgroup", numBlocksPerWorkgroup);
+    // the values are the indices of the records, sort them back to front.
+    gpuSorter->StartAsyncSortKeys(atomicCounterBuffer);
+    pendingCameraMat = cameraMat;
+    pendingProjMat = projMat;
+    pendingViewport = viewport;
+    sortPending = true;
 
-        histogramProg->Bind();
-        histogramProg->SetUniform("g_num_elements", NUM_ELEMENTS);
-        //histogramProg->SetUniform("g_num_workgroups", NUM_WORKGROUPS);
-        histogramProg->SetUniform("g_num_blocks_per_workgroup", numBlocksPerWorkgroup);
+    if (sortCount == 0)
+    {
+        PromotePendingSort(true);
+    }
+}
 
-        for (uint32_t i = 0; i < NUM_BYTES; i++)
-        {
-            histogramProg->Bind();
-            histogramProg->SetUniform("g_shift", 8 * i);
+// makes the records and the sorted indices of the last SortPipelined() the ones that are drawn, once the sort is done.
+// the sorter flips between two value buffers, so its sorted values are drawn in place until the next sort is done.
+void SplatRenderer::PromotePendingSort(bool wait)
+{
+    ZoneScopedNC("promote sort", tracy::Color::Red4);
 
-            if (i == 0 || i == 2)
-            {
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer->GetObj());
-            }
-            else
-            {
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer2->GetObj());
-            }
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, histogramBuffer->GetObj());
+    uint32_t count = 0;
+    if (!gpuSorter->PollAsyncSortKeys(&count, wait))
+    {
+        return;
+    }
 
-            glDispatchCompute(NUM_WORKGROUPS, 1, 1);
+    std::swap(recordBuffer, pendingRecordBuffer);
+    drawIndexBuffer = gpuSorter->GetSortedValBuffer();
+    sortCount = count;
+    recordCameraMat = pendingCameraMat;
+    recordProjMat = pendingProjMat;
+    recordViewport = pendingViewport;
+    sortPending = false;
 
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    GL_ERROR_CHECK("SplatRenderer::PromotePendingSort()");
+}
 
-            sortProg->Bind();
-            sortProg->SetUniform("g_shift", 8 * i);
+// drops the sort in flight, when its records can no longer be drawn.
+void SplatRenderer::CancelPendingSort()
+{
+    if (sortPending)
+    {
+        gpuSorter->CancelAsyncSortKeys();
+        sortPending = false;
+    }
+}
 
-            if ((i % 2) == 0)  // even
-            {
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer2->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, valBuffer2->GetObj());
-            }
-            else  // odd
-            {
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keyBuffer2->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, keyBuffer->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, valBuffer2->GetObj());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, valBuffer->GetObj());
-            }
-            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, histogramBuffer->GetObj());
+// indices of the records in drawing order, back to front.
+std::shared_ptr<BufferObject> SplatRenderer::GetDrawIndexBuffer() const
+{
+    bool pipelined = sortPipelining && drawMode == DrawMode::InstancedQuads && drawIndexBuffer;
+    return pipelined ? drawIndexBuffer : gpuSorter->GetSortedValBuffer();
+}
 
-            glDispatchCompute(NUM_WORKGROUPS, 1, 1);
+// counts the inverted pairs of the order that is drawn next, read back with the draw timer by BeginDrawTimer().
+void SplatRenderer::MeasureSortError()
+{
+    sortErrorVec[0] = 0;
+    sortErrorVec[1] = 0;
+    sortErrorBuffer->Update(sortErrorVec);
+
+    sortErrorProg->Bind();
+    sortErrorProg->SetUniform("numSplats", sortCount);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, recordBuffer->GetObj());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, GetDrawIndexBuffer()->GetObj());
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, sortErrorBuffer->GetObj());
+
+    const int LOCAL_SIZE = 256;
+    glDispatchCompute((sortCount + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1);
+    glMemoryBarrier(GL_ATOMIC_COUNTER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, 0);
+    sortErrorPending = true;
+
+    GL_ERROR_CHECK("SplatRenderer::MeasureSortError()");
+}
 
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+// finds a camera between the two eyes of a stereo pair, with the rotation half way between theirs,
+// moved back far enough that its frustum contains both eye frusta.
+// the viewport is grown so a pixel covers the same angle as in the first eye, which keeps the pixel area tests the same.
+static void ComputeCyclopeanView(const glm::mat4* cameraMats, const glm::mat4* projMats,
+                                 const glm::vec4& viewport, const glm::vec2& nearFar,
+                                 glm::mat4& cameraMatOut, glm::mat4& projMatOut,
+                                 glm::vec4& viewportOut, glm::vec2& nearFarOut)
+{
+    glm::vec3 scale[2];
+    glm::quat rotation[2];
+    glm::vec3 translation[2];
+    for (int i = 0; i < 2; i++)
+    {
+        Decompose(cameraMats[i], &scale[i], &rotation[i], &translation[i]);
+    }
+    glm::mat4 centerMat = MakeMat4(scale[0], SafeMix(rotation[0], rotation[1], 0.5f), 0.5f * (translation[0] + translation[1]));
+    glm::mat4 invCenterMat = glm::inverse(centerMat);
+
+    // eye positions and near plane corners, in the coordinates of the center eye.
+    glm::vec3 eyes[2];
+    glm::vec3 nearCorners[2][4];
+    glm::vec2 tanMin(std::numeric_limits<float>::max());
+    glm::vec2 tanMax(-std::numeric_limits<float>::max());
+    glm::vec2 firstEyeTanSpan;
+    for (int i = 0; i < 2; i++)
+    {
+        glm::mat4 ndcToCenterMat = invCenterMat * cameraMats[i] * glm::inverse(projMats[i]);
+        eyes[i] = glm::vec3(invCenterMat * cameraMats[i][3]);
+        glm::vec2 eyeTanMin(std::numeric_limits<float>::max());
+        glm::vec2 eyeTanMax(-std::numeric_limits<float>::max());
+        for (int j = 0; j < 4; j++)
+        {
+            glm::vec4 p = ndcToCenterMat * glm::vec4((j & 1) ? 1.0f : -1.0f, (j & 2) ? 1.0f : -1.0f, -1.0f, 1.0f);
+            nearCorners[i][j] = glm::vec3(p) / p.w;
+
+            // the camera looks down -z
+            glm::vec3 d = nearCorners[i][j] - eyes[i];
+            glm::vec2 tan = glm::vec2(d) / -d.z;
+            eyeTanMin = glm::min(eyeTanMin, tan);
+            eyeTanMax = glm::max(eyeTanMax, tan);
         }
-
-        GL_ERROR_CHECK("SplatRenderer::Sort() sort");
-
-        // indicate if keys are sorted properly or not.
-        if (false)
+        tanMin = glm::min(tanMin, eyeTanMin);
+        tanMax = glm::max(tanMax, eyeTanMax);
+        if (i == 0)
         {
-            std::vector<uint32_t> sortedKeyVec(numPoints, 0);
-            keyBuffer->Read(sortedKeyVec);
-
-            GL_ERROR_CHECK("SplatRenderer::Sort() READ buffer");
-
-            bool sorted = true;
-            for (uint32_t i = 1; i < sortCount; i++)
-            {
-                if (sortedKeyVec[i - 1] > sortedKeyVec[i])
-                {
-                    sorted = false;
-                    break;
-                }
-            }
-
-            printf("%s", sorted ? "o" : "x");
+            firstEyeTanSpan = eyeTanMax - eyeTanMin;
         }
     }
-    else
+
+    // the union frustum must contain the center line, to have a valid apex.
+    const float MIN_TAN = 0.01f;
+    tanMin = glm::min(tanMin, glm::vec2(-MIN_TAN));
+    tanMax = glm::max(tanMax, glm::vec2(MIN_TAN));
+
+    // every eye frustum is inside a frustum with wider tangents, if its eye is inside it too.
+    // so move the apex back along +z until both eyes are inside, usually by about half the ipd.
+    float back = 0.0f;
+    for (int i = 0; i < 2; i++)
     {
-        ZoneScopedNC("sort", tracy::Color::Red4);
-        sorter->sort(keyBuffer->GetObj(), valBuffer->GetObj(), sortCount);
-        GL_ERROR_CHECK("SplatRenderer::Sort() rgc sort");
+        back = std::max(back, eyes[i].z);
+        back = std::max(back, eyes[i].z + eyes[i].x / tanMin.x);
+        back = std::max(back, eyes[i].z + eyes[i].x / tanMax.x);
+        back = std::max(back, eyes[i].z + eyes[i].y / tanMin.y);
+        back = std::max(back, eyes[i].z + eyes[i].y / tanMax.y);
     }
 
+    // the far corners are along the same rays as the near corners, from the eye.
+    // the near plane stays at the eye distance, so the near cull in the preprocess never removes more than it does for the eyes.
+    float nearDist = nearFar.x;
+    float farDist = 0.0f;
+    float farScale = nearFar.y / nearFar.x;
+    for (int i = 0; i < 2; i++)
     {
-        ZoneScopedNC("copy-sorted", tracy::Color::DarkGreen);
-
-        if (useMultiRadixSort && (NUM_BYTES % 2) == 1)  // odd
+        for (int j = 0; j < 4; j++)
         {
-            glBindBuffer(GL_COPY_READ_BUFFER, valBuffer2->GetObj());
+            glm::vec3 farCorner = eyes[i] + (nearCorners[i][j] - eyes[i]) * farScale;
+            farDist = std::max(farDist, back - farCorner.z);
         }
-        else
-        {
-            glBindBuffer(GL_COPY_READ_BUFFER, valBuffer->GetObj());
-        }
-        glBindBuffer(GL_COPY_WRITE_BUFFER, splatVao->GetElementBuffer()->GetObj());
-        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sortCount * sizeof(uint32_t));
-
-        GL_ERROR_CHECK("SplatRenderer::Sort() copy-sorted");
     }
+
+    cameraMatOut = centerMat * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, back));
+    projMatOut = glm::frustum(tanMin.x * nearDist, tanMax.x * nearDist, tanMin.y * nearDist, tanMax.y * nearDist, nearDist, farDist);
+    glm::vec2 tanSpan = tanMax - tanMin;
+    viewportOut = glm::vec4(viewport.x, viewport.y,
+                            roundf(viewport.z * tanSpan.x / firstEyeTanSpan.x), roundf(viewport.w * tanSpan.y / firstEyeTanSpan.y));
+    nearFarOut = glm::vec2(nearDist, farDist);
 }
 
+void SplatRenderer::SortStereo(const glm::mat4* cameraMats, const glm::mat4* projMats,
+                               const glm::vec4& viewport, const glm::vec2& nearFar)
+{
+    ZoneScoped;
+
+    // tiles are binned for one view, so each eye rebuilds them in Render() anyway.
+    if (drawMode == DrawMode::ComputeTiles)
+    {
+        Sort(cameraMats[0], projMats[0], viewport, nearFar);
+        return;
+    }
+
+    glm::mat4 cameraMat, projMat;
+    glm::vec4 cyclopeanViewport;
+    glm::vec2 cyclopeanNearFar;
+    ComputeCyclopeanView(cameraMats, projMats, viewport, nearFar, cameraMat, projMat, cyclopeanViewport, cyclopeanNearFar);
+
+    // the occluders only cover the pixels of one eye, they would cull splats that the other eye can see.
+    occluderValid = false;
+    Sort(cameraMat, projMat, cyclopeanViewport, cyclopeanNearFar);
+    occluderPending = false;
+}
 
 void SplatRenderer::Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
                            const glm::vec4& viewport, const glm::vec2& nearFar)
@@ -319,56 +929,544 @@ void SplatRenderer::Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
 
     GL_ERROR_CHECK("SplatRenderer::Render() begin");
 
-    {
-        ZoneScopedNC("draw", tracy::Color::Red4);
-        float width = viewport.z;
-        float height = viewport.w;
-        float aspectRatio = width / height;
-        glm::mat4 viewMat = glm::inverse(cameraMat);
-        glm::vec3 eye = glm::vec3(cameraMat[3]);
+    // the first draw after a sort is used to build the occluders for the next one.
+    bool buildOccluders = occlusionCulling && occluderPending && occluderReduceProg && sortCount > 0 &&
+        (drawMode == DrawMode::ComputeTiles || IsFrontToBack());
+    occluderPending = false;
 
-        splatProg->Bind();
-        splatProg->SetUniform("viewMat", viewMat);
-        splatProg->SetUniform("projMat", projMat);
-        splatProg->SetUniform("viewport", viewport);
-        splatProg->SetUniform("projParams", glm::vec4(0.0f, nearFar.x, nearFar.y, 0.0f));
-        splatProg->SetUniform("eye", eye);
+    if ((drawMode == DrawMode::InstancedQuads || drawMode == DrawMode::WeightedBlended) && sortCount > 0 &&
+        (cameraMat != recordCameraMat || projMat != recordProjMat || viewport != recordViewport))
+    {
+        ZoneScopedNC("reproject", tracy::Color::Red4);
 
-        splatVao->Bind();
-        glDrawElements(GL_POINTS, sortCount, GL_UNSIGNED_INT, nullptr);
-        splatVao->Unbind();
+        Preprocess(true, sortCount, cameraMat, projMat, viewport, nearFar);
+        recordCameraMat = cameraMat;
+        recordProjMat = projMat;
+        recordViewport = viewport;
 
-        GL_ERROR_CHECK("SplatRenderer::Render() draw");
+        GL_ERROR_CHECK("SplatRenderer::Render() reproject");
+    }
+    else if (drawMode == DrawMode::ComputeTiles && sortCount > 0 &&
+             (cameraMat != recordCameraMat || projMat != recordProjMat || viewport != recordViewport))
+    {
+        // the tiles depend on the view, so they must be rebuilt from scratch.
+        BuildTiles(cameraMat, projMat, viewport, nearFar);
     }
-}
-
-void SplatRenderer::BuildVertexArrayObject(std::shared_ptr<GaussianCloud> gaussianCloud)
-{
-    splatVao = std::make_shared<VertexArrayObject>();
-
-    // allocate large buffer to hold interleaved vertex data
-    gaussianDataBuffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER,
-                                                        gaussianCloud->GetRawDataPtr(),
-                                                        gaussianCloud->GetTotalSize(), 0);
 
-    const size_t numGaussians = gaussianCloud->GetNumGaussians();
+    // ComputeTiles has no splat fragments to count, only the composite.
+    double fragmentArea = (drawMode != DrawMode::ComputeTiles) ? (double)viewport.z * (double)viewport.w : 0.0;
 
-    // build element array
-    indexVec.reserve(numGaussians);
-    assert(numGaussians <= std::numeric_limits<uint32_t>::max());
-    for (uint32_t i = 0; i < (uint32_t)numGaussians; i++)
+    // front to back quads also shade every pixel once per saturate pass, and once more for the composite.
+    uint32_t fragmentPasses = 0;
+    if (IsFrontToBack() && sortCount > 0)
+    {
+        fragmentPasses = FRONT_TO_BACK_CHUNKS + (buildOccluders ? 1 : 0);
+    }
+    else if (drawMode == DrawMode::WeightedBlended && sortCount > 0)
     {
-        indexVec.push_back(i);
+        fragmentPasses = 1;
     }
-    auto indexBuffer = std::make_shared<BufferObject>(GL_ELEMENT_ARRAY_BUFFER, indexVec, GL_DYNAMIC_STORAGE_BIT);
+    bool timeDraw = BeginDrawTimer(fragmentArea, fragmentPasses);
 
-    splatVao->Bind();
-    gaussianDataBuffer->Bind();
+    // inside the timer, so the counters are known to be done when it is.
+    if (timeDraw && sortPipelining && sortErrorProg && drawMode == DrawMode::InstancedQuads && sortCount > 0)
+    {
+        MeasureSortError();
+    }
 
-    const size_t stride = gaussianCloud->GetStride();
-    SetupAttrib(splatProg->GetAttribLoc("position"), gaussianCloud->GetPosWithAlphaAttrib(), 4, stride);
-    SetupAttrib(splatProg->GetAttribLoc("r_sh0"), gaussianCloud->GetR_SH0Attrib(), 4, stride);
-    SetupAttrib(splatProg->GetAttribLoc("g_sh0"), gaussianCloud->GetG_SH0Attrib(), 4, stride);
+    if (drawMode == DrawMode::ComputeTiles)
+    {
+        ZoneScopedNC("draw tiles", tracy::Color::Red4);
+        if (sortCount > 0)
+        {
+            RenderTiles(viewport);
+            if (buildOccluders)
+            {
+                BuildOccluderPyramid(tileDepthTex, offscreenSize);
+            }
+        }
+        GL_ERROR_CHECK("SplatRenderer::Render() draw tiles");
+    }
+    else if (drawMode == DrawMode::WeightedBlended)
+    {
+        ZoneScopedNC("draw weighted blended", tracy::Color::Red4);
+        if (sortCount > 0)
+        {
+            RenderWeightedBlended(viewport, nearFar);
+        }
+        GL_ERROR_CHECK("SplatRenderer::Render() draw weighted blended");
+    }
+    else if (IsFrontToBack())
+    {
+        ZoneScopedNC("draw front to back", tracy::Color::Red4);
+        if (sortCount > 0)
+        {
+            RenderFrontToBack(viewport, buildOccluders);
+            if (buildOccluders && offscreenDepthTex)
+            {
+                BuildOccluderPyramid(offscreenDepthTex, offscreenSize);
+            }
+        }
+        GL_ERROR_CHECK("SplatRenderer::Render() draw front to back");
+    }
+    else
+    {
+        ZoneScopedNC("draw", tracy::Color::Red4);
+        float width = viewport.z;
+        float height = viewport.w;
+        float aspectRatio = width / height;
+        glm::mat4 viewMat = glm::inverse(cameraMat);
+        glm::vec3 eye = glm::vec3(cameraMat[3]);
+
+        std::shared_ptr<Program> prog = splatProg;
+        if (drawMode == DrawMode::InstancedQuads)
+        {
+            prog = expectedDepthPass ? expectedDepthQuadProg : quadProg;
+        }
+        prog->Bind();
+        prog->SetUniform("viewport", viewport);
+        if (expectedDepthPass)
+        {
+            prog->SetUniform("nearFar", nearFar);
+        }
+        if (falloffTex)
+        {
+            // use texture unit 0 for the gaussian falloff
+            falloffTex->Bind(0);
+            prog->SetUniform("falloffTex", 0);
+        }
+
+        if (drawMode == DrawMode::InstancedQuads)
+        {
+            // everything else was baked into the records by Preprocess()
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, recordBuffer->GetObj());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, GetDrawIndexBuffer()->GetObj());
+            prog->SetUniform("indexBase", 0);
+            prog->SetUniform("indexStep", 1);
+
+            // one 4 vertex triangle strip per splat, instances are rasterized in order so back to front blending still works.
+            quadVao->Bind();
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, sortCount);
+            quadVao->Unbind();
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+        }
+        else
+        {
+            splatProg->SetUniform("viewMat", viewMat);
+            splatProg->SetUniform("projMat", projMat);
+            splatProg->SetUniform("eye", eye);
+            splatProg->SetUniform("pointRadius", pointRadius);
+
+            splatVao->Bind();
+            glDrawElements(GL_POINTS, sortCount, GL_UNSIGNED_INT, nullptr);
+            splatVao->Unbind();
+        }
+
+        GL_ERROR_CHECK("SplatRenderer::Render() draw");
+    }
+
+    if (buildOccluders)
+    {
+        occluderValid = occluderTex != nullptr;
+        occluderCameraMat = cameraMat;
+        occluderViewProjMat = projMat * glm::inverse(cameraMat);
+        occluderViewport = viewport;
+    }
+
+    if (timeDraw)
+    {
+        EndDrawTimer();
+    }
+}
+
+bool SplatRenderer::IsFoveationSupported() const
+{
+    return foveatedCompositeProg && (drawMode == DrawMode::GeometryShader || (drawMode == DrawMode::InstancedQuads && !IsFrontToBack()));
+}
+
+// the fovea and the periphery are both drawn with Render() into their own targets, then composited.
+// the fovea is drawn with the full resolution projection, a projection cropped to its rect would move large splats that still
+// cover it outside of the guard band. the pixels outside of the fovea target are clipped, so only the vertex work is not saved.
+void SplatRenderer::RenderFoveated(const glm::mat4& cameraMat, const glm::mat4& projMat,
+                                   const glm::vec4& viewport, const glm::vec2& nearFar,
+                                   const glm::vec4& fovea, float peripheryScale)
+{
+    ZoneScoped;
+
+    // snap the fovea to whole pixels inside the viewport
+    glm::vec2 foveaMin = glm::clamp(glm::floor(glm::vec2(fovea.x, fovea.y)), glm::vec2(0.0f), glm::vec2(viewport.z, viewport.w));
+    glm::vec2 foveaMax = glm::clamp(glm::ceil(glm::vec2(fovea.x + fovea.z, fovea.y + fovea.w)), foveaMin, glm::vec2(viewport.z, viewport.w));
+    glm::ivec2 newFoveaSize(foveaMax - foveaMin);
+    glm::ivec2 newPeripherySize(glm::max(glm::vec2(1.0f), glm::round(glm::vec2(viewport.z, viewport.w) * peripheryScale)));
+    bool fullFovea = newFoveaSize.x >= (int)viewport.z && newFoveaSize.y >= (int)viewport.w;
+    if (!IsFoveationSupported() || peripheryScale <= 0.0f || peripheryScale >= 1.0f || fullFovea || newFoveaSize.x == 0 || newFoveaSize.y == 0)
+    {
+        Render(cameraMat, projMat, viewport, nearFar);
+        return;
+    }
+
+    GL_ERROR_CHECK("SplatRenderer::RenderFoveated() begin");
+
+    SavedDrawState savedState;
+    if (!ResizeFoveationTargets(newFoveaSize, newPeripherySize))
+    {
+        savedState.RestoreFramebuffer();
+        Render(cameraMat, projMat, viewport, nearFar);
+        return;
+    }
+
+    // fragments are counted against the full resolution area, the composite is one full screen pass.
+    bool timeDraw = BeginDrawTimer((double)viewport.z * (double)viewport.w, 1);
+
+    // both targets start out transparent, the splats are blended over them with premultiplied alpha.
+    const float clearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_LESS);
+
+    {
+        ZoneScopedNC("periphery", tracy::Color::Red4);
+        peripheryFrameBuffer->Bind();
+        glViewport(0, 0, peripherySize.x, peripherySize.y);
+        glClearBufferfv(GL_COLOR, 0, clearColor);
+
+        // the inside of the fovea, except where it fades into the periphery, is set to the nearest depth,
+        // so the early depth test rejects all of the periphery fragments that would be covered by it.
+        const float farDepth = 1.0f;
+        const float nearDepth = 0.0f;
+        glDepthMask(GL_TRUE);
+        glClearBufferfv(GL_DEPTH, 0, &farDepth);
+        glm::vec2 scale = glm::vec2(peripherySize) / glm::vec2(viewport.z, viewport.w);
+        glm::ivec2 innerMin(glm::ceil((foveaMin + glm::vec2(FOVEA_FEATHER_WIDTH)) * scale));
+        glm::ivec2 innerMax(glm::floor((foveaMax - glm::vec2(FOVEA_FEATHER_WIDTH)) * scale));
+        if (innerMax.x > innerMin.x && innerMax.y > innerMin.y)
+        {
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(innerMin.x, innerMin.y, innerMax.x - innerMin.x, innerMax.y - innerMin.y);
+            glClearBufferfv(GL_DEPTH, 0, &nearDepth);
+            glDisable(GL_SCISSOR_TEST);
+        }
+        glDepthMask(GL_FALSE);
+        glEnable(GL_DEPTH_TEST);
+
+        Render(cameraMat, projMat, glm::vec4(0.0f, 0.0f, (float)peripherySize.x, (float)peripherySize.y), nearFar);
+
+        GL_ERROR_CHECK("SplatRenderer::RenderFoveated() periphery");
+    }
+
+    {
+        ZoneScopedNC("fovea", tracy::Color::Red4);
+        foveaFrameBuffer->Bind();
+        glClearBufferfv(GL_COLOR, 0, clearColor);
+        glDisable(GL_DEPTH_TEST);
+
+        // the full resolution viewport is shifted, so the fovea rect lands on the fovea target and the rest is clipped.
+        glm::vec4 foveaViewport(-foveaMin.x, -foveaMin.y, viewport.z, viewport.w);
+        glViewport((GLint)foveaViewport.x, (GLint)foveaViewport.y, (GLsizei)foveaViewport.z, (GLsizei)foveaViewport.w);
+        Render(cameraMat, projMat, foveaViewport, nearFar);
+
+        GL_ERROR_CHECK("SplatRenderer::RenderFoveated() fovea");
+    }
+
+    savedState.Restore();
+
+    {
+        ZoneScopedNC("composite", tracy::Color::Red4);
+
+        GLboolean depthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+
+        foveatedCompositeProg->Bind();
+        foveatedCompositeProg->SetUniform("viewport", viewport);
+        foveatedCompositeProg->SetUniform("fovea", glm::vec4(foveaMin, foveaMax - foveaMin));
+        foveatedCompositeProg->SetUniform("featherWidth", FOVEA_FEATHER_WIDTH);
+        foveaColorTex->Bind(0);
+        foveatedCompositeProg->SetUniform("foveaTex", 0);
+        peripheryColorTex->Bind(1);
+        foveatedCompositeProg->SetUniform("peripheryTex", 1);
+
+        // one full screen triangle
+        quadVao->Bind();
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        quadVao->Unbind();
+
+        if (depthTestEnabled)
+        {
+            glEnable(GL_DEPTH_TEST);
+        }
+
+        GL_ERROR_CHECK("SplatRenderer::RenderFoveated() composite");
+    }
+
+    if (timeDraw)
+    {
+        EndDrawTimer();
+    }
+}
+
+bool SplatRenderer::IsTemporalSupported() const
+{
+    return temporalProg && compositeProg && drawMode == DrawMode::InstancedQuads && !IsFrontToBack();
+}
+
+// element of the halton sequence with the given base, in [0, 1)
+static float Halton(uint32_t index, uint32_t base)
+{
+    float result = 0.0f;
+    float f = 1.0f;
+    while (index > 0)
+    {
+        f /= (float)base;
+        result += f * (float)(index % base);
+        index /= base;
+    }
+    return result;
+}
+
+void SplatRenderer::RenderTemporal(const glm::mat4& cameraMat, const glm::mat4& projMat,
+                                   const glm::vec4& viewport, const glm::vec2& nearFar,
+                                   float renderScale, uint32_t historyIndex)
+{
+    ZoneScoped;
+
+    glm::ivec2 fullSize((int)viewport.z, (int)viewport.w);
+    glm::ivec2 lowSize(glm::max(glm::vec2(1.0f), glm::round(glm::vec2(fullSize) * renderScale)));
+    if (!IsTemporalSupported() || renderScale <= 0.0f || renderScale > 1.0f || fullSize.x <= 0 || fullSize.y <= 0)
+    {
+        Render(cameraMat, projMat, viewport, nearFar);
+        return;
+    }
+
+    GL_ERROR_CHECK("SplatRenderer::RenderTemporal() begin");
+
+    SavedDrawState savedState;
+    if (!ResizeTemporalTargets(lowSize, fullSize, historyIndex))
+    {
+        savedState.RestoreFramebuffer();
+        Render(cameraMat, projMat, viewport, nearFar);
+        return;
+    }
+    TemporalHistory& history = temporalHistories[historyIndex];
+
+    // fragments are counted against the full resolution area, the resolve and the composite are full screen passes.
+    bool timeDraw = BeginDrawTimer((double)viewport.z * (double)viewport.w, 2);
+
+    // a different sub-pixel offset every frame, in low resolution pixels, so over a few frames every full resolution pixel gets a sample.
+    // for an integer upscale factor k, a k by k grid puts a sample exactly on every full resolution pixel center once every k * k frames,
+    // any other factor uses a halton sequence.
+    glm::vec2 jitter;
+    const float upscale = 1.0f / renderScale;
+    const uint32_t k = (uint32_t)roundf(upscale);
+    if (fabsf(upscale - (float)k) < 0.01f)
+    {
+        uint32_t phase = history.frameNum % (k * k);
+        jitter = glm::vec2(0.5f) - (glm::vec2((float)(phase % k), (float)(phase / k)) + 0.5f) / (float)k;
+    }
+    else
+    {
+        const uint32_t JITTER_PHASES = 16;
+        uint32_t phase = history.frameNum % JITTER_PHASES + 1;
+        jitter = glm::vec2(Halton(phase, 2) - 0.5f, Halton(phase, 3) - 0.5f);
+    }
+    glm::vec2 ndcJitter = 2.0f * jitter / glm::vec2(lowSize);
+    glm::mat4 jitteredProjMat = glm::translate(glm::mat4(1.0f), glm::vec3(ndcJitter, 0.0f)) * projMat;
+
+    {
+        ZoneScopedNC("low resolution", tracy::Color::Red4);
+        temporalFrameBuffer->Bind();
+        glViewport(0, 0, lowSize.x, lowSize.y);
+        const float clearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, clearColor);
+        glClearBufferfv(GL_COLOR, 1, clearColor);
+
+        // the expected depth is blended with the same premultiplied blend function as the color.
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        glDisable(GL_DEPTH_TEST);
+
+        // the low resolution pixels are samples of the full resolution image, so they get its filter, not a wider one.
+        glm::vec2 scale = glm::vec2(lowSize) / glm::vec2(fullSize);
+        expectedDepthPass = true;
+        filterVariance = FILTER_VARIANCE * scale.x * scale.y;
+        Render(cameraMat, jitteredProjMat, glm::vec4(0.0f, 0.0f, (float)lowSize.x, (float)lowSize.y), nearFar);
+        filterVariance = FILTER_VARIANCE;
+        expectedDepthPass = false;
+
+        GL_ERROR_CHECK("SplatRenderer::RenderTemporal() low resolution");
+    }
+
+    const uint32_t prev = history.current;
+    const uint32_t next = 1 - history.current;
+    {
+        ZoneScopedNC("resolve", tracy::Color::Red4);
+        history.frameBuffer[next]->Bind();
+        glViewport(0, 0, fullSize.x, fullSize.y);
+        glDisable(GL_BLEND);
+
+        temporalProg->Bind();
+        temporalProg->SetUniform("viewport", glm::vec4(0.0f, 0.0f, viewport.z, viewport.w));
+        temporalProg->SetUniform("lowSize", glm::vec2(lowSize));
+        temporalProg->SetUniform("jitter", jitter);
+        temporalProg->SetUniform("nearFar", nearFar);
+        temporalProg->SetUniform("invProjMat", glm::inverse(projMat));
+        temporalProg->SetUniform("reprojMat", glm::inverse(history.cameraMat) * cameraMat);
+        temporalProg->SetUniform("historyProjMat", history.projMat);
+        temporalProg->SetUniform("historyValid", history.valid ? 1 : 0);
+        temporalColorTex->Bind(0);
+        temporalProg->SetUniform("colorTex", 0);
+        temporalDepthTex->Bind(1);
+        temporalProg->SetUniform("depthTex", 1);
+        history.colorTex[prev]->Bind(2);
+        temporalProg->SetUniform("historyTex", 2);
+        history.depthTex[prev]->Bind(3);
+        temporalProg->SetUniform("historyDepthTex", 3);
+
+        // one full screen triangle
+        quadVao->Bind();
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        quadVao->Unbind();
+
+        GL_ERROR_CHECK("SplatRenderer::RenderTemporal() resolve");
+    }
+
+    history.current = next;
+    history.cameraMat = cameraMat;
+    history.projMat = projMat;
+    history.frameNum++;
+    history.valid = true;
+
+    savedState.Restore();
+
+    {
+        ZoneScopedNC("composite", tracy::Color::Red4);
+
+        GLboolean depthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+
+        compositeProg->Bind();
+        compositeProg->SetUniform("viewport", viewport);
+        history.colorTex[next]->Bind(0);
+        compositeProg->SetUniform("colorTex", 0);
+
+        // one full screen triangle
+        quadVao->Bind();
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        quadVao->Unbind();
+
+        if (depthTestEnabled)
+        {
+            glEnable(GL_DEPTH_TEST);
+        }
+
+        GL_ERROR_CHECK("SplatRenderer::RenderTemporal() composite");
+    }
+
+    if (timeDraw)
+    {
+        EndDrawTimer();
+    }
+}
+
+bool SplatRenderer::IsStereoSupported() const
+{
+    return stereoQuadProg && drawMode == DrawMode::InstancedQuads && !IsFrontToBack();
+}
+
+void SplatRenderer::RenderStereo(const glm::mat4* cameraMats, const glm::mat4* projMats,
+                                 const glm::vec4& viewport, const glm::vec2& nearFar)
+{
+    ZoneScoped;
+
+    if (!IsStereoSupported())
+    {
+        return;
+    }
+
+    GL_ERROR_CHECK("SplatRenderer::RenderStereo() begin");
+
+    if (sortCount > 0)
+    {
+        ZoneScopedNC("reproject", tracy::Color::Red4);
+
+        if (!secondViewRecordBuffer)
+        {
+            secondViewRecordBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, nullptr, posVec.size() * SPLAT_RECORD_SIZE, 0);
+        }
+
+        // the second view is written to its own buffer, the first is rewritten in place, the same as Render().
+        Preprocess(true, sortCount, cameraMats[1], projMats[1], viewport, nearFar, secondViewRecordBuffer);
+        if (cameraMats[0] != recordCameraMat || projMats[0] != recordProjMat || viewport != recordViewport)
+        {
+            Preprocess(true, sortCount, cameraMats[0], projMats[0], viewport, nearFar);
+            recordCameraMat = cameraMats[0];
+            recordProjMat = projMats[0];
+            recordViewport = viewport;
+        }
+
+        GL_ERROR_CHECK("SplatRenderer::RenderStereo() reproject");
+    }
+
+    bool timeDraw = BeginDrawTimer(2.0 * (double)viewport.z * (double)viewport.w, 0);
+
+    if (sortCount > 0)
+    {
+        ZoneScopedNC("draw stereo", tracy::Color::Red4);
+
+        stereoQuadProg->Bind();
+        stereoQuadProg->SetUniform("viewport", viewport);
+        if (falloffTex)
+        {
+            // use texture unit 0 for the gaussian falloff
+            falloffTex->Bind(0);
+            stereoQuadProg->SetUniform("falloffTex", 0);
+        }
+        stereoQuadProg->SetUniform("indexBase", 0);
+        stereoQuadProg->SetUniform("indexStep", 1);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, recordBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, GetDrawIndexBuffer()->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, secondViewRecordBuffer->GetObj());
+
+        // with multiview each instance is drawn to both layers, otherwise the instances alternate between them.
+        // either way each layer sees the splats in sorted order.
+        quadVao->Bind();
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, stereoMultiview ? sortCount : 2 * sortCount);
+        quadVao->Unbind();
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+
+        GL_ERROR_CHECK("SplatRenderer::RenderStereo() draw");
+    }
+
+    if (timeDraw)
+    {
+        EndDrawTimer();
+    }
+}
+
+void SplatRenderer::BuildVertexArrayObject(std::shared_ptr<GaussianCloud> gaussianCloud)
+{
+    splatVao = std::make_shared<VertexArrayObject>();
+
+    // allocate large buffer to hold interleaved vertex data
+    gaussianDataBuffer = std::make_shared<BufferObject>(GL_ARRAY_BUFFER,
+                                                        gaussianCloud->GetRawDataPtr(),
+                                                        gaussianCloud->GetTotalSize(), 0);
+
+    splatVao->Bind();
+    gaussianDataBuffer->Bind();
+
+    const size_t stride = gaussianCloud->GetStride();
+    SetupAttrib(splatProg->GetAttribLoc("position"), gaussianCloud->GetPosWithAlphaAttrib(), 4, stride);
+    SetupAttrib(splatProg->GetAttribLoc("r_sh0"), gaussianCloud->GetR_SH0Attrib(), 4, stride);
+    SetupAttrib(splatProg->GetAttribLoc("g_sh0"), gaussianCloud->GetG_SH0Attrib(), 4, stride);
     SetupAttrib(splatProg->GetAttribLoc("b_sh0"), gaussianCloud->GetB_SH0Attrib(), 4, stride);
     if (gaussianCloud->HasFullSH())
     {
@@ -386,6 +1484,818 @@ void SplatRenderer::BuildVertexArrayObject(std::shared_ptr<GaussianCloud> gaussi
     SetupAttrib(splatProg->GetAttribLoc("cov3_col1"), gaussianCloud->GetCov3_Col1Attrib(), 3, stride);
     SetupAttrib(splatProg->GetAttribLoc("cov3_col2"), gaussianCloud->GetCov3_Col2Attrib(), 3, stride);
 
-    splatVao->SetElementBuffer(indexBuffer);
     gaussianDataBuffer->Unbind();
 }
+
+std::string SplatRenderer::BuildPreprocessDefines(std::shared_ptr<GaussianCloud> gaussianCloud) const
+{
+    std::string defines = "";
+    if (isFramebufferSRGBEnabled)
+    {
+        defines += "#define FRAMEBUFFER_SRGB\n";
+    }
+    if (gaussianCloud->HasFullSH())
+    {
+        defines += "#define FULL_SH\n";
+    }
+
+    assert(gaussianCloud->GetStride() % sizeof(float) == 0);
+    defines += "#define GAUSSIAN_STRIDE " + std::to_string(gaussianCloud->GetStride() / sizeof(float)) + "U\n";
+    defines += OffsetDefine("POSITION_OFFSET", gaussianCloud->GetPosWithAlphaAttrib());
+    defines += OffsetDefine("R_SH0_OFFSET", gaussianCloud->GetR_SH0Attrib());
+    defines += OffsetDefine("G_SH0_OFFSET", gaussianCloud->GetG_SH0Attrib());
+    defines += OffsetDefine("B_SH0_OFFSET", gaussianCloud->GetB_SH0Attrib());
+    if (gaussianCloud->HasFullSH())
+    {
+        defines += OffsetDefine("R_SH1_OFFSET", gaussianCloud->GetR_SH1Attrib());
+        defines += OffsetDefine("R_SH2_OFFSET", gaussianCloud->GetR_SH2Attrib());
+        defines += OffsetDefine("R_SH3_OFFSET", gaussianCloud->GetR_SH3Attrib());
+        defines += OffsetDefine("G_SH1_OFFSET", gaussianCloud->GetG_SH1Attrib());
+        defines += OffsetDefine("G_SH2_OFFSET", gaussianCloud->GetG_SH2Attrib());
+        defines += OffsetDefine("G_SH3_OFFSET", gaussianCloud->GetG_SH3Attrib());
+        defines += OffsetDefine("B_SH1_OFFSET", gaussianCloud->GetB_SH1Attrib());
+        defines += OffsetDefine("B_SH2_OFFSET", gaussianCloud->GetB_SH2Attrib());
+        defines += OffsetDefine("B_SH3_OFFSET", gaussianCloud->GetB_SH3Attrib());
+    }
+    defines += OffsetDefine("COV3_COL0_OFFSET", gaussianCloud->GetCov3_Col0Attrib());
+    defines += OffsetDefine("COV3_COL1_OFFSET", gaussianCloud->GetCov3_Col1Attrib());
+    defines += OffsetDefine("COV3_COL2_OFFSET", gaussianCloud->GetCov3_Col2Attrib());
+    return defines;
+}
+
+// when reproject is true, the records are rewritten in place, or into reprojectBuffer if it is given.
+void SplatRenderer::Preprocess(bool reproject, uint32_t numSplats, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                               const glm::vec4& viewport, const glm::vec2& nearFar,
+                               std::shared_ptr<BufferObject> reprojectBuffer)
+{
+    std::shared_ptr<Program> prog = reproject ? reprojectProg : preprocessProg;
+    prog->Bind();
+    prog->SetUniform("viewMat", glm::inverse(cameraMat));
+    prog->SetUniform("projMat", projMat);
+    prog->SetUniform("viewport", viewport);
+    prog->SetUniform("numSplats", numSplats);
+    prog->SetUniform("minPixelArea", minPixelArea);
+    prog->SetUniform("pointRadius", pointRadius);
+    prog->SetUniform("filterVariance", filterVariance);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, gaussianDataBuffer->GetObj());  // readonly
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, recordBuffer->GetObj());
+
+    // reprojection keeps the keys and values from the last sort, and the radiance of each record
+    if (reproject)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, (reprojectBuffer ? reprojectBuffer : recordBuffer)->GetObj());  // writeonly
+    }
+    else
+    {
+        prog->SetUniform("eye", glm::vec3(cameraMat[3]));
+        prog->SetUniform("nearFar", nearFar);
+        prog->SetUniform("keyMax", MAX_DEPTH);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, gpuSorter->GetKeyBuffer()->GetObj());  // writeonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, gpuSorter->GetValBuffer()->GetObj());  // writeonly
+        glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, atomicCounterBuffer->GetObj());
+
+        bool occlusionCull = IsOccluderUsable(cameraMat, viewport);
+        prog->SetUniform("occlusionCull", occlusionCull ? 1u : 0u);
+        if (occlusionCull)
+        {
+            prog->SetUniform("occluderViewProjMat", occluderViewProjMat);
+            prog->SetUniform("occluderSize", glm::vec2(occluderViewport.z, occluderViewport.w));
+            prog->SetUniform("occluderNumLevels", occluderNumLevels);
+            occluderTex->Bind(0);
+            prog->SetUniform("occluderTex", 0);
+        }
+    }
+
+    const int LOCAL_SIZE = 256;
+    glDispatchCompute((numSplats + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+}
+
+// writes a record for each visible splat, the number of them is counted in atomicCounterBuffer.
+void SplatRenderer::PreprocessVisible(const glm::mat4& cameraMat, const glm::mat4& projMat,
+                                      const glm::vec4& viewport, const glm::vec2& nearFar)
+{
+    ZoneScopedNC("preprocess", tracy::Color::Red4);
+
+    // reset counter back to zero
+    atomicCounterVec[0] = 0;
+    atomicCounterBuffer->Update(atomicCounterVec);
+
+    Preprocess(false, (uint32_t)posVec.size(), cameraMat, projMat, viewport, nearFar);
+
+    GL_ERROR_CHECK("SplatRenderer::PreprocessVisible()");
+}
+
+// same as PreprocessVisible() but returns the number of visible splats, waits for the gpu.
+uint32_t SplatRenderer::PreprocessAndCount(const glm::mat4& cameraMat, const glm::mat4& projMat,
+                                           const glm::vec4& viewport, const glm::vec2& nearFar)
+{
+    PreprocessVisible(cameraMat, projMat, viewport, nearFar);
+
+    uint32_t count = 0;
+    {
+        ZoneScopedNC("get-count", tracy::Color::Green);
+        atomicCounterBuffer->Read(atomicCounterVec);
+        count = atomicCounterVec[0];
+        assert(count <= posVec.size());
+    }
+    return count;
+}
+
+// Bins the visible splats into screen tiles, sorts them by tile then depth and finds the range of each tile.
+// This is the same pipeline as the reference 3dgs rasterizer, but with 32 bit keys, so the depth precision
+// is reduced by the number of bits needed for the tile index.
+void SplatRenderer::BuildTiles(const glm::mat4& cameraMat, const glm::mat4& projMat,
+                               const glm::vec4& viewport, const glm::vec2& nearFar)
+{
+    sortCount = PreprocessAndCount(cameraMat, projMat, viewport, nearFar);
+    recordCameraMat = cameraMat;
+    recordProjMat = projMat;
+    recordViewport = viewport;
+
+    numTilesX = ((uint32_t)viewport.z + TILE_SIZE - 1) / TILE_SIZE;
+    numTilesY = ((uint32_t)viewport.w + TILE_SIZE - 1) / TILE_SIZE;
+    const uint32_t numTiles = numTilesX * numTilesY;
+    tileBits = 1;
+    while (tileBits < 31 && (1u << tileBits) < numTiles)
+    {
+        tileBits++;
+    }
+
+    if (tileRangeVec.size() < numTiles * 2)
+    {
+        tileRangeVec.resize(numTiles * 2, 0);
+        tileRangeBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, tileRangeVec, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    if (!tileSorter)
+    {
+        // start with one entry per splat, most scenes need a few times that.
+        tileSorter = std::make_shared<GpuSorter>();
+        if (!tileSorter->Init(std::min(posVec.size(), MAX_TILE_ENTRIES), gpuSorter->GetBackend()))
+        {
+            Log::E("Error initializing tile sorter\n");
+            tileSorter = nullptr;
+            sortCount = 0;
+            return;
+        }
+
+        // the entry count followed by the depth histogram of splat_tile_bin_compute.glsl
+        tileEntryCountVec.resize(1 + NUM_TILE_DEPTH_BUCKETS, 0);
+        tileEntryCountBuffer = std::make_shared<BufferObject>(GL_SHADER_STORAGE_BUFFER, tileEntryCountVec, GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT);
+    }
+
+    {
+        ZoneScopedNC("bin", tracy::Color::Red4);
+
+        // if there are more entries then will fit, the sorter is grown up to MAX_TILE_ENTRIES, past that the farthest
+        // splats are dropped, then the splats are binned again.
+        uint32_t maxDepthBucket = NUM_TILE_DEPTH_BUCKETS - 1;
+        const int MAX_ATTEMPTS = 2;
+        for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++)
+        {
+            std::fill(tileEntryCountVec.begin(), tileEntryCountVec.end(), 0);
+            tileEntryCountBuffer->Update(tileEntryCountVec);
+
+            const uint32_t maxEntries = (uint32_t)tileSorter->GetMaxNumElements();
+            tileBinProg->Bind();
+            tileBinProg->SetUniform("viewport", viewport);
+            tileBinProg->SetUniform("numTilesX", numTilesX);
+            tileBinProg->SetUniform("numTilesY", numTilesY);
+            tileBinProg->SetUniform("tileBits", tileBits);
+            tileBinProg->SetUniform("numSplats", sortCount);
+            tileBinProg->SetUniform("maxEntries", maxEntries);
+            tileBinProg->SetUniform("maxDepthBucket", maxDepthBucket);
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, recordBuffer->GetObj());  // readonly
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, gpuSorter->GetKeyBuffer()->GetObj());  // readonly
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, tileSorter->GetKeyBuffer()->GetObj());  // writeonly
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, tileSorter->GetValBuffer()->GetObj());  // writeonly
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, tileEntryCountBuffer->GetObj());
+
+            const int LOCAL_SIZE = 256;
+            glDispatchCompute((sortCount + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+            tileEntryCountBuffer->Read(tileEntryCountVec.data(), sizeof(uint32_t));
+            numTileEntries = tileEntryCountVec[0];
+            if (numTileEntries <= maxEntries || attempt == MAX_ATTEMPTS - 1)
+            {
+                break;
+            }
+
+            // leave some room, so this doesn't happen every time the camera moves a little closer.
+            size_t newMaxEntries = std::min((size_t)numTileEntries + numTileEntries / 2, MAX_TILE_ENTRIES);
+            if (newMaxEntries > maxEntries)
+            {
+                Log::I("growing tile sorter from %u to %u entries\n", maxEntries, (uint32_t)newMaxEntries);
+                tileSorter->Resize(newMaxEntries);
+            }
+
+            if (numTileEntries > newMaxEntries)
+            {
+                // keep the nearest depth buckets that fit, the first non-empty one is kept even if it doesn't, and is cut short.
+                tileEntryCountBuffer->Read(tileEntryCountVec);
+                size_t total = 0;
+                for (uint32_t i = 0; i < NUM_TILE_DEPTH_BUCKETS; i++)
+                {
+                    if (total > 0 && total + tileEntryCountVec[1 + i] > newMaxEntries)
+                    {
+                        break;
+                    }
+                    total += tileEntryCountVec[1 + i];
+                    maxDepthBucket = i;
+                }
+            }
+        }
+        numTileEntries = std::min(numTileEntries, (uint32_t)tileSorter->GetMaxNumElements());
+
+        GL_ERROR_CHECK("SplatRenderer::BuildTiles() bin");
+    }
+
+    tileSorter->SortKeys(numTileEntries);
+
+    {
+        ZoneScopedNC("ranges", tracy::Color::Red4);
+
+        // tiles without any entries are left empty
+        tileRangeBuffer->Update(tileRangeVec);
+
+        tileRangesProg->Bind();
+        tileRangesProg->SetUniform("numEntries", numTileEntries);
+        tileRangesProg->SetUniform("tileBits", tileBits);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, tileSorter->GetSortedKeyBuffer()->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, tileRangeBuffer->GetObj());  // writeonly
+
+        const int LOCAL_SIZE = 256;
+        glDispatchCompute((numTileEntries + (LOCAL_SIZE - 1)) / LOCAL_SIZE, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        GL_ERROR_CHECK("SplatRenderer::BuildTiles() ranges");
+    }
+}
+
+// rasterizes every tile into offscreenColorTex, then composites it over the current framebuffer.
+void SplatRenderer::RenderTiles(const glm::vec4& viewport)
+{
+    ResizeOffscreenTargets(glm::ivec2((int)viewport.z, (int)viewport.w), DrawMode::ComputeTiles);
+
+    {
+        ZoneScopedNC("raster", tracy::Color::Red4);
+
+        tileRasterProg->Bind();
+        tileRasterProg->SetUniform("viewport", viewport);
+        tileRasterProg->SetUniform("numTilesX", numTilesX);
+        if (falloffTex)
+        {
+            falloffTex->Bind(0);
+            tileRasterProg->SetUniform("falloffTex", 0);
+        }
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, recordBuffer->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, tileSorter->GetSortedValBuffer()->GetObj());  // readonly
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, tileRangeBuffer->GetObj());  // readonly
+        glBindImageTexture(0, offscreenColorTex->texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glBindImageTexture(1, tileDepthTex->texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+        glDispatchCompute(numTilesX, numTilesY, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        GL_ERROR_CHECK("SplatRenderer::RenderTiles() raster");
+    }
+
+    Composite(viewport);
+}
+
+// draws the quads nearest first into offscreenColorTex with the under operator, then composites it over the current framebuffer.
+// between chunks, the pixels that are already opaque are marked in offscreenDepthTex, so that the early depth test rejects
+// all of the remaining fragments that would not change them.
+// if buildOccluders is true, the pixels saturated by the last chunk are marked too, for BuildOccluderPyramid().
+void SplatRenderer::RenderFrontToBack(const glm::vec4& viewport, bool buildOccluders)
+{
+    SavedDrawState savedState;
+
+    glm::ivec2 size((int)viewport.z, (int)viewport.w);
+    if (!ResizeOffscreenTargets(size, DrawMode::InstancedQuads))
+    {
+        savedState.RestoreFramebuffer();
+        return;
+    }
+
+    // the records are in ndc, so only the size of the viewport matters
+    glm::vec4 offscreenViewport(0.0f, 0.0f, viewport.z, viewport.w);
+    glViewport(0, 0, size.x, size.y);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_BLEND);
+
+    {
+        ZoneScopedNC("clear", tracy::Color::Red4);
+        colorFrameBuffer->Bind();
+        const float clearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        const float clearDepth = 1.0f;
+        glDepthMask(GL_TRUE);
+        glClearBufferfv(GL_COLOR, 0, clearColor);
+        glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+    }
+
+    uint32_t chunkSize = (sortCount + FRONT_TO_BACK_CHUNKS - 1) / FRONT_TO_BACK_CHUNKS;
+    for (uint32_t i = 0; i < FRONT_TO_BACK_CHUNKS; i++)
+    {
+        uint32_t start = i * chunkSize;
+        if (i > 0)
+        {
+            // the farthest splat of the previous chunk
+            MarkSaturatedPixels(offscreenViewport, sortCount - std::min(start, sortCount));
+        }
+
+        uint32_t count = (start < sortCount) ? std::min(chunkSize, sortCount - start) : 0;
+
+        ZoneScopedNC("chunk", tracy::Color::Red4);
+
+        colorFrameBuffer->Bind();
+
+        // under operator, the premultiplied splat is scaled by the remaining transmittance (1 - dst alpha)
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE_MINUS_DST_ALPHA, GL_ONE);
+        glDepthMask(GL_FALSE);
+
+        if (count > 0)
+        {
+            quadProg->Bind();
+            quadProg->SetUniform("viewport", offscreenViewport);
+            if (falloffTex)
+            {
+                falloffTex->Bind(0);
+                quadProg->SetUniform("falloffTex", 0);
+            }
+
+            // the sort output is back to front, so walk it from the end.
+            quadProg->SetUniform("indexBase", (int32_t)(sortCount - 1 - start));
+            quadProg->SetUniform("indexStep", -1);
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, recordBuffer->GetObj());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, GetDrawIndexBuffer()->GetObj());
+
+            quadVao->Bind();
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+            quadVao->Unbind();
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+        }
+
+        GL_ERROR_CHECK("SplatRenderer::RenderFrontToBack() chunk");
+    }
+
+    if (buildOccluders)
+    {
+        // the farthest splat of all
+        MarkSaturatedPixels(offscreenViewport, 0);
+    }
+
+    savedState.Restore();
+
+    Composite(viewport);
+}
+
+// draws the quads in the order they were preprocessed, into offscreenColorTex and offscreenWeightTex, then resolves them
+// over the current framebuffer. weighted blended order independent transparency, McGuire and Bavoil 2013.
+// the splats are not sorted, so their color is a depth weighted average instead of the result of the over operator.
+void SplatRenderer::RenderWeightedBlended(const glm::vec4& viewport, const glm::vec2& nearFar)
+{
+    SavedDrawState savedState;
+
+    glm::ivec2 size((int)viewport.z, (int)viewport.w);
+    if (!ResizeOffscreenTargets(size, DrawMode::WeightedBlended))
+    {
+        savedState.RestoreFramebuffer();
+        return;
+    }
+
+    {
+        ZoneScopedNC("accumulate", tracy::Color::Red4);
+
+        weightedFrameBuffer->Bind();
+        glViewport(0, 0, size.x, size.y);
+
+        // revealage starts at one, and the sums at zero.
+        const float clearColor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        const float clearWeight[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, clearColor);
+        glClearBufferfv(GL_COLOR, 1, clearWeight);
+
+        // the same blend function is used for both targets, so the sums go in rgb and revealage in alpha.
+        // this avoids glBlendFunci, which is not available in gles 3.1
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+
+        // the records are in ndc, so only the size of the viewport matters
+        weightedProg->Bind();
+        weightedProg->SetUniform("viewport", glm::vec4(0.0f, 0.0f, viewport.z, viewport.w));
+        weightedProg->SetUniform("nearFar", nearFar);
+        weightedProg->SetUniform("indexBase", 0);
+        weightedProg->SetUniform("indexStep", 1);
+        if (falloffTex)
+        {
+            falloffTex->Bind(0);
+            weightedProg->SetUniform("falloffTex", 0);
+        }
+
+        // the values written by Preprocess(), which are the indices of the records.
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, recordBuffer->GetObj());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, gpuSorter->GetValBuffer()->GetObj());
+
+        quadVao->Bind();
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, sortCount);
+        quadVao->Unbind();
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+
+        GL_ERROR_CHECK("SplatRenderer::RenderWeightedBlended() accumulate");
+    }
+
+    savedState.Restore();
+
+    Composite(viewport);
+}
+
+// marks the pixels with less then MIN_TRANSMITTANCE in offscreenDepthTex, at the depth of the sorted splat at depthIndex.
+void SplatRenderer::MarkSaturatedPixels(const glm::vec4& offscreenViewport, uint32_t depthIndex)
+{
+    ZoneScopedNC("saturate", tracy::Color::Red4);
+
+    // writes depth only, so offscreenColorTex can be sampled without a feedback loop.
+    depthFrameBuffer->Bind();
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+
+    saturateProg->Bind();
+    saturateProg->SetUniform("viewport", offscreenViewport);
+    saturateProg->SetUniform("minTransmittance", MIN_TRANSMITTANCE);
+    saturateProg->SetUniform("depthIndex", (int32_t)depthIndex);
+    offscreenColorTex->Bind(1);
+    saturateProg->SetUniform("colorTex", 1);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, recordBuffer->GetObj());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, GetDrawIndexBuffer()->GetObj());
+
+    // one full screen triangle
+    quadVao->Bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    quadVao->Unbind();
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    GL_ERROR_CHECK("SplatRenderer::MarkSaturatedPixels()");
+}
+
+// creates offscreenColorTex, and the other targets used by mode, InstancedQuads are the front to back targets.
+// returns false if the framebuffers are not complete, the caller must restore the framebuffer binding.
+bool SplatRenderer::ResizeOffscreenTargets(const glm::ivec2& size, DrawMode mode)
+{
+    if (!offscreenColorTex || offscreenSize != size)
+    {
+        Texture::Params texParams = {FilterType::Nearest, FilterType::Nearest, WrapType::ClampToEdge, WrapType::ClampToEdge};
+        offscreenColorTex = std::make_shared<Texture>(size.x, size.y, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, texParams);
+        offscreenDepthTex = nullptr;
+        tileDepthTex = nullptr;
+        offscreenWeightTex = nullptr;
+        colorFrameBuffer = nullptr;
+        depthFrameBuffer = nullptr;
+        weightedFrameBuffer = nullptr;
+        offscreenSize = size;
+    }
+
+    if (mode == DrawMode::ComputeTiles && !tileDepthTex)
+    {
+        // compute tiles write the depth at which each pixel saturated with imageStore, instead of a depth buffer.
+        Texture::Params texParams = {FilterType::Nearest, FilterType::Nearest, WrapType::ClampToEdge, WrapType::ClampToEdge};
+        tileDepthTex = std::make_shared<Texture>(size.x, size.y, GL_R32F, GL_RED, GL_FLOAT, texParams);
+    }
+
+    if (mode == DrawMode::InstancedQuads && !colorFrameBuffer)
+    {
+        Texture::Params texParams = {FilterType::Nearest, FilterType::Nearest, WrapType::ClampToEdge, WrapType::ClampToEdge};
+        offscreenDepthTex = std::make_shared<Texture>(size.x, size.y, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, texParams);
+
+        colorFrameBuffer = std::make_shared<FrameBuffer>();
+        colorFrameBuffer->AttachColor(offscreenColorTex);
+        colorFrameBuffer->AttachDepth(offscreenDepthTex);
+        bool colorComplete = colorFrameBuffer->IsComplete();
+
+        depthFrameBuffer = std::make_shared<FrameBuffer>();
+        depthFrameBuffer->AttachDepth(offscreenDepthTex);
+        bool depthComplete = depthFrameBuffer->IsComplete();
+
+        GL_ERROR_CHECK("SplatRenderer::ResizeOffscreenTargets() framebuffers");
+
+        if (!colorComplete || !depthComplete)
+        {
+            Log::W("Front to back framebuffers are incomplete, using back to front\n");
+            offscreenDepthTex = nullptr;
+            colorFrameBuffer = nullptr;
+            depthFrameBuffer = nullptr;
+            frontToBack = false;
+            return false;
+        }
+    }
+
+    if (mode == DrawMode::WeightedBlended && !weightedFrameBuffer)
+    {
+        Texture::Params texParams = {FilterType::Nearest, FilterType::Nearest, WrapType::ClampToEdge, WrapType::ClampToEdge};
+        offscreenWeightTex = std::make_shared<Texture>(size.x, size.y, GL_R16F, GL_RED, GL_HALF_FLOAT, texParams);
+
+        weightedFrameBuffer = std::make_shared<FrameBuffer>();
+        weightedFrameBuffer->AttachColor(offscreenColorTex);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, offscreenWeightTex->texture, 0);
+        const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, drawBuffers);
+        bool complete = weightedFrameBuffer->IsComplete();
+
+        GL_ERROR_CHECK("SplatRenderer::ResizeOffscreenTargets() weighted framebuffer");
+
+        if (!complete)
+        {
+            Log::W("Weighted blended framebuffer is incomplete, using instanced quads\n");
+            offscreenWeightTex = nullptr;
+            weightedFrameBuffer = nullptr;
+            drawMode = DrawMode::InstancedQuads;
+            sortCount = 0;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool SplatRenderer::ResizeFoveationTargets(const glm::ivec2& foveaSizeIn, const glm::ivec2& peripherySizeIn)
+{
+    if (!foveaFrameBuffer || foveaSize != foveaSizeIn)
+    {
+        Texture::Params texParams = {FilterType::Nearest, FilterType::Nearest, WrapType::ClampToEdge, WrapType::ClampToEdge};
+        foveaColorTex = std::make_shared<Texture>(foveaSizeIn.x, foveaSizeIn.y, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, texParams);
+        foveaFrameBuffer = std::make_shared<FrameBuffer>();
+        foveaFrameBuffer->AttachColor(foveaColorTex);
+        foveaSize = foveaSizeIn;
+        if (!foveaFrameBuffer->IsComplete())
+        {
+            Log::W("Fovea framebuffer is incomplete, foveated rendering is not available\n");
+            foveaFrameBuffer = nullptr;
+            foveatedCompositeProg = nullptr;
+            return false;
+        }
+    }
+
+    if (!peripheryFrameBuffer || peripherySize != peripherySizeIn)
+    {
+        // linear filtering, for the upscale in splat_foveated_composite_frag.glsl
+        Texture::Params texParams = {FilterType::Linear, FilterType::Linear, WrapType::ClampToEdge, WrapType::ClampToEdge};
+        peripheryColorTex = std::make_shared<Texture>(peripherySizeIn.x, peripherySizeIn.y, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, texParams);
+        Texture::Params depthParams = {FilterType::Nearest, FilterType::Nearest, WrapType::ClampToEdge, WrapType::ClampToEdge};
+        peripheryDepthTex = std::make_shared<Texture>(peripherySizeIn.x, peripherySizeIn.y, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, depthParams);
+        peripheryFrameBuffer = std::make_shared<FrameBuffer>();
+        peripheryFrameBuffer->AttachColor(peripheryColorTex);
+        peripheryFrameBuffer->AttachDepth(peripheryDepthTex);
+        peripherySize = peripherySizeIn;
+        if (!peripheryFrameBuffer->IsComplete())
+        {
+            Log::W("Periphery framebuffer is incomplete, foveated rendering is not available\n");
+            peripheryFrameBuffer = nullptr;
+            foveatedCompositeProg = nullptr;
+            return false;
+        }
+    }
+
+    GL_ERROR_CHECK("SplatRenderer::ResizeFoveationTargets()");
+    return true;
+}
+
+bool SplatRenderer::ResizeTemporalTargets(const glm::ivec2& lowSize, const glm::ivec2& fullSize, uint32_t historyIndex)
+{
+    if (!temporalFrameBuffer || temporalSize != lowSize)
+    {
+        // linear filtering, for the upscale in splat_temporal_frag.glsl
+        Texture::Params texParams = {FilterType::Linear, FilterType::Linear, WrapType::ClampToEdge, WrapType::ClampToEdge};
+        temporalColorTex = std::make_shared<Texture>(lowSize.x, lowSize.y, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, texParams);
+        temporalDepthTex = std::make_shared<Texture>(lowSize.x, lowSize.y, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, texParams);
+        temporalFrameBuffer = std::make_shared<FrameBuffer>();
+        temporalFrameBuffer->AttachColor(temporalColorTex);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, temporalDepthTex->texture, 0);
+        const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, drawBuffers);
+        temporalSize = lowSize;
+        if (!temporalFrameBuffer->IsComplete())
+        {
+            Log::W("Temporal framebuffer is incomplete, temporal upsampling is not available\n");
+            temporalFrameBuffer = nullptr;
+            temporalProg = nullptr;
+            return false;
+        }
+    }
+
+    if (historyIndex >= temporalHistories.size())
+    {
+        temporalHistories.resize(historyIndex + 1);
+    }
+
+    // the history starts over whenever the size changes.
+    TemporalHistory& history = temporalHistories[historyIndex];
+    if (!history.frameBuffer[0] || history.size != fullSize)
+    {
+        Texture::Params colorParams = {FilterType::Linear, FilterType::Linear, WrapType::ClampToEdge, WrapType::ClampToEdge};
+        Texture::Params depthParams = {FilterType::Nearest, FilterType::Nearest, WrapType::ClampToEdge, WrapType::ClampToEdge};
+        for (int i = 0; i < 2; i++)
+        {
+            history.colorTex[i] = std::make_shared<Texture>(fullSize.x, fullSize.y, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, colorParams);
+            history.depthTex[i] = std::make_shared<Texture>(fullSize.x, fullSize.y, GL_R32F, GL_RED, GL_FLOAT, depthParams);
+            history.frameBuffer[i] = std::make_shared<FrameBuffer>();
+            history.frameBuffer[i]->AttachColor(history.colorTex[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, history.depthTex[i]->texture, 0);
+            const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+            glDrawBuffers(2, drawBuffers);
+            if (!history.frameBuffer[i]->IsComplete())
+            {
+                Log::W("Temporal history framebuffer is incomplete, temporal upsampling is not available\n");
+                history = TemporalHistory();
+                temporalProg = nullptr;
+                return false;
+            }
+        }
+        history.size = fullSize;
+        history.valid = false;
+    }
+
+    GL_ERROR_CHECK("SplatRenderer::ResizeTemporalTargets()");
+    return true;
+}
+
+// copies offscreenColorTex over the current framebuffer, with the current blend state.
+// in WeightedBlended mode, offscreenColorTex and offscreenWeightTex are resolved first.
+void SplatRenderer::Composite(const glm::vec4& viewport)
+{
+    ZoneScopedNC("composite", tracy::Color::Red4);
+
+    // the splats have already been blended, so there is nothing to depth test against.
+    GLboolean depthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+
+    std::shared_ptr<Program> prog = (drawMode == DrawMode::WeightedBlended) ? weightedCompositeProg : compositeProg;
+    prog->Bind();
+    prog->SetUniform("viewport", viewport);
+    if (drawMode == DrawMode::WeightedBlended)
+    {
+        offscreenWeightTex->Bind(1);
+        prog->SetUniform("weightTex", 1);
+    }
+    offscreenColorTex->Bind(0);
+    prog->SetUniform("colorTex", 0);
+
+    // one full screen triangle
+    quadVao->Bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    quadVao->Unbind();
+
+    if (depthTestEnabled)
+    {
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    GL_ERROR_CHECK("SplatRenderer::Composite()");
+}
+
+// reduces the depth at which each pixel saturated into a max depth pyramid, level 0 is half the size of depthTex.
+void SplatRenderer::BuildOccluderPyramid(std::shared_ptr<Texture> depthTex, const glm::ivec2& size)
+{
+    ZoneScopedNC("occluders", tracy::Color::Red4);
+
+    glm::ivec2 levelSize((size.x + 1) / 2, (size.y + 1) / 2);
+    if (!occluderTex || occluderTexSize != levelSize)
+    {
+        Texture::Params texParams = {FilterType::NearestMipmapNearest, FilterType::Nearest, WrapType::ClampToEdge, WrapType::ClampToEdge};
+        occluderTex = std::make_shared<Texture>(levelSize.x, levelSize.y, GL_R32F, GL_RED, GL_FLOAT, texParams);
+        occluderTexSize = levelSize;
+
+        // allocate the rest of the mip chain, down to 1x1
+        occluderNumLevels = 1;
+        glm::ivec2 mipSize = levelSize;
+        while (mipSize.x > 1 || mipSize.y > 1)
+        {
+            mipSize = glm::max((mipSize + glm::ivec2(1, 1)) / 2, glm::ivec2(1, 1));
+            glTexImage2D(GL_TEXTURE_2D, occluderNumLevels, GL_R32F, mipSize.x, mipSize.y, 0, GL_RED, GL_FLOAT, nullptr);
+            occluderNumLevels++;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, occluderNumLevels - 1);
+    }
+
+    occluderReduceProg->Bind();
+    occluderReduceProg->SetUniform("srcTex", 0);
+
+    glm::ivec2 srcSize = size;
+    glm::ivec2 dstSize = levelSize;
+    for (int32_t level = 0; level < occluderNumLevels; level++)
+    {
+        // level 0 reads from depthTex, the rest from the level above them.
+        if (level == 0)
+        {
+            depthTex->Bind(0);
+        }
+        else
+        {
+            occluderTex->Bind(0);
+        }
+        occluderReduceProg->SetUniform("srcLevel", level == 0 ? 0 : level - 1);
+        occluderReduceProg->SetUniform("srcSize", srcSize);
+        occluderReduceProg->SetUniform("dstSize", dstSize);
+        glBindImageTexture(0, occluderTex->texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+        const int LOCAL_SIZE = 8;
+        glDispatchCompute((dstSize.x + LOCAL_SIZE - 1) / LOCAL_SIZE, (dstSize.y + LOCAL_SIZE - 1) / LOCAL_SIZE, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        srcSize = dstSize;
+        dstSize = glm::max((dstSize + glm::ivec2(1, 1)) / 2, glm::ivec2(1, 1));
+    }
+
+    GL_ERROR_CHECK("SplatRenderer::BuildOccluderPyramid()");
+}
+
+// the pyramid is only valid for the frame it was built from, but it is close enough if the camera has not moved much.
+bool SplatRenderer::IsOccluderUsable(const glm::mat4& cameraMat, const glm::vec4& viewport) const
+{
+    if (!occlusionCulling || !occluderValid || viewport.z != occluderViewport.z || viewport.w != occluderViewport.w)
+    {
+        return false;
+    }
+
+    float translation = glm::length(glm::vec3(cameraMat[3]) - glm::vec3(occluderCameraMat[3]));
+    float cosAngle = glm::dot(glm::normalize(glm::vec3(cameraMat[2])), glm::normalize(glm::vec3(occluderCameraMat[2])));
+    return translation <= OCCLUSION_MAX_TRANSLATION && cosAngle >= OCCLUSION_MIN_COS_ANGLE;
+}
+
+// reads back the previous measurement without stalling, returns false to skip timing this draw if it is not ready yet.
+// fragmentArea is the number of pixels in the viewport(s) for the overdraw, zero to skip counting fragments.
+bool SplatRenderer::BeginDrawTimer(double fragmentArea, uint32_t fragmentPasses)
+{
+    if (drawTimer && drawTimerPending && drawTimer->IsAvailable())
+    {
+        drawMs = drawTimer->Resolve()[0].ms;
+        overdraw = 0.0;
+#ifndef __ANDROID__
+        if (fragmentQuery && fragmentQueryArea > 0.0)
+        {
+            // ended before the timer, so it is available too.
+            GLuint64 numFragments = 0;
+            glGetQueryObjectui64v(fragmentQuery, GL_QUERY_RESULT, &numFragments);
+            overdraw = std::max(0.0, (double)numFragments / fragmentQueryArea - (double)fragmentQueryPasses);
+        }
+#endif
+        if (sortErrorPending)
+        {
+            sortErrorBuffer->Read(sortErrorVec);
+            sortDepthError = (sortErrorVec[1] > 0) ? (double)sortErrorVec[0] / (double)sortErrorVec[1] : 0.0;
+            sortErrorPending = false;
+        }
+        drawTimerPending = false;
+    }
+    if (!drawTimer || drawTimerPending || drawTimerActive)
+    {
+        return false;
+    }
+
+    drawTimerActive = true;
+    drawTimer->Reset();
+    drawTimer->Begin("splat draw");
+    fragmentQueryArea = 0.0;
+#ifndef __ANDROID__
+    if (fragmentQuery && fragmentArea > 0.0)
+    {
+        glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, fragmentQuery);
+        fragmentQueryArea = fragmentArea;
+        fragmentQueryPasses = fragmentPasses;
+    }
+#endif
+    return true;
+}
+
+void SplatRenderer::EndDrawTimer()
+{
+#ifndef __ANDROID__
+    if (fragmentQuery && fragmentQueryArea > 0.0)
+    {
+        glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+    }
+#endif
+    drawTimer->End();
+    drawTimerPending = true;
+    drawTimerActive = false;
+}
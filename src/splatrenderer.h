@@ -8,6 +8,7 @@
 #include <glm/glm.hpp>
 #include <memory>
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 #include "core/program.h"
@@ -15,10 +16,10 @@
 
 #include "gaussiancloud.h"
 
-namespace rgc::radix_sort
-{
-    struct sorter;
-}
+struct FrameBuffer;
+class GpuSorter;
+class GpuTimer;
+struct Texture;
 
 class SplatRenderer
 {
@@ -26,42 +27,290 @@ public:
     SplatRenderer();
     ~SplatRenderer();
 
-    bool Init(std::shared_ptr<GaussianCloud> gaussianCloud,
-              bool isFramebufferSRGBEnabledIn, bool useRgcSortOverrideIn);
+    enum class DrawMode
+    {
+        GeometryShader,  // each splat is a point, expanded into a quad by splat_geom.glsl
+        InstancedQuads,  // each splat is projected once by splat_preprocess_compute.glsl, then expanded by splat_quad_vert.glsl
+        ComputeTiles,    // the projected splats are binned into screen tiles and blended front to back by splat_tile_raster_compute.glsl
+        WeightedBlended  // same as InstancedQuads, but without a sort, using weighted blended order independent transparency
+    };
+
+    // instanced quads require compute shaders and shader storage buffers in the vertex shader.
+    static bool IsInstancedQuadsSupported();
+
+    // useFalloffLut evaluates the gaussian in splat_frag.glsl with a texture lookup, instead of exp()
+    bool Init(std::shared_ptr<GaussianCloud> gaussianCloud, bool isFramebufferSRGBEnabledIn,
+              std::shared_ptr<GpuSorter> gpuSorterIn, bool useFalloffLutIn = true);
 
     void Sort(const glm::mat4& cameraMat, const glm::mat4& projMat,
               const glm::vec4& viewport, const glm::vec2& nearFar);
 
+    // sorts once for both views of a stereo pair, with the keys computed from a cyclopean eye between them,
+    // and the splats culled against a frustum that contains both eye frusta. Render() then re-projects the splats for each eye.
+    void SortStereo(const glm::mat4* cameraMats, const glm::mat4* projMats,
+                    const glm::vec4& viewport, const glm::vec2& nearFar);
+
     // viewport = (x, y, width, height)
+    // in InstancedQuads and WeightedBlended mode, if the view differs from the one passed to Sort(), the visible splats are re-projected,
+    // but drawn in the same order and with the view dependent color from the sort. i.e. the second eye in vr.
     void Render(const glm::mat4& cameraMat, const glm::mat4& projMat,
                 const glm::vec4& viewport, const glm::vec2& nearFar);
-public:
-    uint32_t numBlocksPerWorkgroup = 1024;
+
+    // true if RenderStereo() can draw with the current draw mode, which must be InstancedQuads without front to back blending.
+    // requires GL_OVR_multiview2 or GL_ARB_shader_viewport_layer_array.
+    bool IsStereoSupported() const;
+
+    // true if RenderStereo() uses GL_OVR_multiview2, the layers must then be attached with glFramebufferTextureMultiviewOVR(),
+    // otherwise the framebuffer must be layered, i.e. the layers are attached with glFramebufferTexture().
+    bool IsStereoMultiview() const { return stereoMultiview; }
+
+    // draws two views in a single pass, into layers 0 and 1 of the bound framebuffer, both with the same viewport.
+    // the splats are re-projected for each view, but drawn in the order from the last Sort().
+    // does nothing if IsStereoSupported() is false.
+    void RenderStereo(const glm::mat4* cameraMats, const glm::mat4* projMats,
+                      const glm::vec4& viewport, const glm::vec2& nearFar);
+
+    // true if RenderFoveated() can draw with the current draw mode, which must be InstancedQuads without front to back blending,
+    // or GeometryShader.
+    bool IsFoveationSupported() const;
+
+    // draws the splats over the current framebuffer like Render(), but only the fovea at full resolution, the rest of the view
+    // is drawn at peripheryScale times the resolution and upscaled. the periphery skips the pixels the fovea covers.
+    // fovea = (x, y, width, height) in pixels, relative to the viewport origin.
+    // same as Render() if IsFoveationSupported() is false.
+    void RenderFoveated(const glm::mat4& cameraMat, const glm::mat4& projMat,
+                        const glm::vec4& viewport, const glm::vec2& nearFar,
+                        const glm::vec4& fovea, float peripheryScale);
+
+    // true if RenderTemporal() can draw with the current draw mode, which must be InstancedQuads without front to back blending.
+    bool IsTemporalSupported() const;
+
+    // draws the splats over the current framebuffer like Render(), but at renderScale times the resolution, with a sub-pixel jitter
+    // that changes every frame. the jittered frames are accumulated into a full resolution history, which is reprojected with
+    // the camera motion and the expected depth of the blended splats at each pixel. history that was disoccluded is rejected, moving
+    // history is clamped to the range of the new samples around it, and fades out where the splats of a pixel are spread over a
+    // range of depths, i.e. the parallax of a single depth is wrong. historyIndex picks an independent history, i.e. one per eye.
+    // same as Render() if IsTemporalSupported() is false.
+    void RenderTemporal(const glm::mat4& cameraMat, const glm::mat4& projMat,
+                        const glm::vec4& viewport, const glm::vec2& nearFar,
+                        float renderScale, uint32_t historyIndex = 0);
+
+    // InstancedQuads is the default, when supported. ComputeTiles and WeightedBlended require the same support as InstancedQuads.
+    // ComputeTiles and WeightedBlended do not use the depth buffer, the splats are composited over the framebuffer with the current blend state.
+    // WeightedBlended skips the sort entirely, overlapping splats are averaged by depth instead, which is faster but less accurate.
+    void SetDrawMode(DrawMode drawModeIn);
+    DrawMode GetDrawMode() const { return drawMode; }
+
+    // InstancedQuads only, draws the splats nearest first with the under operator into an offscreen target,
+    // pixels that are already opaque are marked in its depth buffer so the remaining splats are rejected by the early depth test.
+    // like ComputeTiles, the result is composited over the framebuffer with the current blend state, without a depth test.
+    void SetFrontToBack(bool frontToBackIn) { frontToBack = frontToBackIn; }
+    bool GetFrontToBack() const { return frontToBack; }
+
+    // splats that were entirely behind saturated pixels in the previous frame are culled before the sort.
+    // only the front to back draw modes (front to back quads and ComputeTiles) find the depth where each pixel saturates,
+    // so this has no effect in the others. the test is skipped for a frame when the camera moves or turns quickly.
+    void SetOcclusionCulling(bool occlusionCullingIn) { occlusionCulling = occlusionCullingIn; occluderValid = false; }
+    bool GetOcclusionCulling() const { return occlusionCulling; }
+
+    // splats whose opacity aware footprint covers fewer pixels then this are culled before the sort, zero disables the test.
+    // alpha below the blend threshold and splats entirely outside of the view frustum are always culled.
+    void SetMinPixelArea(float minPixelAreaIn) { minPixelArea = minPixelAreaIn; }
+    float GetMinPixelArea() const { return minPixelArea; }
+
+    // splats whose opacity aware radius is smaller then this many pixels are drawn as a single pixel,
+    // with the gaussian integrated over that pixel, instead of a quad that is mostly discarded. zero disables it.
+    // they stay in the same sorted draw as every other splat, so the blend order is unchanged.
+    void SetPointRadius(float pointRadiusIn) { pointRadius = pointRadiusIn; }
+    float GetPointRadius() const { return pointRadius; }
+
+    // widens the frustum that Sort() culls against by this angle in radians on every side, so a sort computed from a predicted pose,
+    // or used for a later frame, still has the splats that rotate into view. zero disables it, ComputeTiles ignores it.
+    void SetSortMargin(float sortMarginIn) { sortMargin = sortMarginIn; }
+    float GetSortMargin() const { return sortMargin; }
+
+    // InstancedQuads with the cpu sort backend only, otherwise it is refused. the keys of each Sort() are read back
+    // asynchronously and sorted on the worker threads, the draws use the order of an earlier Sort() until that is done,
+    // so nothing waits for the gpu or the sort. the records are still reprojected to the view of each draw, only the
+    // order is one or more frames older.
+    void SetSortPipelining(bool sortPipeliningIn);
+    bool GetSortPipelining() const { return sortPipelining; }
+
+    // fraction of the adjacent splats in the most recently measured draw that are in the wrong depth order, i.e. how stale
+    // the pipelined order is. zero without sort pipelining or if timer queries are not supported.
+    double GetSortDepthError() const { return sortDepthError; }
+
+    // gpu time of the most recently measured splat draw call, zero if timer queries are not supported.
+    double GetDrawMs() const { return drawMs; }
+
+    // gpu time of the most recently measured Sort(), including the preprocess, zero if timer queries are not supported.
+    double GetSortMs() const { return sortMs; }
+
+    // fragment shader invocations of the most recently measured splat draw call, divided by the viewport area.
+    // zero if GL_ARB_pipeline_statistics_query is not supported.
+    double GetOverdraw() const { return overdraw; }
 protected:
     void BuildVertexArrayObject(std::shared_ptr<GaussianCloud> gaussianCloud);
+    std::string BuildPreprocessDefines(std::shared_ptr<GaussianCloud> gaussianCloud) const;
+    void Preprocess(bool reproject, uint32_t numSplats, const glm::mat4& cameraMat, const glm::mat4& projMat,
+                    const glm::vec4& viewport, const glm::vec2& nearFar,
+                    std::shared_ptr<BufferObject> reprojectBuffer = nullptr);
+    void PreprocessVisible(const glm::mat4& cameraMat, const glm::mat4& projMat,
+                           const glm::vec4& viewport, const glm::vec2& nearFar);
+    uint32_t PreprocessAndCount(const glm::mat4& cameraMat, const glm::mat4& projMat,
+                                const glm::vec4& viewport, const glm::vec2& nearFar);
+    void SortPipelined(const glm::mat4& cameraMat, const glm::mat4& projMat,
+                       const glm::vec4& viewport, const glm::vec2& nearFar);
+    void PromotePendingSort(bool wait);
+    void CancelPendingSort();
+    void MeasureSortError();
+    std::shared_ptr<BufferObject> GetDrawIndexBuffer() const;
+    void BuildTiles(const glm::mat4& cameraMat, const glm::mat4& projMat,
+                    const glm::vec4& viewport, const glm::vec2& nearFar);
+    void RenderTiles(const glm::vec4& viewport);
+    void RenderFrontToBack(const glm::vec4& viewport, bool buildOccluders);
+    void RenderWeightedBlended(const glm::vec4& viewport, const glm::vec2& nearFar);
+    void MarkSaturatedPixels(const glm::vec4& offscreenViewport, uint32_t depthIndex);
+    void BuildOccluderPyramid(std::shared_ptr<Texture> depthTex, const glm::ivec2& size);
+    bool IsOccluderUsable(const glm::mat4& cameraMat, const glm::vec4& viewport) const;
+    bool IsFrontToBack() const { return frontToBack && drawMode == DrawMode::InstancedQuads && saturateProg; }
+    bool ResizeOffscreenTargets(const glm::ivec2& size, DrawMode mode);
+    bool ResizeFoveationTargets(const glm::ivec2& foveaSize, const glm::ivec2& peripherySize);
+    bool ResizeTemporalTargets(const glm::ivec2& lowSize, const glm::ivec2& fullSize, uint32_t historyIndex);
+    void Composite(const glm::vec4& viewport);
+    bool BeginDrawTimer(double fragmentArea, uint32_t fragmentPasses);
+    void EndDrawTimer();
 
-    std::shared_ptr<rgc::radix_sort::sorter> sorter;
+    std::shared_ptr<GpuSorter> gpuSorter;
     std::shared_ptr<Program> splatProg;
-    std::shared_ptr<Program> preSortProg;
-    std::shared_ptr<Program> histogramProg;
-    std::shared_ptr<Program> sortProg;
     std::shared_ptr<VertexArrayObject> splatVao;
+    std::shared_ptr<Program> quadProg;
+    std::shared_ptr<Program> preprocessProg;
+    std::shared_ptr<Program> reprojectProg;
+    std::shared_ptr<VertexArrayObject> quadVao;
+    std::shared_ptr<Program> tileBinProg;
+    std::shared_ptr<Program> tileRangesProg;
+    std::shared_ptr<Program> tileRasterProg;
+    std::shared_ptr<Program> compositeProg;
+    std::shared_ptr<Program> saturateProg;
+    std::shared_ptr<Program> occluderReduceProg;
+    std::shared_ptr<Program> weightedProg;
+    std::shared_ptr<Program> weightedCompositeProg;
+    std::shared_ptr<Program> stereoQuadProg;
+    std::shared_ptr<Program> foveatedCompositeProg;
+    std::shared_ptr<Program> expectedDepthQuadProg;
+    std::shared_ptr<Program> temporalProg;
+    std::shared_ptr<Program> sortErrorProg;
+    std::shared_ptr<GpuTimer> drawTimer;
+    std::shared_ptr<GpuTimer> sortTimer;
+    std::shared_ptr<Texture> falloffTex;
 
-    std::vector<uint32_t> indexVec;
-    std::vector<uint32_t> depthVec;
     std::vector<glm::vec4> posVec;
-    std::vector<uint32_t> atomicCounterVec;
 
     std::shared_ptr<BufferObject> gaussianDataBuffer;
-    std::shared_ptr<BufferObject> keyBuffer;
-    std::shared_ptr<BufferObject> keyBuffer2;
-    std::shared_ptr<BufferObject> histogramBuffer;
-    std::shared_ptr<BufferObject> valBuffer;
-    std::shared_ptr<BufferObject> valBuffer2;
     std::shared_ptr<BufferObject> posBuffer;
+    std::shared_ptr<BufferObject> recordBuffer;
+    std::shared_ptr<BufferObject> secondViewRecordBuffer;  // RenderStereo() only, created on first use
     std::shared_ptr<BufferObject> atomicCounterBuffer;
+    std::vector<uint32_t> atomicCounterVec;
+
+    // ComputeTiles state, the sorter and buffers are created on first use, and grown as needed.
+    std::shared_ptr<GpuSorter> tileSorter;
+    std::shared_ptr<BufferObject> tileRangeBuffer;
+    std::shared_ptr<BufferObject> tileEntryCountBuffer;
+    std::vector<uint32_t> tileRangeVec;
+    std::vector<uint32_t> tileEntryCountVec;
+    uint32_t numTilesX;
+    uint32_t numTilesY;
+    uint32_t tileBits;
+    uint32_t numTileEntries;
+
+    // offscreen targets used by ComputeTiles, WeightedBlended and front to back quads, created on first use, and resized with the viewport.
+    std::shared_ptr<Texture> offscreenColorTex;
+    std::shared_ptr<Texture> offscreenDepthTex;
+    std::shared_ptr<Texture> tileDepthTex;
+    std::shared_ptr<Texture> offscreenWeightTex;
+    std::shared_ptr<FrameBuffer> colorFrameBuffer;
+    std::shared_ptr<FrameBuffer> depthFrameBuffer;
+    std::shared_ptr<FrameBuffer> weightedFrameBuffer;
+    glm::ivec2 offscreenSize;
+
+    // RenderFoveated() targets, created on first use, and resized with the fovea and the periphery.
+    std::shared_ptr<Texture> foveaColorTex;
+    std::shared_ptr<Texture> peripheryColorTex;
+    std::shared_ptr<Texture> peripheryDepthTex;
+    std::shared_ptr<FrameBuffer> foveaFrameBuffer;
+    std::shared_ptr<FrameBuffer> peripheryFrameBuffer;
+    glm::ivec2 foveaSize;
+    glm::ivec2 peripherySize;
+
+    // RenderTemporal() targets, the low resolution target is shared by all histories, each history is double buffered.
+    std::shared_ptr<Texture> temporalColorTex;
+    std::shared_ptr<Texture> temporalDepthTex;
+    std::shared_ptr<FrameBuffer> temporalFrameBuffer;
+    glm::ivec2 temporalSize;
+    struct TemporalHistory
+    {
+        std::shared_ptr<Texture> colorTex[2];
+        std::shared_ptr<Texture> depthTex[2];
+        std::shared_ptr<FrameBuffer> frameBuffer[2];
+        glm::ivec2 size = glm::ivec2(0, 0);
+        glm::mat4 cameraMat = glm::mat4(1.0f);
+        glm::mat4 projMat = glm::mat4(1.0f);
+        uint32_t current = 0;  // index of the most recent history
+        uint32_t frameNum = 0;  // picks the jitter
+        bool valid = false;
+    };
+    std::vector<TemporalHistory> temporalHistories;
+    bool expectedDepthPass;  // Render() draws the InstancedQuads with expectedDepthQuadProg
+    float filterVariance;  // anti-aliasing filter of Preprocess()
+
+    // occlusion culling state, the pyramid is built by the first Render() after each Sort(), and used by the next Sort().
+    std::shared_ptr<Texture> occluderTex;
+    glm::ivec2 occluderTexSize;
+    int32_t occluderNumLevels;
+    glm::mat4 occluderCameraMat;
+    glm::mat4 occluderViewProjMat;
+    glm::vec4 occluderViewport;
+    bool occluderValid;
+    bool occluderPending;
+
+    // view used to build the current records
+    glm::mat4 recordCameraMat;
+    glm::mat4 recordProjMat;
+    glm::vec4 recordViewport;
 
     uint32_t sortCount;
     bool isFramebufferSRGBEnabled;
-    bool useRgcSortOverride;
+    bool useFalloffLut;
+    float minPixelArea;
+    float pointRadius;
+    float sortMargin;
+    DrawMode drawMode;
+    bool frontToBack;
+    bool occlusionCulling;
+    bool stereoMultiview;
+    bool drawTimerPending;
+    bool drawTimerActive;  // between BeginDrawTimer() and EndDrawTimer(), so the Render() calls of RenderFoveated() are not timed again
+    double drawMs;
+    bool sortTimerPending;
+    double sortMs;
+    uint32_t fragmentQuery;
+    double fragmentQueryArea;
+    uint32_t fragmentQueryPasses;  // full screen passes included in the fragment query, not counted as overdraw
+    double overdraw;
+
+    // sort pipelining, the pending records become recordBuffer once gpuSorter is done sorting them, drawIndexBuffer is the
+    // sorter's value buffer with that order.
+    bool sortPipelining;
+    std::shared_ptr<BufferObject> drawIndexBuffer;
+    std::shared_ptr<BufferObject> pendingRecordBuffer;
+    bool sortPending;
+    glm::mat4 pendingCameraMat;
+    glm::mat4 pendingProjMat;
+    glm::vec4 pendingViewport;
+    std::shared_ptr<BufferObject> sortErrorBuffer;
+    std::vector<uint32_t> sortErrorVec;
+    bool sortErrorPending;
+    double sortDepthError;
 };